@@ -72,9 +72,11 @@ struct MIDI8MPE : Module {
 	PolyMode polyMode = ROTATE_MODE;
 
 	bool holdGates = true;
+	/// voice state keeps the input resolution: velocity 16-bit, expression and controllers
+	/// 32-bit, bends signed 32-bit (MidiUMPin::unit() / bipolar() to read them)
 	struct NoteData {
-		uint8_t velocity = 0;
-		uint8_t aftertouch = 0;
+		uint16_t velocity = 0;
+		uint32_t aftertouch = 0;
 	};
 
 	NoteData noteData[128];
@@ -85,27 +87,31 @@ struct MIDI8MPE : Module {
 	
 	
 	uint8_t notes[8] = {0};
-	uint8_t vels[8] = {0};
-	int16_t mpex[8] = {0};
-	uint16_t mpey[8] = {0};
-	uint16_t mpez[8] = {0};
+	uint16_t vels[8] = {0};
+	int32_t mpex[8] = {0};
+	uint32_t mpey[8] = {0};
+	uint32_t mpez[8] = {0};
 	uint8_t mpeyLB[8] = {0};
 	uint8_t mpezLB[8] = {0};
 	
 	uint8_t mpePlusLB[8] = {0};
 
-	bool gates[8] = {false};
-	uint8_t Maft = 0;
+	VoiceFlags gates;
+	uint32_t Maft = 0;
 	int midiCCs[6] = {128,1,129,11,7,64};
-	uint8_t midiCCsVal[6] = {0};
-	uint16_t Mpit = 8192;
+	uint32_t midiCCsVal[6] = {0};
+	MidiUMPin midiIn;	// MIDI 1.0 and UMP to full resolution events, CC pairs and RPN / NRPN per channel
+	UMPfile umpFile;	// stand-in MIDI 2.0 source (context menu)
+	std::atomic<UMPfile *> umpLoad {NULL};	// ui -> process
+	std::atomic<UMPfile *> umpDone {NULL};	// process -> ui, the replaced file to free
+	int32_t Mpit = 0;
 	float xpitch[8] = {0.f};
 	
 	// gates set to TRUE by pedal and current gate. FALSE by pedal.
-	bool pedalgates[8] = {false};
+	VoiceFlags pedalgates;
 	bool pedal = false;
 	int rotateIndex = 0;
-	int stealIndex = 0;
+	VoiceAllocator<8> voiceAlloc;
 	int numVo = 8;
 	int polyModeIx = 1;
 	int pbMain = 12;
@@ -133,11 +139,17 @@ struct MIDI8MPE : Module {
 	int frameData = 0;
 	
 
-	dsp::ExponentialFilter MPExFilter[8];
-	dsp::ExponentialFilter MPEyFilter[8];
-	dsp::ExponentialFilter MPEzFilter[8];
-	dsp::ExponentialFilter MCCsFilter[6];
-	dsp::ExponentialFilter MpitFilter;
+	/// output smoothing per destination (context menu)
+	SmoothShape smoothX;	// MPE bend
+	SmoothShape smoothYZ;	// MPE Y Z
+	SmoothShape smoothCC;	// CCs and main bend
+	KeyZone zone;
+	VelocityCurve velCurve;
+	Smoother MPExFilter[8];
+	Smoother MPEyFilter[8];
+	Smoother MPEzFilter[8];
+	Smoother MCCsFilter[6];
+	Smoother MpitFilter;
 	
 	// retrigger for stolen notes (when gates already open)
 	dsp::PulseGenerator reTrigger[8];
@@ -149,7 +161,27 @@ struct MIDI8MPE : Module {
 	dsp::SchmittTrigger RcursorTrigger;
 
 	dsp::SchmittTrigger learnCCsTrigger[6];
-
+	/// what the displays show, published every dispDivider block
+	struct DispState {
+		unsigned int gen = 0;
+		int polyModeIx = 1;
+		int MPEmode = 0;
+		int numVo = 8;
+		int pbMain = 12;
+		int pbMPE = 96;
+		int MPEmasterCh = 0;
+		int MPEfirstCh = 1;
+		int displayYcc = 74;
+		int displayZcc = 128;
+		int cursorIx = 0;
+		int learnIx = 0;
+		int midiCCs[6] = {128,1,129,11,7,64};
+	};
+	DispSnapshot<DispState> dispSnap;
+	DispGen disp;
+	dsp::ClockDivider dispDivider;
+	/// lights are written at the divider rate only
+	dsp::ClockDivider lightDivider;
 	
 	MIDI8MPE() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -166,8 +198,14 @@ struct MIDI8MPE : Module {
 		configParam(LEARNCCF_PARAM, 0.f, 1.f, 0.f);
 		configParam(SUSTHOLD_PARAM, 0.f, 1.f, 1.f);
 		configParam(DATAKNOB_PARAM, -1.f, 1.f, 0.f);
+		dispDivider.setDivision(256);
+		lightDivider.setDivision(256);
 		//onReset();
 	}
+	~MIDI8MPE() {
+		delete umpLoad.exchange(NULL);
+		delete umpDone.exchange(NULL);
+	}
 
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
@@ -187,6 +225,11 @@ struct MIDI8MPE : Module {
 		json_object_set_new(rootJ, "mpeYcc", json_integer(mpeYcc));
 		json_object_set_new(rootJ, "mpeZcc", json_integer(mpeZcc));
 		json_object_set_new(rootJ, "MPEmode", json_integer(MPEmode));
+		json_object_set_new(rootJ, "smoothX", smoothX.toJson());
+		json_object_set_new(rootJ, "smoothYZ", smoothYZ.toJson());
+		json_object_set_new(rootJ, "smoothCC", smoothCC.toJson());
+		json_object_set_new(rootJ, "keyZone", zone.toJson());
+		json_object_set_new(rootJ, "velCurve", velCurve.toJson());
 		return rootJ;
 	}
 
@@ -240,6 +283,11 @@ struct MIDI8MPE : Module {
 		json_t *MPEmodeJ = json_object_get(rootJ, "MPEmode");
 		if (MPEmodeJ)
 			MPEmode = json_integer_value(MPEmodeJ);
+		smoothX.fromJson(json_object_get(rootJ, "smoothX"));
+		smoothYZ.fromJson(json_object_get(rootJ, "smoothYZ"));
+		smoothCC.fromJson(json_object_get(rootJ, "smoothCC"));
+		zone.fromJson(json_object_get(rootJ, "keyZone"));
+		velCurve.fromJson(json_object_get(rootJ, "velCurve"));
 		
 		if (polyModeIx > 0){
 			displayYcc = 129;
@@ -254,25 +302,24 @@ struct MIDI8MPE : Module {
 	}
 ///////////////////////////ON RESET
 	void onReset() override {
+		zone.set(0, 127, 1, 127);
+		velCurve.set(VelocityCurve::LINEAR);
 		for (int i = 0; i < 8; i++) {
 			notes[i] = 60;
 			gates[i] = false;
 			pedalgates[i] = false;
-			mpey[i] = 0.f;
+			mpey[i] = 0;
 		}
 		rotateIndex = -1;
 		cachedNotes.clear();
-		float lambdaf = 100.f * APP->engine->getSampleTime();
+		setRates();
 		
 		if (polyMode == MPE_MODE) {
 			midiInput.channel = -1;
 			for (int i = 0; i < 8; i++) {
-				mpex[i] = 0.f;
-				mpez[i] = 0.f;
+				mpex[i] = 0;
+				mpez[i] = 0;
 				cachedMPE[i].clear();
-				MPExFilter[i].lambda = lambdaf;
-				MPEyFilter[i].lambda = lambdaf;
-				MPEzFilter[i].lambda = lambdaf;
 			}
 			if (MPEmode > 0){// Haken MPE Plus
 				displayYcc = 131;
@@ -286,40 +333,28 @@ struct MIDI8MPE : Module {
 			displayZcc = 130;
 		}
 		learnIx = 0;
-		
-		MpitFilter.lambda = lambdaf;
-		for (int i=0; i < 6; i++){
-			MCCsFilter[i].lambda = lambdaf;
-		}
-		MpitFilter.lambda = lambdaf;
+		midiIn.reset();
 	}
 	void onRandomize() override{
 
 	}
 ////////////////////////////////////////////////////
 	int getPolyIndex(int nowIndex) {
-		for (int i = 0; i < numVo; i++) {
-			nowIndex++;
-			if (nowIndex > (numVo - 1))
-				nowIndex = 0;
-			if (!(gates[nowIndex] || pedalgates[nowIndex])) {
-				stealIndex = nowIndex;
-				return nowIndex;
-			}
-		}
+		voiceAlloc.numVoices = numVo;
+		bool stolen = false;
+		int voice = voiceAlloc.allocate(gates.mask | pedalgates.mask, nowIndex, stolen);
 		// All taken = steal (stealIndex always rotates)
-		stealIndex++;
-		if (stealIndex > (numVo - 1))
-			stealIndex = 0;
-		///if ((polyMode > MPE_MODE) && (polyMode < REASSIGN_MODE) && (gates[stealIndex]))
 		/// cannot reach here if polyMode == MPE mode ...no need to check
-		if ((polyMode < REASSIGN_MODE) && (gates[stealIndex]))
-			cachedNotes.push_back(notes[stealIndex]);
-		return stealIndex;
+		if (stolen && (polyMode < REASSIGN_MODE) && (gates[voice]))
+			cachedNotes.push_back(notes[voice]);
+		return voice;
 	}
 
-	void pressNote(uint8_t channel, uint8_t note, uint8_t vel) {
-		
+	void pressNote(uint8_t channel, uint8_t note, uint16_t vel) {
+		int vel7 = std::max(vel >> 9, 1);// zone in MIDI 1.0 steps
+		if (zone.learning) zone.learnPending(note, vel7);
+		if (!zone.takes(note, vel7)) return;
+		vel = velCurve.lookup16(vel);
 		// Set notes and gates
 		switch (polyMode) {
 			case MPE_MODE: {
@@ -379,7 +414,8 @@ struct MIDI8MPE : Module {
 		pedalgates[rotateIndex] = pedal;
 	}
 
-	void releaseNote(uint8_t channel, uint8_t note, uint8_t vel) {
+	/// vel 16-bit, MidiUMPin::noVelocity from a note on at velocity 0
+	void releaseNote(uint8_t channel, uint8_t note, uint32_t vel) {
 		
 		if (polyMode > MPE_MODE) {
 		// Remove the note
@@ -409,13 +445,13 @@ struct MIDI8MPE : Module {
 					else {
 						gates[i] = false;
 					}
-					if (vel < 128) // 128 = from NoteOn ZeroVel
+					if (vel != MidiUMPin::noVelocity)
 						vels[i] = vel;///Rel Vel
 				}
 			} break;
 
 			case REASSIGN_MODE: {
-				if (vel > 128) vel = 64;
+				if (vel == MidiUMPin::noVelocity) vel = 0x8000;
 				for (int i = 0; i < numVo; i++) {
 					if (i < (int) cachedNotes.size()) {
 						if (!pedalgates[i])
@@ -424,25 +460,25 @@ struct MIDI8MPE : Module {
 					}
 					else {
 						gates[i] = false;
-						mpey[i] = vel * 128;
+						mpey[i] = vel << 16;
 					}
 				}
 			} break;
 
 			case UNISON_MODE: {
-				if (vel > 128) vel = 64;
+				if (vel == MidiUMPin::noVelocity) vel = 0x8000;
 				if (!cachedNotes.empty()) {
 					uint8_t backnote = cachedNotes.back();
 					for (int i = 0; i < numVo; i++) {
 						notes[i] = backnote;
 						gates[i] = true;
-						mpey[i] = vel * 128;
+						mpey[i] = vel << 16;
 					}
 				}
 				else {
 					for (int i = 0; i < numVo; i++) {
 						gates[i] = false;
-						mpey[i] = vel * 128;
+						mpey[i] = vel << 16;
 					}
 				}
 				
@@ -462,10 +498,10 @@ struct MIDI8MPE : Module {
 						else {
 							gates[i] = false;
 						}
-						if (vel < 128) // 128 = from NoteOn ZeroVel
-							mpey[i] = vel * 128;
+						if (vel != MidiUMPin::noVelocity)
+							mpey[i] = vel << 16;
 						else//Fixed RelVel
-							mpey[i] = 8192;
+							mpey[i] = 0x80000000u;
 					}
 				}
 			} break;
@@ -524,8 +560,58 @@ struct MIDI8MPE : Module {
 		}
 	}
 	
+	/// only the rates: the split and the drawn curve survive a sample rate change
 	void onSampleRateChange() override {
-		onReset();
+		setRates();
+	}
+	void setRates(){
+		float sampleRate = APP->engine->getSampleRate();
+		smoothX.setSampleRate(sampleRate);
+		smoothYZ.setSampleRate(sampleRate);
+		smoothCC.setSampleRate(sampleRate);
+	}
+	
+	void publishDisplay(){
+		DispState &d = dispSnap.write();
+		d.polyModeIx = polyModeIx;
+		d.MPEmode = MPEmode;
+		d.numVo = numVo;
+		d.pbMain = pbMain;
+		d.pbMPE = pbMPE;
+		d.MPEmasterCh = MPEmasterCh;
+		d.MPEfirstCh = MPEfirstCh;
+		d.displayYcc = displayYcc;
+		d.displayZcc = displayZcc;
+		d.cursorIx = cursorIx;
+		d.learnIx = learnIx;
+		for (int i = 0; i < 6; i++) d.midiCCs[i] = midiCCs[i];
+		disp.begin();
+		disp.add(d.polyModeIx);
+		disp.add(d.MPEmode);
+		disp.add(d.numVo);
+		disp.add(d.pbMain);
+		disp.add(d.pbMPE);
+		disp.add(d.MPEmasterCh);
+		disp.add(d.MPEfirstCh);
+		disp.add(d.displayYcc);
+		disp.add(d.displayZcc);
+		disp.add(d.cursorIx);
+		disp.add(d.learnIx);
+		for (int i = 0; i < 6; i++) disp.add(d.midiCCs[i]);
+		if (disp.end()){
+			d.gen = disp.gen;
+			dispSnap.publish();
+		}
+	}
+	/// voice lights with Rack smoothing on release, reset flash fades in 1/4 s at any sample rate
+	void processLights(float lightTime){
+		bool sustainHold = (params[SUSTHOLD_PARAM].getValue() > .5 );
+		int voices = (polyMode > PolyMode::MPE_MODE) ? numVo : 8;
+		for (int i = 0; i < voices; i++) {
+			bool held = gates[i] || (sustainHold && pedalgates[i]);
+			lights[CH_LIGHT + i].setBrightnessSmooth(((i == rotateIndex)? 0.2f : 0.f) + (held ? .8f : 0.f), lightTime);
+		}
+		fadeLight(lights[RESETMIDI_LIGHT], lightTime);
 	}
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////
@@ -534,18 +620,25 @@ struct MIDI8MPE : Module {
 	
 	
 	void process(const ProcessArgs &args) override {
+		if (dispDivider.process()) publishDisplay();
+		if (lightDivider.process()) processLights(args.sampleTime * lightDivider.getDivision());
 
 		midi::Message msg;
 		while (midiInput.shift(&msg)) {
-			processMessage(msg);
+			processMessage(midiIn.fromMidi1(msg));
 		}
-
-		float pbVo = 0.f;
-		if (Mpit < 8192){
-			pbVo = MpitFilter.process(1.f ,rescale(Mpit, 0, 8192, -5.f, 0.f));
-		} else {
-			pbVo = MpitFilter.process(1.f ,rescale(Mpit, 8192, 16383, 0.f, 5.f));
+		if (!umpDone.load()){// the ui frees the replaced file, nothing is freed here
+			if (UMPfile *loaded = umpLoad.exchange(NULL)){
+				std::swap(umpFile, *loaded);
+				umpDone.store(loaded);
+			}
+		}
+		if (!umpFile.done()){
+			umpFile.advance(args.sampleTime * 1000.f);
+			while (const uint32_t *packet = umpFile.next()) processMessage(midiIn.decode(packet));
 		}
+
+		float pbVo = MpitFilter.process(smoothCC, MidiUMPin::bipolar(Mpit) * 5.f);
 //		outputs[MMA_OUTPUT].setVoltage(pbVo);
 		bool sustainHold = (params[SUSTHOLD_PARAM].getValue() > .5 );
 
@@ -554,34 +647,28 @@ struct MIDI8MPE : Module {
 				float lastGate = ((gates[i] || (sustainHold && pedalgates[i])) && (!(reTrigger[i].process(args.sampleTime))))? 10.f : 0.f;
 				outputs[GATE_OUTPUT + i].setVoltage(lastGate);
 				outputs[X_OUTPUT + i].setVoltage(((notes[i] - 60) / 12.f) + (pbVo * static_cast<float>(pbMain) / 60.f));
-				outputs[VEL_OUTPUT + i].setVoltage(rescale(vels[i], 0, 127, 0.f, 10.f));
-				outputs[Y_OUTPUT + i].setVoltage(rescale(mpey[i], 0, 16383, 0.f, 10.f));
-				outputs[Z_OUTPUT + i].setVoltage(rescale(noteData[notes[i]].aftertouch, 0, 127, 0.f, 10.f));
-				lights[CH_LIGHT + i].value = ((i == rotateIndex)? 0.2f : 0.f) + (lastGate * .08f);
+				outputs[VEL_OUTPUT + i].setVoltage(vels[i] * (10.f / 65535.f));
+				outputs[Y_OUTPUT + i].setVoltage(MidiUMPin::unit(mpey[i]) * 10.f);
+				outputs[Z_OUTPUT + i].setVoltage(MidiUMPin::unit(noteData[notes[i]].aftertouch) * 10.f);
 			}
 		} else {/// MPE MODE!!!
 			for (int i = 0; i < 8; i++) {
 				float lastGate = ((gates[i] || (sustainHold && pedalgates[i])) && (!(reTrigger[i].process(args.sampleTime)))) ? 10.f : 0.f;
 				outputs[GATE_OUTPUT + i].setVoltage(lastGate );
-				if ( mpex[i] < 0){
-					xpitch[i] = (MPExFilter[i].process(1.f ,rescale(mpex[i], -8192 , 0, -5.f, 0.f))) * pbMPE / 60.f;
-				} else {
-					xpitch[i] = (MPExFilter[i].process(1.f ,rescale(mpex[i], 0, 8191, 0.f, 5.f))) * pbMPE / 60.f;
-				}
+				xpitch[i] = MPExFilter[i].process(smoothX, MidiUMPin::bipolar(mpex[i]) * 5.f) * pbMPE / 60.f;
 				outputs[X_OUTPUT + i].setVoltage(xpitch[i] + ((notes[i] - 60) / 12.f) + (pbVo * static_cast<float>(pbMain) / 60.f));
-				outputs[VEL_OUTPUT + i].setVoltage(rescale(vels[i], 0, 127, 0.f, 10.f));
-				outputs[Y_OUTPUT + i].setVoltage(MPEyFilter[i].process(1.f ,rescale(mpey[i], 0, 16383, 0.f, 10.f)));
-				outputs[Z_OUTPUT + i].setVoltage(MPEzFilter[i].process(1.f ,rescale(mpez[i], 0, 16383, 0.f, 10.f)));
-				lights[CH_LIGHT + i].value = ((i == rotateIndex)? 0.2f : 0.f) + (lastGate * .08f);
+				outputs[VEL_OUTPUT + i].setVoltage(vels[i] * (10.f / 65535.f));
+				outputs[Y_OUTPUT + i].setVoltage(MPEyFilter[i].process(smoothYZ, MidiUMPin::unit(mpey[i]) * 10.f));
+				outputs[Z_OUTPUT + i].setVoltage(MPEzFilter[i].process(smoothYZ, MidiUMPin::unit(mpez[i]) * 10.f));
 			}
 		}
 		for (int i = 0; i < 6; i++){
 			if (midiCCs[i] == 128)
 				outputs[MMA_OUTPUT + i].setVoltage(pbVo);
 			else if (midiCCs[i] == 129)
-				outputs[MMA_OUTPUT + i].setVoltage(MCCsFilter[i].process(1.f ,rescale(Maft, 0, 127, 0.f, 10.f)));
+				outputs[MMA_OUTPUT + i].setVoltage(MCCsFilter[i].process(smoothCC, MidiUMPin::unit(Maft) * 10.f));
 			else
-				outputs[MMA_OUTPUT + i].setVoltage(MCCsFilter[i].process(1.f ,rescale(midiCCsVal[i], 0, 127, 0.f, 10.f)));
+				outputs[MMA_OUTPUT + i].setVoltage(MCCsFilter[i].process(smoothCC, MidiUMPin::unit(midiCCsVal[i]) * 10.f));
 		}
 
 		//// PANEL KNOB AND BUTTONS
@@ -666,122 +753,135 @@ struct MIDI8MPE : Module {
 			onReset();
 			return;
 		}
-		if (lights[RESETMIDI_LIGHT].value > 0.0001f){
-			lights[RESETMIDI_LIGHT].value -= 0.0001f ; // fade out light
-		}
 	}
 ///////////////////////
 //////   STEP END
 ///////////////////////
 
-	void processMessage(midi::Message msg) {
-
-
-		switch (msg.getStatus()) {
-			// note off
-			case 0x8: {
-				if ((polyMode == MPE_MODE) && (msg.getChannel() == MPEmasterCh)) return;
-				releaseNote(msg.getChannel(), msg.getNote(), msg.getValue());
+	/// MIDI 1.0 (fromMidi1) and UMP (decode) events, full resolution
+	void processMessage(const MidiUMPin::Event &ev) {
+		uint8_t channel = ev.channel;
+		bool master = (channel == MPEmasterCh);
+		int member = channel - MPEfirstCh;
+		if ((member < 0) || (member > 7)) member = -1;
+		switch (ev.kind) {
+			case MidiUMPin::NOTEOFF: {
+				if ((polyMode == MPE_MODE) && master) return;
+				releaseNote(channel, ev.note, ev.value);
 			} break;
-			// note on
-			case 0x9: {
-				if ((polyMode == MPE_MODE) && (msg.getChannel() == MPEmasterCh)) return;
-				if (msg.getValue() > 0) {
-					//noteData[msg.getNote()].velocity = msg.getValue();
-					pressNote(msg.getChannel(), msg.getNote(), msg.getValue());
-				}
-				else {
-					releaseNote(msg.getChannel(), msg.getNote(), 128);//128 to bypass Release vel on Vel Outputs
-				}
+			case MidiUMPin::NOTEON: {
+				if ((polyMode == MPE_MODE) && master) return;
+				//noteData[ev.note].velocity = ev.value;
+				pressNote(channel, ev.note, ev.value);
 			} break;
 			// note (poly) aftertouch
-			case 0xa: {
+			case MidiUMPin::POLYPRESS: {
 				if (polyMode == MPE_MODE) return;
-				noteData[msg.getNote()].aftertouch = msg.getValue();
+				noteData[ev.note].aftertouch = ev.value;
 			} break;
 				
 			// channel aftertouch
-			case 0xd: {
+			case MidiUMPin::CHPRESS: {
 				if (learnIx > 0) {// learn enabled ???
 					midiCCs[learnIx - 1] = 129;
 					learnIx = 0;
 					return;
 				}////////////////////////////////////////
 				else if (polyMode == MPE_MODE){
-					if (msg.getChannel() == MPEmasterCh){
-						Maft = msg.getNote();
+					if (master){
+						Maft = ev.value;
+					}else if (member < 0){
+						return;
 					}else if (MPEmode == 1){
-						mpez[msg.getChannel() - MPEfirstCh] =  msg.getNote() * 128 + mpePlusLB[msg.getChannel() - MPEfirstCh];
-						mpePlusLB[msg.getChannel() - MPEfirstCh] = 0;
+						mpez[member] = plusValue(member, ev.value);
 					}else {
 						if (mpeZcc == 128)
-							mpez[msg.getChannel() - MPEfirstCh] = msg.getNote() * 128;
+							mpez[member] = ev.value;
 						if (mpeYcc == 128)
-							mpey[msg.getChannel() - MPEfirstCh] = msg.getNote() * 128;
+							mpey[member] = ev.value;
 						}
 				}else{
-					Maft = msg.getNote();
+					Maft = ev.value;
 				}
 			} break;
-				// pitch Bend
-			case 0xe:{
+			case MidiUMPin::PITCHBEND:{
 				if (learnIx > 0) {// learn enabled ???
 					midiCCs[learnIx - 1] = 128;
 					learnIx = 0;
 					return;
 				}////////////////////////////////////////
-				else if (polyMode == MPE_MODE){
-					if (msg.getChannel() == MPEmasterCh){
-						Mpit = msg.getValue() * 128 + msg.getNote();
-					}else{
-						mpex[msg.getChannel() - MPEfirstCh] = msg.getValue() * 128 + msg.getNote() - 8192;
-					}
+				else if ((polyMode == MPE_MODE) && !master){
+					if (member >= 0) mpex[member] = MidiUMPin::bend(ev.value);
 				}else{
-					Mpit = msg.getValue() * 128 + msg.getNote(); //14bit Pitch Bend
+					Mpit = MidiUMPin::bend(ev.value);
 				}
 			} break;
-			// cc
-			case 0xb: {
+			// MIDI 2.0 per note pitch and controllers: a member channel plays one note
+			case MidiUMPin::NOTEBEND:{
+				if ((polyMode == MPE_MODE) && (member >= 0)) mpex[member] = MidiUMPin::bend(ev.value);
+			} break;
+			case MidiUMPin::NOTECC:{
+				if ((polyMode == MPE_MODE) && (member >= 0)){
+					if (ev.index == ((MPEmode == 1) ? 74 : mpeYcc)) mpey[member] = ev.value;
+					else if ((MPEmode != 1) && (ev.index == mpeZcc)) mpez[member] = ev.value;
+				}
+			} break;
+			case MidiUMPin::RPN:{
+				if ((polyMode == MPE_MODE) && !master){
+					if (ev.index == 0) pbMPE = clamp(static_cast<int>(ev.value >> 25), 0, 96);// member bend range
+				}else processCC(ev);
+			} break;
+			case MidiUMPin::CC: {
 				///////// LEARN CC   ???
 				if (learnIx > 0) {
-					midiCCs[learnIx - 1] = msg.getNote();
+					midiCCs[learnIx - 1] = ev.index;
 					learnIx = 0;
 					return;
-				}else if (polyMode == MPE_MODE){
-					if (msg.getChannel() == MPEmasterCh){
-						processCC(msg);
+				}else if ((polyMode == MPE_MODE) && !master){
+					if (member < 0){
+						return;
 					}else if (MPEmode == 1){ //Continuum
-						if (msg.getNote() == 87){
-							mpePlusLB[msg.getChannel() - MPEfirstCh] = msg.getValue();
-						}else if (msg.getNote() == 74){
-							mpey[msg.getChannel() - MPEfirstCh] =  msg.getValue() * 128 + mpePlusLB[msg.getChannel() - MPEfirstCh];
-							mpePlusLB[msg.getChannel() - MPEfirstCh] = 0;
+						if (ev.index == 87){
+							mpePlusLB[member] = ev.value >> 25;
+						}else if (ev.index == 74){
+							mpey[member] = plusValue(member, ev.value);
 						}
-
-					}else if (msg.getNote() == mpeYcc){
+					}else if (ev.index == mpeYcc){
 					//cc74 0x4a default
-						mpey[msg.getChannel() - MPEfirstCh] = msg.getValue() * 128;
-					}else if (msg.getNote() == mpeZcc){
-						mpez[msg.getChannel() - MPEfirstCh] = msg.getValue() * 128;
+						mpey[member] = ev.value;
+					}else if (ev.index == mpeZcc){
+						mpez[member] = ev.value;
 					}
 				}else{
-					processCC(msg);
+					processCC(ev);
 				}
 			} break;
 			default: break;
 		}
 	}
+	/// Haken MPE+: a 7-bit LSB sent ahead (CC 87) makes the next Y or Z 14-bit
+	uint32_t plusValue(int member, uint32_t value) {
+		if (!mpePlusLB[member]) return value;
+		uint32_t fine = MidiUMPin::scaleUp(((value >> 25) << 7) | mpePlusLB[member], 14, 32);
+		mpePlusLB[member] = 0;
+		return fine;
+	}
 
-	void processCC(midi::Message msg) {
-		if (msg.getNote() ==  0x40) { //internal sust pedal
-			if (msg.getValue() >= 64)
+	/// master / poly channel controllers, 32-bit values. RPN 0 sets the main bend range
+	void processCC(const MidiUMPin::Event &cc) {
+		if (cc.kind == MidiUMPin::RPN){
+			if (cc.index == 0) pbMain = clamp(static_cast<int>(cc.value >> 25), 0, 96);
+			return;
+		}
+		if (cc.index ==  0x40) { //internal sust pedal
+			if (cc.value >= 0x80000000u)
 				pressPedal();
 			else
 				releasePedal();
 		}
 		for (int i = 0; i < 6; i++){
-			if (midiCCs[i] == msg.getNote()){
-				midiCCsVal[i] = msg.getValue();
+			if (midiCCs[i] == cc.index){
+				midiCCsVal[i] = cc.value;
 				return;
 			}
 		}
@@ -943,22 +1043,31 @@ struct MIDI8MPE : Module {
 // Main Display
 struct PolyModeDisplayB : TransparentWidget {
 	PolyModeDisplayB(){
-		font = APP->window->loadFont(mFONT_FILE);
+		font = pluginFont(mFONT_FILE);
 	}
 	
 	MIDI8MPE *module;
+	DispFlash *flash = NULL;
 	
 	int pointerinit = 0;
 	float mdfontSize = 12.f;
-	std::string sMode ="";
-	std::string sVo ="";
-	std::string sPBM ="";
-	std::string sPBMPE ="";
-	std::string sMPEmidiCh = "";
-	std::string yyDisplay = "";
-	std::string zzDisplay = "";
+	const char *sMode = "";
+	DispText sVo;
+	DispText sPBM;
+	DispText sPBMPE;
+	DispText sMPEmidiCh;
+	DispText yyDisplay;
+	DispText zzDisplay;
+	/// last formatted values
+	int q_numVo = -1;
+	int q_pbMain = -1;
+	int q_pbMPE = -1;
+	int q_MPEmasterCh = -1;
+	int q_MPEfirstCh = -1;
+	int q_YccNumber = -1;
+	int q_ZccNumber = -1;
 	std::shared_ptr<Font> font;
-	std::string polyModeStr[6] = {
+	const char *polyModeStr[6] = {
 		"M. P. E.",
 		"C Y C L E",
 		"R E U S E",
@@ -966,65 +1075,83 @@ struct PolyModeDisplayB : TransparentWidget {
 		"R E A S S I G N",
 		"U N I S O N",
 	};
-	int drawFrame = 0;
 	int cursorIxI = 0;
-	int flashFocus = 0;
+	const Rect focusBoxes[7] = {
+		Rect(1.f, 1.f, 130.f, 12.f),// PolyMode
+		Rect(1.f, 14.f, 130.f, 12.f),//numVoices Poly
+		Rect(1.f, 14.f, 130.f, 12.f),//MPE channels
+		Rect(1.f, 27.f, 52.f, 12.f),//mainPB
+		Rect(54.f, 27.f, 77.f, 12.f),//mpePB
+		Rect(50.f, 42.f, 31.f, 13.f),//YY
+		Rect(82.f, 42.f, 31.f, 13.f),//ZZ
+	};
+	/// cached in a framebuffer (module display generation), the focus flash runs on the overlay
 	void draw(const DrawArgs &args) override {
 		if (module) {
-			int p_polyMode = module->polyModeIx;
-			int p_MPEmode = module->MPEmode;
-			int p_numVo = module->numVo;
-			int p_pbMain = module->pbMain;
-			int p_pbMPE = module->pbMPE;
-			int p_MPEmasterCh = module->MPEmasterCh;
-			int p_MPEfirstCh = module->MPEfirstCh;
-			int p_YccNumber = module->displayYcc;
-			int p_ZccNumber = module->displayZcc;
-			int p_cursorIx = module->cursorIx;
-		
-		if (drawFrame ++ > 5){
-			drawFrame = 0;
-					if (p_polyMode < 1) {
-						if (p_MPEmode == 1) sMode = "M. P. E. Plus";/// Continuum Hi Res YZ
-						else if (p_MPEmode > 1) sMode = "M. P. E. w RelVel";
-						else sMode = polyModeStr[p_polyMode];
-					}else{
-						sMode = polyModeStr[p_polyMode];
-					}
-					sVo = "Poly "+ std::to_string(p_numVo) +" Vo outs";
-					sPBM = "PBend:" + std::to_string(p_pbMain);
-					sPBMPE = " CH PBend:" + std::to_string(p_pbMPE);
-					sMPEmidiCh = "channels M:" + std::to_string(p_MPEmasterCh + 1) + " Vo:" + std::to_string(p_MPEfirstCh + 1) + "++";
-
-					switch (p_YccNumber) {
-						case 129 :{//(locked)  Rel Vel
-							yyDisplay = "rVel";
-						}break;
-						case 131 :{//HiRes MPE Y
-							yyDisplay = "cc74+";
-						}break;
-						default :{
-							yyDisplay = "cc" + std::to_string(p_YccNumber);
-						}
+			const MIDI8MPE::DispState &d = module->dispSnap.read();
+			int p_polyMode = d.polyModeIx;
+			int p_MPEmode = d.MPEmode;
+			int p_numVo = d.numVo;
+			int p_pbMain = d.pbMain;
+			int p_pbMPE = d.pbMPE;
+			int p_MPEmasterCh = d.MPEmasterCh;
+			int p_MPEfirstCh = d.MPEfirstCh;
+			int p_YccNumber = d.displayYcc;
+			int p_ZccNumber = d.displayZcc;
+			int p_cursorIx = d.cursorIx;
+			if (p_polyMode < 1) {
+				if (p_MPEmode == 1) sMode = "M. P. E. Plus";/// Continuum Hi Res YZ
+				else if (p_MPEmode > 1) sMode = "M. P. E. w RelVel";
+				else sMode = polyModeStr[p_polyMode];
+			}else{
+				sMode = polyModeStr[p_polyMode];
+			}
+			if (q_numVo != p_numVo){
+				q_numVo = p_numVo;
+				sVo.set("Poly ").add(p_numVo).add(" Vo outs");
+			}
+			if (q_pbMain != p_pbMain){
+				q_pbMain = p_pbMain;
+				sPBM.set("PBend:").add(p_pbMain);
+			}
+			if (q_pbMPE != p_pbMPE){
+				q_pbMPE = p_pbMPE;
+				sPBMPE.set(" CH PBend:").add(p_pbMPE);
+			}
+			if ((q_MPEmasterCh != p_MPEmasterCh) || (q_MPEfirstCh != p_MPEfirstCh)){
+				q_MPEmasterCh = p_MPEmasterCh;
+				q_MPEfirstCh = p_MPEfirstCh;
+				sMPEmidiCh.set("channels M:").add(p_MPEmasterCh + 1).add(" Vo:").add(p_MPEfirstCh + 1).add("++");
+			}
+			if (q_YccNumber != p_YccNumber){
+				q_YccNumber = p_YccNumber;
+				switch (p_YccNumber) {
+					case 129 :{//(locked)  Rel Vel
+						yyDisplay.set("rVel");
+					}break;
+					case 131 :{//HiRes MPE Y
+						yyDisplay.set("cc74+");
+					}break;
+					default :{
+						yyDisplay.set("cc").add(p_YccNumber);
 					}
-					switch (p_ZccNumber) {
-						case 128 :{
-							zzDisplay = "chnAT";
-						}break;
-						case 130 :{//(locked)  note AfterT
-							zzDisplay = "nteAT";
-						}break;
-						case 132 :{//HiRes MPE Z
-							zzDisplay = "chAT+";
-						}break;
-						default :{
-							zzDisplay = "cc" + std::to_string(p_ZccNumber);
-						}
+				}
+			}
+			if (q_ZccNumber != p_ZccNumber){
+				q_ZccNumber = p_ZccNumber;
+				switch (p_ZccNumber) {
+					case 128 :{
+						zzDisplay.set("chnAT");
+					}break;
+					case 130 :{//(locked)  note AfterT
+						zzDisplay.set("nteAT");
+					}break;
+					case 132 :{//HiRes MPE Z
+						zzDisplay.set("chAT+");
+					}break;
+					default :{
+						zzDisplay.set("cc").add(p_ZccNumber);
 					}
-				//}
-				if (cursorIxI != p_cursorIx){
-					cursorIxI = p_cursorIx;
-					flashFocus = 64;
 				}
 			}
 			nvgFontSize(args.vg, mdfontSize);
@@ -1032,7 +1159,7 @@ struct PolyModeDisplayB : TransparentWidget {
 			nvgFillColor(args.vg, nvgRGB(0xcc, 0xcc, 0xcc));//Text
 			//nvgGlobalCompositeOperation(args.vg, NVG_SOURCE_OUT);
 			nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
-			nvgTextBox(args.vg, 4.f, 11.0f,124.f, sMode.c_str(), NULL);
+			nvgTextBox(args.vg, 4.f, 11.0f,124.f, sMode, NULL);
 			nvgTextBox(args.vg, 50.f, 52.f, 31.f, yyDisplay.c_str(), NULL);// YY
 			nvgTextBox(args.vg, 82.f, 52.f, 31.f, zzDisplay.c_str(), NULL);// ZZ
 			
@@ -1046,151 +1173,128 @@ struct PolyModeDisplayB : TransparentWidget {
 			
 			nvgTextAlign(args.vg, NVG_ALIGN_LEFT);
 			nvgTextBox(args.vg, 4.f, 37.0f, 50.f, sPBM.c_str(), NULL);
-			nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
-			nvgBeginPath(args.vg);
-			switch (cursorIxI){
-				case 0:{ // PolyMode
-					nvgRoundedRect(args.vg, 1.f, 1.f, 130.f, 12.f, 3.f);
-				}break;
-				case 1:{ //numVoices Poly
-					nvgRoundedRect(args.vg, 1.f, 14.f, 130.f, 12.f, 3.f);
-				}break;
-				case 2:{ //MPE channels
-					nvgRoundedRect(args.vg, 1.f, 14.f, 130.f, 12.f, 3.f);
-				}break;
-				case 3:{//mainPB
-					nvgRoundedRect(args.vg, 1.f, 27.f, 52.f, 12.f, 3.f);
-				}break;
-				case 4:{//mpePB
-					nvgRoundedRect(args.vg, 54.f, 27.f, 77.f, 12.f, 3.f);
-				}break;
-				case 5:{//YY
-					nvgRoundedRect(args.vg, 50.f, 42.f, 31, 13.f, 3.f);
-				}break;
-				case 6:{//ZZ
-					nvgRoundedRect(args.vg, 82.f, 42.f, 31, 13.f, 3.f);
-				}break;
-			}
-			if (flashFocus > 0)
-				flashFocus -= 2;
-			int rgbint = 0x55 + flashFocus;
-			nvgFillColor(args.vg, nvgRGB(rgbint,rgbint,rgbint)); //SELECTED
-			nvgFill(args.vg);
+			if ((p_cursorIx > -1) && (p_cursorIx < 7)){
+				const Rect &r = focusBoxes[p_cursorIx];
+				nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
+				nvgBeginPath(args.vg);
+				nvgRoundedRect(args.vg, r.pos.x, r.pos.y, r.size.x, r.size.y, 3.f);
+				nvgFillColor(args.vg, nvgRGB(0x55,0x55,0x55)); //SELECTED
+				nvgFill(args.vg);
+				if (cursorIxI != p_cursorIx) flash->focus(r, 64, 2);
+			}else flash->fade = 0;
+			cursorIxI = p_cursorIx;
 		} else{///PREVIEW
-			std::shared_ptr<Font> mfont;
-			std::string s1 = "MIDI to 8ch";
-			std::string s2 = "CV with MPE";
-			font = APP->window->loadFont(mFONT_FILE);
+			font = pluginFont(mFONT_FILE);
 			nvgFontSize(args.vg, 20.f);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
 			nvgFillColor(args.vg, nvgRGB(0xDD,0xDD,0xDD));
-			nvgTextBox(args.vg, 0.f, 16.f,box.size.x, s1.c_str(), NULL);
-			nvgTextBox(args.vg, 0.f, 36.f,box.size.x, s2.c_str(), NULL);
+			nvgTextBox(args.vg, 0.f, 16.f,box.size.x, "MIDI to 8ch", NULL);
+			nvgTextBox(args.vg, 0.f, 36.f,box.size.x, "CV with MPE", NULL);
 		}
 	}
 };
 
+/// the 6 CC labels as one grid: one path per color class and the text in a single font state
 struct MidiccDisplayB : TransparentWidget {
 	MidiccDisplayB(){
-	font = APP->window->loadFont(mFONT_FILE);
+	font = pluginFont(mFONT_FILE);
 }
+	static const int numCells = 6;
 	MIDI8MPE *module;
+	DispFlash *flash = NULL;
 	float mdfontSize = 12.f;
-	std::string sDisplay = "";
-	int pointerinit = 0;
+	float cellWidth = 26.f;
+	float cellPitch = 27.f;
+	DispText sDisplay[numCells];
 	int p_cursor = 0;
 	int cursorI = -1;
-	int displayID = 0;//set on each instance
-	int ccNumber = -1;
-	bool learnOn = false;
-	bool learnChanged = false;
+	int learnCell = -1;
+	int ccNumber[numCells] = {-1,-1,-1,-1,-1,-1};
+	bool learnChanged[numCells] = {false};
 
-	int flashFocus = 0;
-	int displayFrames = 0;
 	std::shared_ptr<Font> font;
-	void draw(const DrawArgs &args) override{
-
-		if ((module) && (displayFrames ++ > 5)){
-			displayFrames = 0;
-			int p_ccNumber = module->midiCCs[displayID];
-			p_cursor = module->cursorIx - 7;
-			//int p_learnIx = ;
-			learnOn = (displayID + 1 == module->learnIx);
-			if (learnOn){
-				learnChanged = true;
-				sDisplay = "LRN";
-			}else if ((ccNumber != p_ccNumber) || (learnChanged)){
-				learnChanged = false;
-				ccNumber = p_ccNumber;
-				switch (ccNumber) {
-					case 128 :{
-						sDisplay = "PBnd";
-					}break;
-					case 129 :{
-						sDisplay = "chAT";
-					}break;
-					case 1 :{
-						sDisplay = "Mod";
-					}break;
-					case 2 :{
-						sDisplay = "BrC";
-					}break;
-					case 7 :{
-						sDisplay = "Vol";
-					}break;
-					case 10 :{
-						sDisplay = "Pan";
-					}break;
-					case 11 :{
-						sDisplay = "Expr";
-					}break;
-					case 64 :{
-						sDisplay = "Sust";
-					}break;
-					default :{
-						sDisplay = "c" + std::to_string(ccNumber);
-					}
+	void cellRect(NVGcontext *vg, int i){
+		nvgRoundedRect(vg, i * cellPitch, 0.f, cellWidth, box.size.y, 3.f);
+	}
+	void cellText(int i, int p_ccNumber){
+		if (i == learnCell){
+			learnChanged[i] = true;
+			sDisplay[i].set("LRN");
+		}else if ((ccNumber[i] != p_ccNumber) || (learnChanged[i])){
+			learnChanged[i] = false;
+			ccNumber[i] = p_ccNumber;
+			switch (ccNumber[i]) {
+				case 128 :{
+					sDisplay[i].set("PBnd");
+				}break;
+				case 129 :{
+					sDisplay[i].set("chAT");
+				}break;
+				case 1 :{
+					sDisplay[i].set("Mod");
+				}break;
+				case 2 :{
+					sDisplay[i].set("BrC");
+				}break;
+				case 7 :{
+					sDisplay[i].set("Vol");
+				}break;
+				case 10 :{
+					sDisplay[i].set("Pan");
+				}break;
+				case 11 :{
+					sDisplay[i].set("Expr");
+				}break;
+				case 64 :{
+					sDisplay[i].set("Sust");
+				}break;
+				default :{
+					sDisplay[i].set("c").add(ccNumber[i]);
 				}
 			}
 		}
-		if (learnOn) {
+	}
+	/// cached in a framebuffer (module display generation), the focus flash runs on the overlay
+	void draw(const DrawArgs &args) override{
+		if (module){
+			const MIDI8MPE::DispState &d = module->dispSnap.read();
+			p_cursor = d.cursorIx - 7;
+			learnCell = d.learnIx - 1;
+			for (int i = 0; i < numCells; i++) cellText(i, d.midiCCs[i]);
+		}
+		if ((learnCell > -1) && (learnCell < numCells)) {
 			nvgBeginPath(args.vg);
-			nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y,3.f);
+			cellRect(args.vg, learnCell);
 			nvgStrokeColor(args.vg, nvgRGB(0xdd, 0x0, 0x0));
 			nvgStroke(args.vg);
-			nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y,3.f);
-
 			nvgFillColor(args.vg, nvgRGBA(0xcc, 0x0, 0x0,0x64));
 			nvgFill(args.vg);
-			///text color
-			nvgFillColor(args.vg, nvgRGB(0xff, 0x00, 0x00));//LEARN
-		}else{
-			///text color
-			nvgFillColor(args.vg, nvgRGB(0xcc, 0xcc, 0xcc));
 		}
 		nvgFontSize(args.vg, mdfontSize);
 		nvgFontFaceId(args.vg, font->handle);
 		nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
-		nvgTextBox(args.vg, 0.f, 10.f,box.size.x, sDisplay.c_str(), NULL);
-
+		///text color
+		nvgFillColor(args.vg, nvgRGB(0xcc, 0xcc, 0xcc));
+		for (int i = 0; i < numCells; i++) {
+			if (i != learnCell) nvgTextBox(args.vg, i * cellPitch, 10.f, cellWidth, sDisplay[i].c_str(), NULL);
+		}
+		if ((learnCell > -1) && (learnCell < numCells)) {
+			nvgFillColor(args.vg, nvgRGB(0xff, 0x00, 0x00));//LEARN
+			nvgTextBox(args.vg, learnCell * cellPitch, 10.f, cellWidth, sDisplay[learnCell].c_str(), NULL);
+		}
 		if (cursorI != p_cursor){
 			cursorI = p_cursor;
-			if (p_cursor == displayID)
-				flashFocus = 64;
+			if ((p_cursor > -1) && (p_cursor < numCells))
+				flash->focus(Rect(p_cursor * cellPitch, 0.f, cellWidth, box.size.y), 64, 2);
 		}
-		if ((displayID == cursorI) && (!learnOn)){
+		if ((cursorI > -1) && (cursorI < numCells) && (cursorI != learnCell)){
 			nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
 			nvgBeginPath(args.vg);
-			nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y,3.f);
-//			nvgStrokeColor(args.vg, nvgRGB(0x66, 0x66, 0x66));
-//			nvgStroke(args.vg);
-			if (flashFocus > 0)
-				flashFocus -= 2;
-			int rgbint = 0x55 + flashFocus;
-			nvgFillColor(args.vg, nvgRGB(rgbint,rgbint,rgbint)); //SELECTED
+			cellRect(args.vg, cursorI);
+			nvgFillColor(args.vg, nvgRGB(0x55,0x55,0x55)); //SELECTED
 			nvgFill(args.vg);
-		}
+		}else flash->fade = 0;
 	}
 };
 
@@ -1198,7 +1302,7 @@ struct BlockChannel : OpaqueWidget {
 	MIDI8MPE *module;
 	void draw(const DrawArgs &args) override {
 		if (module) {
-		int p_polyMode = module->polyModeIx;
+		int p_polyMode = module->dispSnap.read().polyModeIx;
 		if ( p_polyMode > 0) {
 				box.size = Vec(0.f,0.f);
 			}else{
@@ -1218,8 +1322,8 @@ struct learnMccButton : SvgSwitch {
 	learnMccButton() {
 		momentary = true;
 		box.size = Vec(26, 13);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/learnMcc_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/learnMcc_1.svg")));
+		addFrame(pluginSvg("res/learnMcc_0.svg"));
+		addFrame(pluginSvg("res/learnMcc_1.svg"));
 	}
 	void randomize() override{
 	}
@@ -1229,7 +1333,7 @@ struct springDataKnob : SvgKnob {
 	springDataKnob() {
 		minAngle = -0.75*M_PI;
 		maxAngle = 0.75*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dataKnob.svg")));
+		setSvg(pluginSvg("res/dataKnob.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -1246,7 +1350,7 @@ struct springDataKnob : SvgKnob {
 
 struct OutdatedAlert : SvgWidget {
 	OutdatedAlert(){
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/outdMIDI8MPE.svg")));
+		setSvg(pluginSvg("res/outdMIDI8MPE.svg"));
 	}
 	void onButton(const event::Button &e) override{
 		if (e.action == GLFW_RELEASE) {
@@ -1254,20 +1358,37 @@ struct OutdatedAlert : SvgWidget {
 			if (this->box.size.y > 15.f) {
 				this->box.size = {15.f, 15.f};
 				this->box.pos = {180.f, 0.f};
-				this->setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/outdMIDI8MPEx.svg")));
+				this->setSvg(pluginSvg("res/outdMIDI8MPEx.svg"));
 			}else {
 				this->box.size = {195.f, 15.f};
 				this->box.pos = {0.f, 0.f};
-				this->setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/outdMIDI8MPE.svg")));
+				this->setSvg(pluginSvg("res/outdMIDI8MPE.svg"));
 			}
 		}
 	}
 };
 
 struct MIDI8MPEWidget : ModuleWidget {
+	/// display generation taken from the module snapshot (framebuffers compare it)
+	unsigned int dispGen = 0;
+	void step() override {
+		MIDI8MPE *module = dynamic_cast<MIDI8MPE*>(this->module);
+		if (module) delete module->umpDone.exchange(NULL);
+		if (module && module->dispSnap.update()) dispGen = module->dispSnap.read().gen;
+		ModuleWidget::step();
+	}
+	/// display in its framebuffer (module display generation) with the focus flash overlay on top
+	template <class TDisplay>
+	void addCachedDisplay(TDisplay *display, MIDI8MPE *module){
+		DispFlash *flash = dispFlashOver(display);
+		flash->additive = true;
+		display->flash = flash;
+		addChild(dispCache(display, (module) ? &dispGen : NULL));
+		addChild(flash);
+	}
 	MIDI8MPEWidget(MIDI8MPE *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance,"res/MIDI8MPE.svg")));
+		setPanel(pluginSvg("res/MIDI8MPE.svg"));
 		
 		//Screws
 		addChild(createWidget<ScrewBlack>(Vec(0, 0)));
@@ -1319,7 +1440,7 @@ struct MIDI8MPEWidget : ModuleWidget {
 			polyModeDisplay->box.pos = Vec(xPos, yPos);
 			polyModeDisplay->box.size = {132.f, 54.f};
 			polyModeDisplay->module = module;
-			addChild(polyModeDisplay);
+			addCachedDisplay(polyModeDisplay, module);
 		}
 		
 		yPos = 20.f;
@@ -1363,14 +1484,15 @@ struct MIDI8MPEWidget : ModuleWidget {
 		
 		yPos = 322.f;
 		xPos = 9.f;
+		{
+			MidiccDisplayB *MccDisplay = new MidiccDisplayB();
+			MccDisplay->box.pos = Vec(xPos, yPos);
+			MccDisplay->box.size = {6 * 27.f - 1.f, 13.f};
+			MccDisplay->module = module;
+			addCachedDisplay(MccDisplay, module);
+		}
 		for (int i = 0; i < 6; i++){
-				MidiccDisplayB *MccDisplay = new MidiccDisplayB();
-				MccDisplay->box.pos = Vec(xPos, yPos);
-				MccDisplay->box.size = {26.f, 13.f};
-				MccDisplay->displayID = i;// + 7;
-				MccDisplay->module = module;
-				addChild(MccDisplay);
-				addParam(createParam<learnMccButton>(Vec(xPos, yPos), module, MIDI8MPE::LEARNCCA_PARAM + i));
+			addParam(createParam<learnMccButton>(Vec(xPos, yPos), module, MIDI8MPE::LEARNCCA_PARAM + i));
 			xPos += 27.f;
 		}
 		///Sustain hold notes		
@@ -1385,6 +1507,23 @@ struct MIDI8MPEWidget : ModuleWidget {
 		//addParam(createParam<OutdatedAlert>(Vec(0.f, 0.f), module, MIDI8MPE::OUTDATED_PARAM));
 		
 	}
+	void appendContextMenu(Menu *menu) override {
+		MIDI8MPE *module = dynamic_cast<MIDI8MPE*>(this->module);
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Smoothing"));
+		menu->addChild(createSmoothItem("MPE bend", &module->smoothX));
+		menu->addChild(createSmoothItem("MPE Y Z", &module->smoothYZ));
+		menu->addChild(createSmoothItem("CCs and bend", &module->smoothCC));
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Notes (split / layer with other modules)"));
+		menu->addChild(createKeyZoneItem(&module->zone));
+		menu->addChild(createVelocityCurveItem(&module->velCurve));
+		menu->addChild(new MenuEntry);
+		UMPfileItem *umpFileItem = createMenuItem<UMPfileItem>("Play UMP file (MIDI 2.0 test input)...");
+		umpFileItem->pending = &module->umpLoad;
+		umpFileItem->done = &module->umpDone;
+		menu->addChild(umpFileItem);
+	}
 };
 
 Model *modelMIDI8MPE = createModel<MIDI8MPE, MIDI8MPEWidget>("MIDI8MPE");
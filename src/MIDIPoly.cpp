@@ -17,6 +17,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https:www.gnu.org/licenses/>.
 */
 #include "moDllz.hpp"
+#include <osdialog.h> // groove file
 
 struct MidiNoteData {
 	uint8_t velocity = 0;
@@ -143,13 +144,18 @@ struct MIDIpoly16 : Module {
 	midi::InputQueue midiInput;
 	
 	uint8_t mod = 0;
-	dsp::ExponentialFilter modFilter;
+	Smoother modFilter;
 	uint16_t pitch = 8192;
-	dsp::ExponentialFilter pitchFilter;
+	Smoother pitchFilter;
 	uint8_t sustain = 0;
-	dsp::ExponentialFilter sustainFilter;
+	Smoother sustainFilter;
 	uint8_t pressure = 0;
-	dsp::ExponentialFilter pressureFilter;
+	Smoother pressureFilter;
+	/// output smoothing per destination (context menu)
+	SmoothShape smoothPB;
+	SmoothShape smoothCC;	// mod, sustain and pressure
+	KeyZone zone;
+	VelocityCurve velCurve;
 	
 	
 	MidiNoteData noteData[128];
@@ -167,7 +173,7 @@ struct MIDIpoly16 : Module {
 		float drift = 0.f;
 		bool gate = false;
 		bool button = false;
-		bool newkey = true;
+		int newkeys = 0; // counts new keys (velocity display)
 		int mode = 0;
 		bool learn = false;
 		int velseq = 127; //lastvel for seq
@@ -183,7 +189,7 @@ struct MIDIpoly16 : Module {
 	int polyIndex = 0;
 	int polyTopIndex = numPads-1;
 	int polymode = 0;
-	int lastpolyIndex = 0;
+	VoiceAllocator<numPads> voiceAlloc; // poly pads
 	int polyMaxVoices = 8;
 	int stampIx = 0;
 	int playingVoices = 0;
@@ -197,11 +203,19 @@ struct MIDIpoly16 : Module {
 	int arpclockRatio = 0;
 	int arpegIx = 0;
 	int arpegFrame = 0;
-	int arpOctIx = 0;
+	int arpOct = 0;
 	bool arpegStarted = false;
-	int arpegCycle = 0;
-	int arpOctValue = 0;
+	ArpEngine arp;
+	int arpOrder = ArpEngine::PADS_ORDER;
 	bool syncArpPhase = false;
+	
+	GrooveTemplate groove; // process side, shared by seq and arp clocks (swing switches select where it applies)
+	GrooveTemplate grooveSaved; // ui side copy: menu name, valid for saving
+	std::atomic<GrooveTemplate *> grooveLoad {NULL};	// ui -> process
+	std::atomic<GrooveTemplate *> grooveDone {NULL};	// process -> ui, the replaced one to free
+	bool grooveOn = false;
+	int seqGrooveIx = 0;
+	int arpGrooveIx = 0;
 	int arpDisplayIx = -1;
 	
 	const int octaveShift[7][5] =
@@ -222,7 +236,12 @@ struct MIDIpoly16 : Module {
 	bool pedal = false;
 	bool sustainhold = true;
 	
-	float drift[numPads] = {0.f};
+	DllzRandom rng; // per module drift source
+	DriftTable driftTable;
+	float driftPhase[numPads] = {0.f};
+	bool reproDrift = false; // reseed with driftSeed on reset (render runs repeat the same drift)
+	uint32_t driftSeed = 0;	// per instance, set on add (dllzClaimSeed)
+	int driftSeedOwner = -1;
 	
 	bool padSetLearn = false;
 	int padSetMode = 0;
@@ -239,10 +258,35 @@ struct MIDIpoly16 : Module {
 	int seqOctIx = 0;
 	int seqOctValue = 3;
 	int seqTransParam = 0;
-	int seqSampleCount = 0;
-	int arpSampleCount = 0;
-	int ClockSeqSamples = 1;
-	int ClockArpSamples = 1;
+	
+	struct SongEntry {
+		int first = 0;
+		int steps = 16;
+		int repeats = 1;
+	};
+	static const int maxSongEntries = 64;
+	SongEntry song[maxSongEntries]; // pattern chain (first pad / steps windows)
+	int songLength = 0;
+	bool songMode = false;
+	int songIx = 0;
+	int songRepeat = 0;
+	
+	//// live record (fixed size, written on the audio thread)
+	bool recArmed = false;
+	bool recReplace = false; // else overdub
+	float recStrength = 1.f; // quantize strength
+	float recOffset[numPads] = {0.f}; // recorded step timing (steps)
+	float seqGateLen[numPads]; // recorded gate length (steps, 1 = full step)
+	bool recTouched[numPads] = {false};
+	int recHeldNote = -1;
+	int recHeldPad = -1;
+	int recHeldSteps = 0;
+	float recHeldStart = 0.f;
+	float seqStepLen = 1.f; // current step length (phase)
+	int seqStepTicks = 24; // current step length (MIDI ticks)
+	
+	float ClockSeqSamples = 1.f;
+	float ClockArpSamples = 1.f;
 
 	const float ClockRatios[13] ={0.50f, 2.f/3.f,0.75f, 1.f ,4.f/3.f,1.5f, 2.f, 8.f/3.f, 3.f, 4.f, 6.f, 8.f,12.f};
 	const bool swingTriplet[13] = {true,true,false,true,true,false,true,true,false,true,false,true,false};
@@ -290,9 +334,6 @@ struct MIDIpoly16 : Module {
 	dsp::PulseGenerator stopPulse;
 	
 	bool clkMIDItick = false;
-	bool MIDIstart = false;
-	bool MIDIstop = false;
-	bool MIDIcont = false;
 	bool stopped = true;
 	bool arpMIDItick = false;
 	bool seqMIDItick = false;
@@ -304,12 +345,51 @@ struct MIDIpoly16 : Module {
 	bool BPMdecimals = false;
 	bool firstBPM = true; ///to hold if no clock ...and skip first BPM calc...
 	bool extBPM = false;
-	int framedrift = 0;
 	int lockedM = 0;
 	int liveM = 0;
-	int bounced[numPads] = {0};
 	int MIDIframe = 0;
 	
+	/// what the displays show, published every dispDivider block
+	struct PadDisp {
+		int key = 0;
+		int vel = 0;
+		int mode = 0;
+		int newkeys = 0;
+		bool gate = false;
+		bool gateseq = false;
+		bool learn = false;
+		bool arp = false;
+		bool poly = false;
+	};
+	struct DispState {
+		PadDisp pads[numPads];
+		unsigned int padGen[numPads] = {0};
+		unsigned int mainGen = 0;
+		bool dispNotenumber = false;
+		int clockSource = 0;
+		bool BPMdecimals = false;
+		int displayedBPM = 0;
+		int seqclockRatio = 1;
+		int seqSteps = 16;
+		int seqOffset = 0;
+		int songIx = -1; // -1 song mode off
+		int songLength = 0;
+		bool recArmed = false;
+		int arpegStatus = 0;
+		int arpclockRatio = 0;
+		int polyMaxVoices = 8;
+		int playingVoices = 0;
+		int seqTrans = 0;
+		int polyTrans = 0;
+	};
+	DispSnapshot<DispState> dispSnap;
+	/// display generations (pads / main display)
+	DispGen padDisp[numPads];
+	DispGen mainDisp;
+	dsp::ClockDivider dispDivider;
+	/// lights are written at the divider rate only
+	dsp::ClockDivider lightDivider;
+	
 	///////////////
 	MIDIpoly16() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -364,21 +444,59 @@ struct MIDIpoly16 : Module {
 		configParam(MUTELOCKED_PARAM, 0.f, 1.f, 0.f);
 		configParam(MUTEPOLYA_PARAM, 0.f, 1.f, 0.f);
 		configParam(MUTEPOLYB_PARAM, 0.f, 1.f, 0.f);
+		seedDrift();
+		recClearTiming();
+		dispDivider.setDivision(256);
+		lightDivider.setDivision(256);
 	 onReset();
 	}
 
 	~MIDIpoly16() {
+		delete grooveLoad.exchange(NULL);
+		delete grooveDone.exchange(NULL);
 	};
+	/// ui thread: process() swaps it in and returns the replaced one through grooveDone
+	void loadGroove(const GrooveTemplate &newGroove){
+		grooveSaved = newGroove;
+		delete grooveDone.exchange(NULL);
+		delete grooveLoad.exchange(new GrooveTemplate(newGroove));
+	}
 	void doSequencer();
 	
 	void process(const ProcessArgs &args) override;
 	
+	void publishDisplay();
+	
+	void processLights(float lightTime);
+	
 	void processMessage(midi::Message msg);
 	
 	void processCC(midi::Message msg);
 	
 	void processSystem(midi::Message msg);
 	
+	void seqTransportStart();
+	
+	void seqTransportStop();
+	
+	void locateSongPos(int sixteenths);
+	
+	void locateSeq(int stepPos);
+	
+	void songNext();
+	
+	void songAddPattern();
+	
+	float seqStepFraction();
+	
+	int seqNextPad();
+	
+	void recordNote(int note, int vel);
+	
+	void recordNoteOff(int note);
+	
+	void recClearTiming();
+	
 	void pressNote(int note, int vel);
 
 	void releaseNote(int note);
@@ -396,9 +514,20 @@ struct MIDIpoly16 : Module {
 	float minmaxFit(float val, float minv, float maxv);
  
 	void MidiPanic();
+	
+	void seedDrift();
 
+	/// only the rates: pads, split and drawn curve survive a sample rate change
 	void onSampleRateChange() override {
-		onReset();
+		setRates();
+	}
+	void setRates(){
+		smoothPB.setSampleRate(APP->engine->getSampleRate());
+		smoothCC.setSampleRate(APP->engine->getSampleRate());
+	}
+	void onAdd() override {
+		dllzClaimSeed(driftSeed, driftSeedOwner, id);
+		seedDrift();
 	}
 	void onRandomize() override {
 		
@@ -415,16 +544,16 @@ struct MIDIpoly16 : Module {
 		}
 		polyIndex = 0;
 		polyTopIndex = 7;;
-		lastpolyIndex = 0;
+		zone.set(0, 127, 1, 127);
+		velCurve.set(VelocityCurve::LINEAR);
+		voiceAlloc.reset();
 		seqTransParam = 0;
 		for (int i = 0; i < NUM_OUTPUTS; i++){
 			outputs[i].value= 0.f;
 		}
 		params[SEQRESET_PARAM].setValue(0.f);
-		sustainFilter.lambda = 100.f * APP->engine->getSampleTime();
-		modFilter.lambda = 100.f * APP->engine->getSampleTime();
-		pressureFilter.lambda = 100.f * APP->engine->getSampleTime();
-		pitchFilter.lambda = 100.f * APP->engine->getSampleTime();
+		setRates();
+		if (reproDrift) seedDrift();
 	}
 	
 	json_t *dataToJson() override {
@@ -438,6 +567,36 @@ struct MIDIpoly16 : Module {
 		json_object_set_new(rootJ, "polytransp", json_integer(polyTransParam));
 		json_object_set_new(rootJ, "arpegmode", json_integer(arpegMode));
 		json_object_set_new(rootJ, "seqrunning", json_boolean(seqrunning));
+		json_object_set_new(rootJ, "reproDrift", json_boolean(reproDrift));
+		json_object_set_new(rootJ, "driftSeed", json_integer(driftSeed));
+		json_object_set_new(rootJ, "driftSeedOwner", json_integer(driftSeedOwner));
+		json_object_set_new(rootJ, "arpOrder", json_integer(arpOrder));
+		json_object_set_new(rootJ, "grooveOn", json_boolean(grooveOn));
+		json_object_set_new(rootJ, "groove", grooveSaved.toJson());
+		json_object_set_new(rootJ, "songMode", json_boolean(songMode));
+		json_t *songJ = json_array();
+		for (int i = 0; i < songLength; i++){
+			json_t *entryJ = json_array();
+			json_array_append_new(entryJ, json_integer(song[i].first));
+			json_array_append_new(entryJ, json_integer(song[i].steps));
+			json_array_append_new(entryJ, json_integer(song[i].repeats));
+			json_array_append_new(songJ, entryJ);
+		}
+		json_object_set_new(rootJ, "song", songJ);
+		json_object_set_new(rootJ, "recReplace", json_boolean(recReplace));
+		json_object_set_new(rootJ, "recStrength", json_real(recStrength));
+		json_t *recOffsetJ = json_array();
+		json_t *gateLenJ = json_array();
+		for (int i = 0; i < numPads; i++){
+			json_array_append_new(recOffsetJ, json_real(recOffset[i]));
+			json_array_append_new(gateLenJ, json_real(seqGateLen[i]));
+		}
+		json_object_set_new(rootJ, "recOffset", recOffsetJ);
+		json_object_set_new(rootJ, "gateLen", gateLenJ);
+		json_object_set_new(rootJ, "smoothPB", smoothPB.toJson());
+		json_object_set_new(rootJ, "smoothCC", smoothCC.toJson());
+		json_object_set_new(rootJ, "keyZone", zone.toJson());
+		json_object_set_new(rootJ, "velCurve", velCurve.toJson());
 		return rootJ;
 	}
 	
@@ -466,6 +625,61 @@ struct MIDIpoly16 : Module {
 		json_t *seqrunningJ = json_object_get(rootJ,("seqrunning"));
 		if (seqrunningJ)
 			seqrunning = json_is_true(seqrunningJ);
+		json_t *reproDriftJ = json_object_get(rootJ, "reproDrift");
+		if (reproDriftJ)
+			reproDrift = json_is_true(reproDriftJ);
+		json_t *driftSeedJ = json_object_get(rootJ, "driftSeed");
+		if (driftSeedJ)
+			driftSeed = json_integer_value(driftSeedJ);
+		json_t *driftSeedOwnerJ = json_object_get(rootJ, "driftSeedOwner");
+		if (driftSeedOwnerJ)
+			driftSeedOwner = json_integer_value(driftSeedOwnerJ);
+		json_t *arpOrderJ = json_object_get(rootJ, "arpOrder");
+		if (arpOrderJ)
+			arpOrder = clamp(static_cast<int>(json_integer_value(arpOrderJ)), 0, ArpEngine::NUM_ORDERS - 1);
+		json_t *grooveOnJ = json_object_get(rootJ, "grooveOn");
+		if (grooveOnJ)
+			grooveOn = json_is_true(grooveOnJ);
+		json_t *grooveJ = json_object_get(rootJ, "groove");
+		if (grooveJ){
+			GrooveTemplate loadedGroove;
+			loadedGroove.fromJson(grooveJ);
+			loadGroove(loadedGroove);
+		}
+		json_t *songModeJ = json_object_get(rootJ, "songMode");
+		if (songModeJ)
+			songMode = json_is_true(songModeJ);
+		json_t *songJ = json_object_get(rootJ, "song");
+		if (songJ){
+			songLength = 0;
+			for (size_t i = 0; (i < json_array_size(songJ)) && (songLength < maxSongEntries); i++){
+				json_t *entryJ = json_array_get(songJ, i);
+				if (json_array_size(entryJ) < 3) continue;
+				song[songLength].first = clamp(static_cast<int>(json_integer_value(json_array_get(entryJ, 0))), 0, numPads - 1);
+				song[songLength].steps = clamp(static_cast<int>(json_integer_value(json_array_get(entryJ, 1))), 1, numPads);
+				song[songLength].repeats = std::max(1, static_cast<int>(json_integer_value(json_array_get(entryJ, 2))));
+				songLength ++;
+			}
+		}
+		json_t *recReplaceJ = json_object_get(rootJ, "recReplace");
+		if (recReplaceJ)
+			recReplace = json_is_true(recReplaceJ);
+		json_t *recStrengthJ = json_object_get(rootJ, "recStrength");
+		if (recStrengthJ)
+			recStrength = clamp(static_cast<float>(json_number_value(recStrengthJ)), 0.f, 1.f);
+		json_t *recOffsetJ = json_object_get(rootJ, "recOffset");
+		json_t *gateLenJ = json_object_get(rootJ, "gateLen");
+		for (int i = 0; i < numPads; i++){
+			if (recOffsetJ && (i < static_cast<int>(json_array_size(recOffsetJ))))
+				recOffset[i] = clamp(static_cast<float>(json_number_value(json_array_get(recOffsetJ, i))), -0.45f, 0.45f);
+			if (gateLenJ && (i < static_cast<int>(json_array_size(gateLenJ))))
+				seqGateLen[i] = clamp(static_cast<float>(json_number_value(json_array_get(gateLenJ, i))), 0.05f, 1.f);
+		}
+		smoothPB.fromJson(json_object_get(rootJ, "smoothPB"));
+		smoothCC.fromJson(json_object_get(rootJ, "smoothCC"));
+		zone.fromJson(json_object_get(rootJ, "keyZone"));
+		velCurve.fromJson(json_object_get(rootJ, "velCurve"));
+		seedDrift();
 		
 		padSetMode = POLY_MODE;
 		padSetLearn = false;
@@ -506,7 +720,7 @@ void MIDIpoly16::pressNote(int note, int vel) {
  /////////play every matching locked note...
 			if ((note == noteButtons[i].key)  && (noteButtons[i].mode > 1)){
 				noteButtons[i].gate = true;
-				noteButtons[i].newkey = true; //same key but true to display velocity
+				noteButtons[i].newkeys ++; //same key but count to display velocity
 				noteButtons[i].vel = vel;
 				noteButtons[i].velseq = vel;
 				noteButtons[i].stamp = stampIx;
@@ -525,7 +739,7 @@ void MIDIpoly16::pressNote(int note, int vel) {
 		noteButtons[polyIndex].key = note;
 		noteButtons[polyIndex].vel = vel;
 		noteButtons[polyIndex].velseq = vel;
-		noteButtons[polyIndex].newkey = true;
+		noteButtons[polyIndex].newkeys ++;
 		noteButtons[polyIndex].gate = true;
 	}
 	return;
@@ -574,46 +788,34 @@ void MIDIpoly16::releasePedalNotes() {
 /////////////////////////////////////////////   SET POLY INDEX  /////////////////////////////////////////////
 void MIDIpoly16::setPolyIndex(int note){
 	 polymode = static_cast<int>(params[POLYMODE_PARAM].getValue());
+	int from = polyIndex - 1; // free pad search starts at polyIndex
 	if (polymode < 1) {
-		polyIndex ++;
+		from = polyIndex;
 	}else if (pedal && sustainhold){///check if note is held to recycle it....
 		for (int i = 0; i < numPads; i ++){
 				 if ((noteButtons[i].mode == POLY_MODE) && (noteButtons[i].gate) && (noteButtons[i].key == note)){
 					///note is already on....
-					lastpolyIndex = i;
+					voiceAlloc.stealIndex = i;
 					polyIndex = i;
 					return;
 				}
 			}
 	}else if (polymode > 1) {
-		polyIndex = 0;
-	}
-	int ii = polyIndex;
-	for (int i = 0; i < (polyTopIndex + 1); i ++){
-		if (ii > polyTopIndex) ii = 0;
-		//if (!(noteButtons[ii].locked)){
-		  if (noteButtons[ii].mode == POLY_MODE){
-			if (!noteButtons[ii].gate){
-				lastpolyIndex = ii;
-				polyIndex = ii;
-				return;
-			}
-		}
-		ii ++;
-	}
-	//////////scan to steal oldest note.......
-	lastpolyIndex ++;
-	ii = lastpolyIndex;
-	for (int i = 0; i < (polyTopIndex + 1); i ++){
-		if (ii > polyTopIndex) ii = 0;
-		if (noteButtons[ii].mode == POLY_MODE){
-			lastpolyIndex = ii;
-			polyIndex = ii;
-		  if (noteButtons[ii].vel > 0) noteBuffer.push_front(noteButtons[ii].key);		  ///////////////
-			return;
-		}
-		ii ++;
-	}
+		from = -1;
+	}
+	uint32_t polyPads = 0;
+	uint32_t gatePads = 0;
+	for (int i = 0; i < numPads; i ++){
+		if (noteButtons[i].mode == POLY_MODE) polyPads |= 1u << i;
+		if (noteButtons[i].gate) gatePads |= 1u << i;
+	}
+	voiceAlloc.numVoices = polyTopIndex + 1;
+	bool stolen = false;
+	int pad = voiceAlloc.allocate(gatePads, from, stolen, polyPads);
+	if (pad < 0) return;
+	polyIndex = pad;
+	//////////steal oldest note.......
+	if (stolen && (noteButtons[pad].vel > 0)) noteBuffer.push_front(noteButtons[pad].key);
 }
 
 ///////////////////////////////  END SET POLY INDEX  //////////////////////////////////////////////
@@ -634,13 +836,20 @@ void MIDIpoly16::processMessage(midi::Message msg) {
 	}
 		switch (msg.getStatus()) {
 			 case 0x8: {
+						recordNoteOff(msg.getNote() & 0x7f);
 						releaseNote(msg.getNote() & 0x7f);
 			 }
 							 break;
 			 case 0x9: {// note on
 				 if (msg.getValue() > 0) {
-					 pressNote((msg.getNote() & 0x7f), msg.getValue());
+					 int note = msg.getNote() & 0x7f;
+					 if (zone.learning) zone.learnPending(note, msg.getValue());
+					 if (!zone.takes(note, msg.getValue())) break;
+					 int vel = velCurve.lookup7(msg.getValue());
+					 recordNote(note, vel);
+					 pressNote(note, vel);
 				 } else {
+					 recordNoteOff(msg.getNote() & 0x7f);
 					 releaseNote(msg.getNote() & 0x7f);
 				 }
 			 }
@@ -692,21 +901,209 @@ void MIDIpoly16::processSystem(midi::Message msg) {
 				seqMIDItick = true;
 				arpMIDItick = true;
 			} break;
+			//// transport applies here so messages in the same block keep their order
+			case 0x2: {
+			  //  debug("song position");
+				if ((clockSource == 2) && (!inputs[SEQRUN_INPUT].isConnected()))
+					locateSongPos((msg.getValue() << 7) | msg.getNote());
+			} break;
 			case 0xa: {
 			  //  debug("start");
-				MIDIstart = true;
+				if ((clockSource == 2) && (!inputs[SEQRUN_INPUT].isConnected())){
+					locateSongPos(0);
+					arpTickCount = -1;
+					seqrunning = true;
+					seqTransportStart(); // pulses also on restart while running
+				}
 			} break;
 			case 0xb: {
 			  //  debug("continue");
-				MIDIcont = true;
+				if ((clockSource == 2) && (!inputs[SEQRUN_INPUT].isConnected())){
+					seqrunning = true;
+					if (stopped) seqTransportStart();
+				}
 			} break;
 			case 0xc: {
 			  //  debug("stop");
-				MIDIstop = true;
+				if ((clockSource == 2) && (!inputs[SEQRUN_INPUT].isConnected())){
+					seqrunning = false;
+					if (!stopped) seqTransportStop();
+				}
 			} break;
 			default: break;
 		}
 }
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIpoly16::seqTransportStart(){
+	stopped = false;
+	startPulse.trigger(1e-3);
+	clockPulse.trigger(1e-3);
+	if (clockSource < 2) {
+		//// MIDI clock keeps the position (continue / song position)
+		seqOctValue = static_cast<int> (params[SEQOCT_PARAM].getValue());
+		seqPhase = 0.f;
+		seqSwingDwn = true;
+		seqGrooveIx = 0;
+		arpPhase = 0.f;
+		arpSwingDwn = true;
+		arpGrooveIx = 0;
+		seqTickCount = 0;
+		arpTickCount = 0;
+	}
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIpoly16::seqTransportStop(){
+	lights[SEQRUNNING_LIGHT].value = 0.f;
+	noteButtons[seqStep].gateseq = false;
+	stopped = true;
+	stopPulse.trigger(1e-3);
+	for (int i = 0 ; i < 5; i++){
+		lights[SEQOCT_LIGHT + i].value = 0.f;
+	}
+	outputs[SEQGATE_OUTPUT].setVoltage(0.f);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// song position in 16ths (6 MIDI clocks), next clock lands on that position
+void MIDIpoly16::locateSongPos(int sixteenths){
+	int ticks = sixteenths * 6;
+	int ticksPerStep = static_cast<int>(24.f / ClockRatios[seqclockRatio] + 0.5f);
+	int stepPos = ticks / ticksPerStep;
+	locateSeq(stepPos);
+	seqTickCount = ticks % ticksPerStep - 1;
+	seqSwingDwn = (stepPos % 2 == 0);
+	seqGrooveIx = stepPos % GrooveTemplate::maxSteps;
+	seqResetNext = false;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// stepPos in clock steps from the song (or sequence) start
+void MIDIpoly16::locateSeq(int stepPos){
+	noteButtons[seqStep].gateseq = false;
+	seqOctValue = static_cast<int> (params[SEQOCT_PARAM].getValue());
+	bool notesFirst = (params[SEQOCTALT_PARAM].getValue() > 0.5f);
+	int numOcts = 1;
+	while ((numOcts < 5) && (octaveShift[seqOctValue][numOcts] <= 2)) numOcts++;
+	int notePos = (notesFirst) ? stepPos : stepPos / numOcts;
+	int cycles = 0; // completed sequence passes (octave change if notes first)
+	if (songMode && (songLength > 0)){
+		int songSteps = 0;
+		int songCycles = 0;
+		for (int i = 0; i < songLength; i++){
+			songSteps += song[i].steps * song[i].repeats;
+			songCycles += song[i].repeats;
+		}
+		cycles = (notePos / songSteps) * songCycles;
+		notePos %= songSteps;
+		for (int i = 0; i < songLength; i++){
+			int entrySteps = song[i].steps * song[i].repeats;
+			if (notePos < entrySteps){
+				songIx = i;
+				songRepeat = notePos / song[i].steps;
+				cycles += songRepeat;
+				notePos %= song[i].steps;
+				break;
+			}
+			notePos -= entrySteps;
+			cycles += song[i].repeats;
+		}
+		seqOffset = song[songIx].first;
+		seqSteps = song[songIx].steps;
+	}else{
+		cycles = notePos / seqSteps;
+		notePos %= seqSteps;
+	}
+	seqi = notePos;
+	if (notesFirst){
+		seqOctIx = cycles % numOcts;
+		seqiWoct = seqOctIx * seqSteps + seqi;
+	}else{
+		seqOctIx = stepPos % numOcts;
+		seqiWoct = seqi * numOcts + seqOctIx;
+	}
+	seqStep = (seqi + seqOffset) % numPads;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// 0 ~ 1 position inside the current seq step
+float MIDIpoly16::seqStepFraction(){
+	if (clockSource < 2) return clamp(seqPhase / seqStepLen, 0.f, 1.f);
+	return clamp(static_cast<float>(seqTickCount) / static_cast<float>(seqStepTicks), 0.f, 1.f);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+int MIDIpoly16::seqNextPad(){
+	if ((params[SEQOCTALT_PARAM].getValue() < 0.5f) && (octaveShift[seqOctValue][seqOctIx + 1] <= 2)) return seqStep;
+	return (((seqi + 1) % seqSteps) + seqOffset) % numPads;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// note on into the nearest seq pad, keeps (1 - strength) of the timing error
+void MIDIpoly16::recordNote(int note, int vel){
+	if ((!recArmed) || (!seqrunning)) return;
+	float stepFr = seqStepFraction();
+	int target = seqStep;
+	float early = stepFr;
+	if (stepFr >= 0.5f){
+		target = seqNextPad();
+		early = stepFr - 1.f;
+	}
+	if (noteButtons[target].mode != SEQ_MODE) return;
+	noteButtons[target].key = note;
+	noteButtons[target].velseq = vel;
+	noteButtons[target].newkeys ++;
+	recOffset[target] = clamp((1.f - recStrength) * (recOffset[target] + early), -0.45f, 0.45f);
+	seqGateLen[target] = 1.f;
+	recTouched[target] = true;
+	if (params[SEQSEND_PARAM + target].getValue() < 0.5f) params[SEQSEND_PARAM + target].setValue(1.f);
+	recHeldNote = note;
+	recHeldPad = target;
+	recHeldSteps = 0;
+	recHeldStart = stepFr;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIpoly16::recordNoteOff(int note){
+	if ((note != recHeldNote) || (recHeldPad < 0)) return;
+	float held = static_cast<float>(recHeldSteps) + seqStepFraction() - recHeldStart;
+	if (held < 1.f) seqGateLen[recHeldPad] = clamp(held, 0.05f, 1.f);
+	recHeldNote = -1;
+	recHeldPad = -1;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIpoly16::recClearTiming(){
+	for (int i = 0; i < numPads; i++){
+		recOffset[i] = 0.f;
+		seqGateLen[i] = 1.f;
+	}
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// sequence pass done... next song pattern
+void MIDIpoly16::songNext(){
+	if ((!songMode) || (songLength < 1)) return;
+	songRepeat ++;
+	if ((songIx >= songLength) || (songRepeat >= song[songIx].repeats)){
+		songRepeat = 0;
+		songIx = (songIx + 1) % songLength;
+	}
+	seqOffset = song[songIx].first;
+	seqSteps = song[songIx].steps;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIpoly16::songAddPattern(){
+	if ((songLength > 0) && (song[songLength - 1].first == seqOffset) && (song[songLength - 1].steps == seqSteps)){
+		song[songLength - 1].repeats ++;
+		return;
+	}
+	if (songLength >= maxSongEntries) return;
+	song[songLength].first = seqOffset;
+	song[songLength].steps = seqSteps;
+	song[songLength].repeats = 1;
+	songLength ++;
+}
+
+void MIDIpoly16::seedDrift() {
+	if (reproDrift) rng.seed(driftSeed);
+	else rng.seed(random::u64());
+	driftTable.fill(rng);
+	/// spread the pads over the table so they don't drift together
+	for (int i = 0; i < numPads; i++)
+		driftPhase[i] = static_cast<float>(i * DriftTable::tableSize / numPads);
+}
 
 void MIDIpoly16::MidiPanic() {
 	pitch = 8192;
@@ -754,7 +1151,91 @@ float MIDIpoly16::minmaxFit(float val, float minv, float maxv){
 ///////////////////////   ///////  /////////  ////////////  ////////////////////////////
 //////////////         /////////  /////////          ////  ////////////////////////////
 
+void MIDIpoly16::publishDisplay() {
+	DispState &d = dispSnap.write();
+	bool changed = false;
+	d.dispNotenumber = dispNotenumber;
+	for (int i = 0; i < numPads; i++){
+		PadDisp &p = d.pads[i];
+		p.key = noteButtons[i].key;
+		p.vel = noteButtons[i].vel;
+		p.mode = noteButtons[i].mode;
+		p.newkeys = noteButtons[i].newkeys;
+		p.gate = noteButtons[i].gate;
+		p.gateseq = noteButtons[i].gateseq;
+		p.learn = noteButtons[i].learn;
+		p.arp = (arpDisplayIx == i);
+		p.poly = (polyIndex == i);
+		DispGen &pad = padDisp[i];
+		pad.begin();
+		pad.add(p.key);
+		pad.add(p.vel);
+		pad.add(p.mode);
+		pad.add(p.newkeys);
+		pad.add(p.gate);
+		pad.add(p.gateseq);
+		pad.add(p.learn);
+		pad.add(p.arp);
+		pad.add(p.poly);
+		pad.add(d.dispNotenumber);
+		changed |= pad.end();
+		d.padGen[i] = pad.gen;
+	}
+	d.clockSource = clockSource;
+	d.BPMdecimals = BPMdecimals;
+	d.displayedBPM = displayedBPM;
+	d.seqclockRatio = seqclockRatio;
+	d.seqSteps = seqSteps;
+	d.seqOffset = seqOffset;
+	d.songIx = (songMode) ? songIx : -1;
+	d.songLength = songLength;
+	d.recArmed = recArmed;
+	d.arpegStatus = arpegStatus;
+	d.arpclockRatio = arpclockRatio;
+	d.polyMaxVoices = polyMaxVoices;
+	d.playingVoices = playingVoices;
+	d.seqTrans = seqTransParam;
+	d.polyTrans = polyTransParam;
+	mainDisp.begin();
+	mainDisp.add(d.clockSource);
+	mainDisp.add(d.BPMdecimals);
+	mainDisp.add(d.displayedBPM);
+	mainDisp.add(d.seqclockRatio);
+	mainDisp.add(d.seqSteps);
+	mainDisp.add(d.seqOffset);
+	mainDisp.add(d.songIx);
+	mainDisp.add(d.songLength);
+	mainDisp.add(d.recArmed);
+	mainDisp.add(d.arpegStatus);
+	mainDisp.add(d.arpclockRatio);
+	mainDisp.add(d.polyMaxVoices);
+	mainDisp.add(d.playingVoices);
+	mainDisp.add(d.seqTrans);
+	mainDisp.add(d.polyTrans);
+	changed |= mainDisp.end();
+	d.mainGen = mainDisp.gen;
+	if (changed) dispSnap.publish();
+}
+///////////////////////////////////////////////////////////////////////////////
+/// step lights follow seqStep with the Rack smoothing, flash lights fade in 1/4 s at any sample rate
+void MIDIpoly16::processLights(float lightTime) {
+	if (seqrunning){
+		for (int i = 0; i < numPads; i++)
+			lights[SEQ_LIGHT + i].setBrightnessSmooth((seqStep == i) ? 1.f : 0.f, lightTime);
+	}
+	fadeLight(lights[RESETMIDI_LIGHT], lightTime);
+	fadeLight(lights[SEQRESET_LIGHT], lightTime);
+}
+///////////////////////////////////////////////////////////////////////////////
 void MIDIpoly16::process(const ProcessArgs &args) {
+	if (dispDivider.process()) publishDisplay();
+	if (lightDivider.process()) processLights(args.sampleTime * lightDivider.getDivision());
+	if (!grooveDone.load()){// the ui frees the replaced groove, nothing is freed here
+		if (GrooveTemplate *loaded = grooveLoad.exchange(NULL)){
+			std::swap(groove, *loaded);
+			grooveDone.store(loaded);
+		}
+	}
 	
 	//// mono modes and indexes
 	int liveMonoMode = static_cast <int>(params[MONOPITCH_PARAM].getValue());
@@ -785,19 +1266,16 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 	}
 	
 	bool analogdrift = (params[DRIFT_PARAM].getValue() > 0.0001f);
-	bool newdrift = false;
+	float dlimit = 0.f;
+	float driftInc = 0.f;
 	if (analogdrift){
-		if (framedrift > args.sampleRate)
-		{
-			newdrift = true;
-			framedrift = 4 * rand() % static_cast<int>(args.sampleRate/2.f);
-		}else{
-			newdrift = false;
-			framedrift++;
-		}
+		dlimit = (0.1f + params[DRIFT_PARAM].getValue() )/ 26.4f;
+		driftInc = (0.5f + params[DRIFT_PARAM].getValue() * 5.f) * args.sampleTime; // ~ table points per second
 	}
 	//////////////////////////////
 	playingVoices = 0;
+	uint32_t arpHeld = 0; // poly pads on, with their keys / stamps hashed in arpSig
+	uint32_t arpSig = 2166136261u;
 	bool monogate = false;
  //   bool retrigLive = false;
 	bool lockedgate = false;
@@ -848,6 +1326,8 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 			// get mono values
 			if (noteButtons[i].mode == POLY_MODE){
 				playingVoices ++;
+				arpHeld |= 1u << i;
+				arpSig = (arpSig ^ (static_cast<uint32_t>(i) | (static_cast<uint32_t>(noteButtons[i].key) << 4) | (static_cast<uint32_t>(noteButtons[i].stamp) << 11))) * 16777619u;
 				switch (liveMonoMode){
 					case 0:{
 						//// get lowest pressed note
@@ -902,21 +1382,8 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 			}
 		   ///////// POLY PITCH OUTPUT///////////////////////
 				if (analogdrift){
-					float dlimit = (0.1f + params[DRIFT_PARAM].getValue() )/ 26.4f;
-					const float driftfactor = 1e-9f;
-					if (newdrift) {
-						bounced[i] = 0;
-						int randrange = static_cast<int>(1.f + params[DRIFT_PARAM].getValue()) * 300;
-						drift[i] = (static_cast<float>(rand() % randrange * 2 - randrange)) * driftfactor * ( 0.5f + params[DRIFT_PARAM].getValue());
-					}	   //
-					noteButtons[i].drift += drift[i];
-					if ((bounced[i] < 1) && (noteButtons[i].drift > dlimit ))  {
-						drift[i] = -drift[i];
-						bounced[i] = 1;
-					}else if ((bounced[i] > -1) && (noteButtons[i].drift < - dlimit ))  {
-						drift[i] = -drift[i];
-						bounced[i] = -1;
-					}
+					driftPhase[i] = DriftTable::wrap(driftPhase[i] + driftInc);
+					noteButtons[i].drift = driftTable.at(driftPhase[i]) * dlimit;
 				}else noteButtons[i].drift = 0.f; // no analog drift
 			
 				float noteUnison = 0.f;
@@ -927,12 +1394,12 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 				outputs[PITCH_OUTPUT + i].setVoltage(noteButtons[i].drift + (inputs[POLYSHIFT_INPUT].getVoltage()/48.f * params[TRIMPOLYSHIFT_PARAM].getValue()) + (polyTransParam + noteButtons[i].key + noteUnison - 60) / 12.f);	  //
 				//////////////////////////////////////////////////
 		}
-		if (seqrunning) lights[SEQ_LIGHT + i].value = (seqStep == i) ? 1.f : 0.f;
 	}//// end for i to numPads
 	lockedMono = lockedM;
 	liveMono = liveM;
 	sustainhold = params[HOLD_PARAM].getValue() > 0.5f;
 	//  Output Live Mono note
+	float monoVelScale = 1.f;
 	if (outputs[MONOPITCH_OUTPUT].isConnected()) {
 		/////////////////////////////////  ///
 		/// A R C A D E // S C A N ///	  //
@@ -940,6 +1407,8 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 		////////////////////////////// // ////
 		///// A R P E G G I A T O R //////////
 		if (arpegMode > 0) {
+			bool arpGroove = grooveOn && (arpegMode == 1) && (params[ARPSWING_PARAM].getValue() > 0.5f);
+			if (arpGroove) monoVelScale = groove.velScale(arpGrooveIx);
 			int updArpClockRatio = 0;
 			if (inputs[ARPEGRATIO_INPUT].isConnected())
 			updArpClockRatio = static_cast<int>(minmaxFit(inputs[ARPEGRATIO_INPUT].getVoltage() + params[ARPEGRATIO_PARAM].getValue(), 0.f, 11.f));
@@ -951,9 +1420,8 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 				if (!arpegStarted) {
 					arpegStarted = true;
 					arpegIx = liveMono;
-					arpegCycle = 0;
-					arpOctIx = 0;
-					arpSampleCount = 0;
+					arpOct = 0;
+					arp.restart();
 					arpPhase = 0.f;
 					arpTickCount = 0;
 				   /////////////////////////////////
@@ -971,18 +1439,19 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 					float swingknob = params[SEQARPSWING_PARAM].getValue() / 40.f;
 					bool swingThis ((params[ARPSWING_PARAM].getValue() > 0.5f) && ((swingTriplet[arpclockRatio]) || (params[SWINGTRI_PARAM].getValue() > 0.5f)));
 					if (clockSource < 2) {
-						if (clockSource == 1) ClockArpSamples = static_cast<int>(args.sampleRate * 60.f/BPMrate / ClockRatios[arpclockRatio] + 0.5f);
-							arpPhase = static_cast<float>(arpSampleCount)/static_cast<float>(ClockArpSamples);
-							arpSampleCount++;
-						if (swingThis){
+						if (clockSource == 1) ClockArpSamples = args.sampleRate * 60.f/BPMrate / ClockRatios[arpclockRatio];
+						arpPhase += 1.f / ClockArpSamples;
+						if (arpGroove){
+							arpswingPhase = groove.stepLength(arpGrooveIx);
+						}else if (swingThis){
 							if (arpSwingDwn) arpswingPhase = 1.f + swingknob;
 							else arpswingPhase = 1.f - swingknob;
 						} else arpswingPhase = 1.f;
 						if (arpPhase >= arpswingPhase) {
-							arpPhase = 0.f;
+							arpPhase -= arpswingPhase; // keep the fraction (sub-sample step time)
 							arpSwingDwn = !arpSwingDwn;
+							arpGrooveIx = (arpGrooveIx + 1) % GrooveTemplate::maxSteps;
 							arpegStep = true;
-							arpSampleCount = 0;
 						}
 					}else{
 						int arpMidiPhase;
@@ -990,13 +1459,16 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 						if (arpMIDItick){
 							arpMIDItick = false;
 							arpTickCount ++; /// arpeggiator sync with sequencer
-							if (swingThis){
+							if (arpGroove){
+								arpMidiPhase = static_cast<int>(24/ClockRatios[arpclockRatio] * groove.stepLength(arpGrooveIx) + 0.5f);
+							}else if (swingThis){
 								if (arpSwingDwn) arpMidiPhase = 24/ClockRatios[arpclockRatio] + swingtick;
 								else arpMidiPhase = 24/ClockRatios[arpclockRatio] - swingtick;
 							} else arpMidiPhase = 24/ClockRatios[arpclockRatio];
 							if (arpTickCount >= arpMidiPhase) {
 								arpTickCount = 0;
 								arpSwingDwn = !arpSwingDwn;
+								arpGrooveIx = (arpGrooveIx + 1) % GrooveTemplate::maxSteps;
 								arpegStep = true;
 							}
 						}
@@ -1004,9 +1476,9 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 				}// END IF MODE ARP
 			}else{ //////////	GATE OFF //arpeg ON no gate (all notes off) reset..
 				arpegStarted = false;
-				arpSampleCount = 0;
 				arpPhase = 0.f;
 				arpSwingDwn = true;
+				arpGrooveIx = 0;
 			}
 			bool notesFirst = (params[ARPEGOCTALT_PARAM].getValue() > 0.5f);
 			if ((arpegStep) && (monogate)){
@@ -1014,52 +1486,35 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 					arpclockRatio = updArpClockRatio;
 					arpPhase = 0.f;
 					arpSwingDwn = true;
-					arpSampleCount = 0;
+					arpGrooveIx = 0;
 				}///update ratio....
 				int arpOctaveKnob = static_cast<int>(params[ARPEGOCT_PARAM].getValue());
 				for (int i = 0 ; i < 5; i++){
 					lights[ARPOCT_LIGHT + i].value = 0.f;
 				}
 				arpegStep=false;
-				if (notesFirst) {
-				////////// NOTE to arp and CYCLE FLAG
-					arpegIx ++;
-					if (arpegIx > polyTopIndex) arpegIx = 0;
-					for (int i = 0; i <= polyTopIndex; i++){
-						if ((noteButtons[arpegIx].mode == POLY_MODE) && ((noteButtons[arpegIx].gate) || (noteButtons[arpegIx].button))) {
-							arpegCycle++;
-							if (arpegCycle >= playingVoices){
-								arpegCycle = 0;
-								arpOctValue = arpOctaveKnob;
-								if (octaveShift[arpOctValue][arpOctIx + 1] > 2){
-									arpOctIx = 0;
-								} else {
-									arpOctIx ++;
-								}
-							}
-							break;
-						}
-						arpegIx ++;
-						if (arpegIx > polyTopIndex) arpegIx = 0;
+				//// table rebuilt only on held notes / order / octaves change
+				if (arp.needsBuild(arpSig ^ arpHeld, arpOrder, arpOctaveKnob, notesFirst)){
+					int keys[numPads];
+					int stamps[numPads];
+					for (int i = 0; i < numPads; i++){
+						keys[i] = noteButtons[i].key;
+						stamps[i] = noteButtons[i].stamp;
 					}
-				///////////
-				}else {
-					arpOctValue = arpOctaveKnob;
-					if (octaveShift[arpOctValue][arpOctIx + 1] > 2) {
-						arpegIx ++;
-						arpOctIx= 0;
-						for (int i = 0; i <= polyTopIndex; i++){
-							if ((noteButtons[arpegIx].mode == POLY_MODE) && ((noteButtons[arpegIx].gate) || (noteButtons[arpegIx].button))) {
-								break;
-							}
-							arpegIx ++;
-							if (arpegIx > polyTopIndex) arpegIx = 0;
+					arp.build(arpSig ^ arpHeld, arpHeld, keys, stamps, arpOrder, octaveShift[arpOctaveKnob], arpOctaveKnob, notesFirst, rng);
+				}
+				if (!arp.empty()){
+					const ArpEngine::ArpStep &step = arp.next(rng);
+					arpegIx = step.pad;
+					arpOct = step.oct;
+					if (step.chord){ /// retrigger all held poly pads
+						for (int i = 0; i < numPads; i++){
+							if (arpHeld & (1u << i)) noteButtons[i].polyretrig = true;
 						}
-					}else{
-						arpOctIx ++;
+						keyPulse.trigger(1e-3);
 					}
 				}
-				lights[ARPOCT_LIGHT + 2 + octaveShift[arpOctValue][arpOctIx]].value = 1.f;
+				lights[ARPOCT_LIGHT + 2 + arpOct].value = 1.f;
 				arpDisplayIx = arpegIx;
 			}else if (!monogate){
 			///keysUp...update arp ratio
@@ -1069,14 +1524,14 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 					lights[ARPOCT_LIGHT + i].value = 0.f;
 				}
 			}
-			outputs[MONOPITCH_OUTPUT].setVoltage(octaveShift[arpOctValue][arpOctIx] + (noteButtons[arpegIx].key - 60) / 12.f);
+			outputs[MONOPITCH_OUTPUT].setVoltage(arpOct + (noteButtons[arpegIx].key - 60) / 12.f);
 		}else{
 			///////// Normal Mono //////// NO ARPEGIATOR /////
 			outputs[MONOPITCH_OUTPUT].setVoltage(noteButtons[liveMono].drift + (noteButtons[liveMono].key - 60) / 12.f);
 		}
 	} /// end if output active
 	
-	outputs[MONOVEL_OUTPUT].setVoltage(noteButtons[liveMono].vel / 127.f * 10.f);
+	outputs[MONOVEL_OUTPUT].setVoltage(clamp(noteButtons[liveMono].vel / 127.f * 10.f * monoVelScale, 0.f, 10.f));
 	bool monoRtgGate = monogate;
 	if ((params[MONORETRIG_PARAM].getValue() > 0.5f) && (noteButtons[liveMono].key != lastMono)){///if retrig
 		monoRtgGate = !monoPulse.process(args.sampleTime);
@@ -1098,13 +1553,13 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 	outputs[LOCKEDGATE_OUTPUT].setVoltage(!muteLocked && lockedRtgGate ? 10.f : 0.f);
 	
 	if (pitch < 8192){
-		outputs[PBEND_OUTPUT].setVoltage(pitchFilter.process(1.f, rescale(pitch, 0, 8192, -5.f, 0.f)));
+		outputs[PBEND_OUTPUT].setVoltage(pitchFilter.process(smoothPB, rescale(pitch, 0, 8192, -5.f, 0.f)));
 	} else {
-		outputs[PBEND_OUTPUT].setVoltage(pitchFilter.process(1.f, rescale(pitch, 8192, 16383, 0.f, 5.f)));
+		outputs[PBEND_OUTPUT].setVoltage(pitchFilter.process(smoothPB, rescale(pitch, 8192, 16383, 0.f, 5.f)));
 	}
-	outputs[MOD_OUTPUT].setVoltage(modFilter.process(1.f, rescale(mod, 0, 127, 0.f, 10.f)));
-	outputs[SUSTAIN_OUTPUT].setVoltage(sustainFilter.process(1.f, rescale(sustain, 0, 127, 0.f, 10.f)));
-	outputs[PRESSURE_OUTPUT].setVoltage(pressureFilter.process(1.f, rescale(pressure, 0, 127, 0.f, 10.f)));
+	outputs[MOD_OUTPUT].setVoltage(modFilter.process(smoothCC, rescale(mod, 0, 127, 0.f, 10.f)));
+	outputs[SUSTAIN_OUTPUT].setVoltage(sustainFilter.process(smoothCC, rescale(sustain, 0, 127, 0.f, 10.f)));
+	outputs[PRESSURE_OUTPUT].setVoltage(pressureFilter.process(smoothCC, rescale(pressure, 0, 127, 0.f, 10.f)));
 	
 //////////////////// S E Q U E N C E R ////////////////////////////
 	doSequencer(); /////// SEQ //////	/////// SEQ //////	/////// SEQ //////	/////// SEQ //////	/////// SEQ //////
@@ -1116,9 +1571,6 @@ void MIDIpoly16::process(const ProcessArgs &args) {
 		MidiPanic();
 		return;
 	}
-	if (lights[RESETMIDI_LIGHT].value > 0.0001f)
-		lights[RESETMIDI_LIGHT].value -= 0.0001f ; // fade out light
-
 	bool pulseClk = clockPulse.process(1.f / args.sampleRate);
 	outputs[SEQCLOCK_OUTPUT].setVoltage(pulseClk ? 10.f : 0.f);
 	
@@ -1250,6 +1702,10 @@ void MIDIpoly16::doSequencer(){
 		seqclockRatio = updSeqClockRatio;
 		syncArpPhase = true;
 	}
+	bool songOn = songMode && (songLength > 0);
+	if (songOn){
+		if (songIx >= songLength) songNext();
+	}else{
 	int updSeqFirst = 0;
 	if (inputs[SEQFIRST_INPUT].isConnected())
 		updSeqFirst = static_cast<int>(minmaxFit(inputs[SEQFIRST_INPUT].getVoltage() * 1.55f + params[SEQFIRST_PARAM].getValue(), 0.f, 15.f));
@@ -1265,6 +1721,7 @@ void MIDIpoly16::doSequencer(){
 	}else{
 		seqSteps = static_cast <int> (params[SEQSTEPS_PARAM].getValue());
 	}
+	}
 ///////////////////////////////////////////////
 	
 	bool seqResetNow = false;
@@ -1312,25 +1769,6 @@ void MIDIpoly16::doSequencer(){
 			}
 			clkMIDItick = false;
 		}
-		if(!inputs[SEQRUN_INPUT].isConnected()){
-				if (MIDIstart){
-					seqrunning = true;
-					seqTickCount = 0;
-					arpTickCount = 0;
-					MIDIstart = false;
-					seqResetNow = true;
-				}
-				if (MIDIcont){
-					seqrunning = true;
-					seqTickCount = 0;
-					arpTickCount = 0;
-					MIDIcont = false;
-				}
-				if (MIDIstop){
-					seqrunning = false;
-					MIDIstop = false;
-				}
-		}
 	}else if (clockSource == 0) {
 	   if (extBPM && (inputs[CLOCK_INPUT].isConnected()) && (sampleFrames < (3 * static_cast<int>(APP->engine->getSampleRate()))))
 			sampleFrames ++;
@@ -1343,8 +1781,8 @@ void MIDIpoly16::doSequencer(){
 		if (extClockTrigger.process(inputs[CLOCK_INPUT].getVoltage())) {
 			///// EXTERNAL CLOCK
 			extBPM = true;
-			ClockSeqSamples = static_cast<int>(static_cast<float>(sampleFrames) / ClockRatios[seqclockRatio]+0.5f);
-			ClockArpSamples = static_cast<int>(static_cast<float>(sampleFrames) / ClockRatios[arpclockRatio]+0.5f);
+			ClockSeqSamples = static_cast<float>(sampleFrames) / ClockRatios[seqclockRatio];
+			ClockArpSamples = static_cast<float>(sampleFrames) / ClockRatios[arpclockRatio];
 			getBPM();
 		}
 	}
@@ -1361,12 +1799,13 @@ void MIDIpoly16::doSequencer(){
 	////////////
 	if (seqResetNow){
 		seqPhase = 0.f;
-		seqi = 0;
-		seqiWoct = 0;
-		seqStep = seqOffset;
-		seqOctIx = 0;
+		songIx = 0;
+		songRepeat = 0;
+		locateSeq(0);
 		seqSwingDwn = true;
+		seqGrooveIx = 0;
 		arpSwingDwn = true;
+		arpGrooveIx = 0;
 		arpPhase = 0.f;
 		seqTickCount = 0;
 		arpTickCount = 0;
@@ -1376,25 +1815,13 @@ void MIDIpoly16::doSequencer(){
 
 	if (seqrunning) {
 		int seqOctaveKnob = static_cast<int> (params[SEQOCT_PARAM].getValue());
-		if (stopped){
-			stopped = false;
-			startPulse.trigger(1e-3);
-			clockPulse.trigger(1e-3);
-			seqOctValue = seqOctaveKnob;
-			seqSampleCount = 0;
-			seqPhase = 0.f;
-			seqSwingDwn = true;
-			arpSampleCount = 0;
-			arpPhase = 0.f;
-			arpSwingDwn = true;
-			seqTickCount = 0;
-			arpTickCount = 0;
-		}
+		if (stopped) seqTransportStart();
 		float swingknob = params[SEQARPSWING_PARAM].getValue() / 40.f;
 		float seqswingPhase;
 		int swingtick;
 		int swingMidiPhase;
 		bool notesFirst = (params[SEQOCTALT_PARAM].getValue() > 0.5f);
+		bool seqGroove = grooveOn && (params[SEQSWING_PARAM].getValue() > 0.5f);
 		bool DontSwing = true;
 		if ((params[SEQSWING_PARAM].getValue() > 0.5f) && ((swingTriplet[seqclockRatio]) || (params[SWINGTRI_PARAM].getValue() > 0.5f))){
 		int lastStepByOct = seqSteps * (1 + std::abs(seqOctValue-3));
@@ -1402,10 +1829,11 @@ void MIDIpoly16::doSequencer(){
 		DontSwing = (((seqSteps % 2 == 1) && (notesFirst) && ((seqStep - seqOffset) == (seqSteps - 1))) || ((lastStepByOct % 2 == 1) && (!notesFirst) && (seqiWoct == (lastStepByOct - 1))));
 		}
 		if (clockSource < 2) {
-			if (clockSource == 1) ClockSeqSamples = static_cast<int>(APP->engine->getSampleRate() * 60.f/BPMrate / ClockRatios[seqclockRatio] + 0.5f);
-				seqPhase = static_cast<float>(seqSampleCount)/static_cast<float>(ClockSeqSamples);
-				seqSampleCount++;
-				if (DontSwing) {
+			if (clockSource == 1) ClockSeqSamples = APP->engine->getSampleRate() * 60.f/BPMrate / ClockRatios[seqclockRatio];
+				seqPhase += 1.f / ClockSeqSamples;
+				if (seqGroove) {
+					seqswingPhase = groove.stepLength(seqGrooveIx);
+				}else if (DontSwing) {
 					seqswingPhase = 1.f;
 				}else{
 					if (seqSwingDwn){
@@ -1414,11 +1842,13 @@ void MIDIpoly16::doSequencer(){
 						seqswingPhase = 1.f - swingknob;
 					}
 				}
+				seqswingPhase = std::max(seqswingPhase + recOffset[seqNextPad()] - recOffset[seqStep], 0.05f);
+				seqStepLen = seqswingPhase;
 				if (seqPhase >= seqswingPhase) {
-					seqPhase = 0.f;
+					seqPhase -= seqswingPhase; // keep the fraction (sub-sample step time)
 					seqSwingDwn = !seqSwingDwn;
+					seqGrooveIx = (seqGrooveIx + 1) % GrooveTemplate::maxSteps;
 					nextStep = true;
-					seqSampleCount = 0;
 					if (DontSwing) seqSwingDwn = true;
 				}
 		}else{
@@ -1426,7 +1856,9 @@ void MIDIpoly16::doSequencer(){
 			if (seqMIDItick){
 				seqMIDItick = false;
 				seqTickCount ++;
-				if (DontSwing) {
+				if (seqGroove) {
+					swingMidiPhase = static_cast<int>(24/ClockRatios[seqclockRatio] * groove.stepLength(seqGrooveIx) + 0.5f);
+				}else if (DontSwing) {
 					swingMidiPhase = 24/ClockRatios[seqclockRatio];
 				}else{
 					if (seqSwingDwn){
@@ -1435,9 +1867,12 @@ void MIDIpoly16::doSequencer(){
 						swingMidiPhase = 24/ClockRatios[seqclockRatio] - swingtick;
 					}
 				}
+				swingMidiPhase = std::max(swingMidiPhase + static_cast<int>(std::round((recOffset[seqNextPad()] - recOffset[seqStep]) * 24/ClockRatios[seqclockRatio])), 1);
+				seqStepTicks = swingMidiPhase;
 				if (seqTickCount >= swingMidiPhase){
 					seqTickCount = 0;
 					seqSwingDwn = !seqSwingDwn;
+					seqGrooveIx = (seqGrooveIx + 1) % GrooveTemplate::maxSteps;
 					nextStep = true;
 					if (DontSwing) seqSwingDwn = true;
 				}
@@ -1446,22 +1881,32 @@ void MIDIpoly16::doSequencer(){
 		bool gateOut;
 		bool pulseTrig = gatePulse.process(1.f / APP->engine->getSampleRate());
 		gateOut = (noteButtons[seqStep].velseq > 0) && (!(pulseTrig && (params[SEQRETRIG_PARAM].getValue() > 0.5f)));
+		if (seqGateLen[seqStep] < 1.f) gateOut = gateOut && (seqStepFraction() < seqGateLen[seqStep]);
+		float seqVel = noteButtons[seqStep].velseq / 127.f * 10.f;
+		if (seqGroove) seqVel = clamp(seqVel * groove.velScale(seqGrooveIx), 0.f, 10.f);
 		//// if note goes out to seq...(if not the outputs hold the last played value)
 		if (params[SEQSEND_PARAM + seqStep].getValue() > 0.5f){
 			outputs[SEQPITCH_OUTPUT].setVoltage(noteButtons[seqStep].drift + octaveShift[seqOctValue][seqOctIx] + (inputs[SEQSHIFT_INPUT].getVoltage() * params[TRIMSEQSHIFT_PARAM].getValue() /48.f ) + (seqTransParam + noteButtons[seqStep].key - 60) / 12.f);
-			outputs[SEQVEL_OUTPUT].setVoltage(noteButtons[seqStep].velseq / 127.f * 10.f);
+			outputs[SEQVEL_OUTPUT].setVoltage(seqVel);
 			outputs[SEQGATE_OUTPUT].setVoltage(!muteSeq && gateOut ? 10.f : 0.f);
 			///if individual gate / vel
 			if (params[SEQSEND_PARAM + seqStep].getValue() > 1.5f){
 				noteButtons[seqStep].gateseq = true;
 			// (already set) outputs[PITCH_OUTPUT + seqStep].setVoltage(noteButtons[seqStep].drift + octaveShift[seqOctValue][seqOctIx] + (seqTransParam + noteButtons[seqStep].key - 60) / 12.f);
-				outputs[VEL_OUTPUT + seqStep].setVoltage(noteButtons[seqStep].velseq / 127.f * 10.f);
+				outputs[VEL_OUTPUT + seqStep].setVoltage(seqVel);
 				outputs[GATE_OUTPUT + seqStep].setVoltage(!muteSeq && gateOut ? 10.f : 0.f);
 			}
 		}else{
 			outputs[SEQGATE_OUTPUT].setVoltage(0.f);
 		}
 		if (nextStep) {
+			//// replace: seq pads passed without a recorded note go silent
+			if (recArmed && recReplace && (noteButtons[seqStep].mode == SEQ_MODE) && (!recTouched[seqStep])){
+				noteButtons[seqStep].velseq = 0;
+				seqGateLen[seqStep] = 1.f;
+			}
+			recTouched[seqStep] = false;
+			recHeldSteps ++;
 		// restore gates and vel from individual outputs...
 			if (params[SEQSEND_PARAM + seqStep].getValue() > 1.5f){
 				noteButtons[seqStep].gateseq = false;
@@ -1473,9 +1918,9 @@ void MIDIpoly16::doSequencer(){
 				lights[SEQOCT_LIGHT + i].value = 0.f;
 			}
 			if ((syncArpPhase) && (seqSwingDwn)) {
-				arpSampleCount = 0;
 				arpPhase = 0.f;
 				arpSwingDwn = true;
+				arpGrooveIx = 0;
 				syncArpPhase = false;
 				arpTickCount = 0;
 			}
@@ -1485,17 +1930,16 @@ void MIDIpoly16::doSequencer(){
 			if (seqResetNext){ ///if reset while running
 				seqResetNext = false;
 				seqPhase = 0.f;
-				seqi = 0;
-				seqiWoct = 0;
-				seqOctIx = 0;
-				seqStep = seqOffset;
+				songIx = 0;
+				songRepeat = 0;
+				locateSeq(0);
 				seqSwingDwn = true;
+				seqGrooveIx = 0;
 				arpPhase = 0.f;
 				arpSwingDwn = true;
+				arpGrooveIx = 0;
 				seqTickCount = 0;
 				arpTickCount = 0;
-				seqSampleCount = 0;
-				arpSampleCount = 0; /// SYNC THE ARPEGG
 			}else{
 				seqiWoct ++;
 				if (notesFirst) {
@@ -1510,6 +1954,7 @@ void MIDIpoly16::doSequencer(){
 										seqOctIx ++;
 									}
 							seqi = 0;// next cycle
+							songNext();
 						}
 				}else{
 					if (octaveShift[seqOctValue][seqOctIx + 1] > 2) {
@@ -1518,6 +1963,7 @@ void MIDIpoly16::doSequencer(){
 						seqi ++;
 						if ( seqi > (seqSteps - 1)) {
 							seqi = 0;// next cycle
+							songNext();
 							seqiWoct = 0;
 						}
 					}else{
@@ -1530,18 +1976,8 @@ void MIDIpoly16::doSequencer(){
 			lights[SEQRUNNING_LIGHT].value = 1.f;
 		}
 	}else{ ///stopped shut down gate....
-		if (!stopped){
-			lights[SEQRUNNING_LIGHT].value = 0.f;
-			noteButtons[seqStep].gateseq = false;
-			stopped = true;
-			stopPulse.trigger(1e-3);
-			for (int i = 0 ; i < 5; i++){
-				lights[SEQOCT_LIGHT + i].value = 0.f;
-			}
-			outputs[SEQGATE_OUTPUT].setVoltage(0.f);
-		}
+		if (!stopped) seqTransportStop();
 	}
-	if (lights[SEQRESET_LIGHT].value > 0.0001f) lights[SEQRESET_LIGHT].value -= 0.0001f;
 	/////// SEQ ////// ------- E N D  ---------  ------- E N D  ---------  ------- E N D  --------- /////// SEQ //////
 	return;
 }
@@ -1549,52 +1985,50 @@ void MIDIpoly16::doSequencer(){
 ///////////BUTTONS' DISPLAY
 
  struct NoteDisplay : TransparentWidget {
-	MIDIpoly16::noteButton *nButton = new MIDIpoly16::noteButton();
 	NoteDisplay() {
-			font = APP->window->loadFont(FONT_FILE);
+			font = pluginFont(FONT_FILE);
 	}
 	float dfontsize = 12.f;
 	MIDIpoly16 *module;
-	int key = 0;
-	int vel = 0;
-	bool gate = false;
-	bool gateseq = false;
-	bool newkey = false;
-	int frame = 0;
 	int framevel = 0;
-	bool showvel = true;
-	int polyIndex = 0;
+	bool showvel = false;
+	int newkeys = 0;
 	int id = 0;
-	int mode = 0;
-	bool learn = false;
-	bool dispNotenumber = false;
-	int arpIx = 0;
-	bool arp = false;
 	std::shared_ptr<Font> font;
-	std::string to_display ="";
-	std::string displayNoteName(int key, bool notenumber);
+	DispText noteTxt;
+	DispText velTxt;
+	int q_key = -1;
+	int q_vel = -1;
+	bool q_notenumber = false;
 
-	void draw(const DrawArgs &args) {
+	/// velocity is shown 20 frames after a new key, the module does not see that timer
+	void step() override {
 		if (module) {
-			nButton = &(module->noteButtons[id]);
-		
-			frame ++;
-			if (frame > 5){
-				frame = 0;
-				newkey = nButton->newkey;
-				key =  nButton->key;
-				vel = nButton->vel;
-				gate = nButton->gate;
-				gateseq = nButton->gateseq;
-				mode = nButton->mode;
-				learn = nButton->learn;
+			const MIDIpoly16::PadDisp &nButton = module->dispSnap.read().pads[id];
+			if (newkeys != nButton.newkeys) {
+				newkeys = nButton.newkeys;
+				showvel = true;
+				framevel = 0;
+				dispRedraw(this);
+			} else if (showvel && (++framevel > 20)){
+				showvel = false;
+				dispRedraw(this);
 			}
+		}
+		TransparentWidget::step();
+	}
+	void draw(const DrawArgs &args) override {
+		if (module) {
+			const MIDIpoly16::DispState &d = module->dispSnap.read();
+			const MIDIpoly16::PadDisp &nButton = d.pads[id];
+			int key = nButton.key;
+			int vel = nButton.vel;
 			int rrr,ggg,bbb,aaa;
-			if (learn) {
+			if (nButton.learn) {
 				rrr=0xff; ggg=0xff; bbb=0x00;
 				aaa=128;
 			} else {
-				switch (mode){
+				switch (nButton.mode){
 					case 0:{/// Poly
 						rrr=0xff; ggg=0xff; bbb=0xff;
 						aaa= vel;
@@ -1618,42 +2052,40 @@ void MIDIpoly16::doSequencer(){
 			nvgRoundedRect(args.vg, 0, 0, box.size.x, box.size.y, 6.f);
 			nvgFillColor(args.vg, backgroundColor);
 			nvgFill(args.vg);
-			if (newkey) {
-				showvel = true;
-				framevel = 0;
-				nButton->newkey = false;
-			}else{
-				to_display = displayNoteName(key, module->dispNotenumber);
+			if ((q_key != key) || (q_notenumber != d.dispNotenumber)){
+				q_key = key;
+				q_notenumber = d.dispNotenumber;
+				if (q_notenumber) noteTxt.set("n").add(key);
+				else noteTxt.clear().addNote(key);
 			}
-			if (learn) {
+			const char *to_display = noteTxt.c_str();
+			if (nButton.learn) {
 				NVGcolor borderColor = nvgRGB(rrr, ggg, bbb);
 				nvgStrokeWidth(args.vg, 2.f);
 				nvgStrokeColor(args.vg, borderColor);
 				nvgStroke(args.vg);
-			} else if (gate || gateseq){
+			} else if (nButton.gate || nButton.gateseq){
 				if (showvel) {
-					if (++framevel <= 20) {
-						to_display = "v" + std::to_string(vel);
-					}else{
-						showvel = false;
-						framevel = 0;
+					if (q_vel != vel){
+						q_vel = vel;
+						velTxt.set("v").add(vel);
 					}
+					to_display = velTxt.c_str();
 				}
 				NVGcolor borderColor = nvgRGB(rrr, ggg, bbb);
 				nvgStrokeWidth(args.vg, 2.f);
 				nvgStrokeColor(args.vg, borderColor);
 				nvgStroke(args.vg);
 			}
-			if (module->arpDisplayIx == id)
+			if (nButton.arp)
 			{ ///arp led
 				NVGcolor ledColor = nvgRGB(0xff, 0xff, 0xff);
 				nvgBeginPath(args.vg);
 				nvgRect(args.vg, 4 , 8, 2, 2);
 				nvgFillColor(args.vg, ledColor);
 				nvgFill(args.vg);
-			   // nButton->arp = false;
 			}
-			if (module->polyIndex == id) { ///led
+			if (nButton.poly) { ///led
 				NVGcolor ledColor = nvgRGB(0xff, 0xff, 0xff);
 				nvgBeginPath(args.vg);
 				nvgRect(args.vg, 4 , 4, 2, 2);
@@ -1665,42 +2097,31 @@ void MIDIpoly16::doSequencer(){
 			NVGcolor textColor = nvgRGB(rrr, ggg, bbb);
 			nvgFillColor(args.vg, textColor);
 			nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
-			nvgTextBox(args.vg, 0.f, 19.f, 48.f ,to_display.c_str(), NULL);
+			nvgTextBox(args.vg, 0.f, 19.f, 48.f ,to_display, NULL);
 		}
 	}
 };
 
-/////////// MIDI NOTES to Text
-std::string NoteDisplay::displayNoteName(int value, bool notenumber)
-{
-	std::string notename[12] = {"C","C#","D","Eb","E","F","F#","G","Ab","A","Bb","B"};
-	if (notenumber){
-		return "n"+ std::to_string(value);
-	}else{
-		int octaveint = (value / 12) - 2;
-		return notename[value % 12] + std::to_string(octaveint);
-	}
-}
-
 ///// MAIN DISPLAY //////
 
 struct digiDisplay : TransparentWidget {
 	digiDisplay() {
-		font = APP->window->loadFont(FONT_FILE);
+		font = pluginFont(FONT_FILE);
 	}
 	MIDIpoly16 *module;
 	
 	float mdfontSize = 10.f;
 	std::shared_ptr<Font> font;
 	
-	const std::string stringClockRatios[13] ={"1/2", "1/4d","1/2t", "1/4", "1/8d", "1/4t","1/8","1/16d","1/8t","1/16","1/16t","1/32","1/32t"};
+	const char *stringClockRatios[13] ={"1/2", "1/4d","1/2t", "1/4", "1/8d", "1/4t","1/8","1/16d","1/8t","1/16","1/16t","1/32","1/32t"};
 	
-	std::string seqDisplayedTr = "";
-	std::string polyDisplayedTr = "";
-	std::string clockDisplay = "";
-	std::string seqDisplay = "";
-	std::string arpegDisplay = "";
-	std::string voicesDisplay = "";
+	DispText clockDisplay;
+	DispText seqDisplay;
+	DispText arpegDisplay;
+	/// last formatted values
+	int q_arp = -1;
+	int q_clock = -1;
+	int q_seq = -1;
 
 	bool BPMdecimalsP = false;
 	int clockSourceP = 0;
@@ -1708,91 +2129,99 @@ struct digiDisplay : TransparentWidget {
 	int seqclockRatioP = 1;
 	int seqStepsP = 16;
 	int seqOffsetP = 0;
+	int songIxP = -1;
+	int songLengthP = 0;
+	bool recArmedP = false;
 	int arpclockRatioP = 1;
 	int arpegStatusP = 0;
-	int polyMaxVoicesP = 16;
-	int playingVoicesP = 0;
-	int seqtransP = 0;
-	int polytransP = 0;
 	
 	float thirdlineoff = 0.f;
 	bool thirdline = false;
-	int frame = 0;
+	/// only called when the module display generation moved (framebuffer)
 	void draw(const DrawArgs &args) override
 	{
 		if (module){
-			clockSourceP = module->clockSource;
-			BPMdecimalsP = module->BPMdecimals;
-			displayedBPMP = module->displayedBPM;
-			seqclockRatioP = module->seqclockRatio;
-			seqStepsP = module->seqSteps;
-			seqOffsetP = module->seqOffset;
-			polyMaxVoicesP = module->polyMaxVoices;
-			playingVoicesP = module->playingVoices;
-			arpegStatusP = module->arpegStatus;
-			arpclockRatioP = module->arpclockRatio;
-			seqtransP = module->seqTransParam;
-			polytransP = module->polyTransParam;
+			const MIDIpoly16::DispState &d = module->dispSnap.read();
+			clockSourceP = d.clockSource;
+			BPMdecimalsP = d.BPMdecimals;
+			displayedBPMP = d.displayedBPM;
+			seqclockRatioP = d.seqclockRatio;
+			seqStepsP = d.seqSteps;
+			seqOffsetP = d.seqOffset;
+			songIxP = d.songIx;
+			songLengthP = d.songLength;
+			recArmedP = d.recArmed;
+			arpegStatusP = d.arpegStatus;
+			arpclockRatioP = d.arpclockRatio;
 		
-		if (frame ++ > 5 ){
-			switch (arpegStatusP){
-				case 0:{
-					arpegDisplay = "";
-					thirdline = false;
-				}break;
-				case 1:{
-					arpegDisplay = "Arpeggiator: " + stringClockRatios[arpclockRatioP];
-					thirdline = true;
-				}break;
-				case 2:{
-					arpegDisplay = "Arpeggiator: Arcade";
-					thirdline = true;
-				}break;
-				case 3:{
-					arpegDisplay = "";
-					thirdline = false;
-				}break;
-				default:{
-					arpegDisplay = "Arpeg.connect mono out";
-					thirdline = true;
-				}break;
+			//// values packed in one int per line, text rebuilt only on change
+			int arpKey = arpegStatusP * 16 + arpclockRatioP;
+			if (q_arp != arpKey){
+				q_arp = arpKey;
+				switch (arpegStatusP){
+					case 0:{
+						arpegDisplay.clear();
+						thirdline = false;
+					}break;
+					case 1:{
+						arpegDisplay.set("Arpeggiator: ").add(stringClockRatios[arpclockRatioP]);
+						thirdline = true;
+					}break;
+					case 2:{
+						arpegDisplay.set("Arpeggiator: Arcade");
+						thirdline = true;
+					}break;
+					case 3:{
+						arpegDisplay.clear();
+						thirdline = false;
+					}break;
+					default:{
+						arpegDisplay.set("Arpeg.connect mono out");
+						thirdline = true;
+					}break;
+				}
 			}
-			switch (clockSourceP){
-				case 0:{
-					int BPMint = static_cast<int>(displayedBPMP / 10.f);
-					int BPMdec = static_cast<int>(displayedBPMP) % 10;
-					if (displayedBPMP < 1){
-						clockDisplay = "EXT ...no clock...";
-					} else {
-						clockDisplay = "EXT " + std::to_string(BPMint) + "." + std::to_string(BPMdec) +" bpm "+ stringClockRatios[seqclockRatioP];
-					}
-				}break;
-				case 1:{
-					int BPMint = static_cast<int>(displayedBPMP / 100.f);
-					if (BPMdecimalsP){
-						int BPMdec = static_cast<int>(displayedBPMP) % 100;
-						clockDisplay = "INT " + std::to_string(BPMint) + "." + std::to_string(BPMdec) +" bpm "+ stringClockRatios[seqclockRatioP];
-					} else{
-						clockDisplay = "INT " + std::to_string(BPMint) + " bpm "+ stringClockRatios[seqclockRatioP];
-					}
+			int clockKey = ((displayedBPMP * 4 + clockSourceP) * 2 + (BPMdecimalsP ? 1 : 0)) * 16 + seqclockRatioP;
+			if (q_clock != clockKey){
+				q_clock = clockKey;
+				switch (clockSourceP){
+					case 0:{
+						int BPMint = static_cast<int>(displayedBPMP / 10.f);
+						int BPMdec = static_cast<int>(displayedBPMP) % 10;
+						if (displayedBPMP < 1){
+							clockDisplay.set("EXT ...no clock...");
+						} else {
+							clockDisplay.set("EXT ").add(BPMint).add('.').add(BPMdec).add(" bpm ").add(stringClockRatios[seqclockRatioP]);
+						}
+					}break;
+					case 1:{
+						int BPMint = static_cast<int>(displayedBPMP / 100.f);
+						if (BPMdecimalsP){
+							int BPMdec = static_cast<int>(displayedBPMP) % 100;
+							clockDisplay.set("INT ").add(BPMint).add('.').add(BPMdec).add(" bpm ").add(stringClockRatios[seqclockRatioP]);
+						} else{
+							clockDisplay.set("INT ").add(BPMint).add(" bpm ").add(stringClockRatios[seqclockRatioP]);
+						}
 
-				}break;
-				case 2:{
-					int BPMint = static_cast<int>(displayedBPMP / 10.f);
-					int BPMdec = static_cast<int>(displayedBPMP) % 10;
-					if (displayedBPMP < 1){
-						clockDisplay = "MIDI ...no clock...";
-					} else {
-						clockDisplay = "MIDI " + std::to_string(BPMint) + "." + std::to_string(BPMdec) +" bpm "+ stringClockRatios[seqclockRatioP];
-					}
-				}break;
+					}break;
+					case 2:{
+						int BPMint = static_cast<int>(displayedBPMP / 10.f);
+						int BPMdec = static_cast<int>(displayedBPMP) % 10;
+						if (displayedBPMP < 1){
+							clockDisplay.set("MIDI ...no clock...");
+						} else {
+							clockDisplay.set("MIDI ").add(BPMint).add('.').add(BPMdec).add(" bpm ").add(stringClockRatios[seqclockRatioP]);
+						}
+					}break;
+				}
+			}
+			int seqKey = ((((seqStepsP * 16 + seqOffsetP) * 128 + songIxP + 1) * 128 + songLengthP) * 2) + (recArmedP ? 1 : 0);
+			if (q_seq != seqKey){
+				q_seq = seqKey;
+				seqDisplay.set("Steps: ").add(seqStepsP).add(" First: ").add(seqOffsetP + 1);
+				if ((songIxP > -1) && (songLengthP > 0)) seqDisplay.add(" Song ").add(songIxP + 1).add('/').add(songLengthP);
+				if (recArmedP) seqDisplay.add(" REC");
 			}
-			seqDisplay = "Steps: " + std::to_string(seqStepsP) + " First: " + std::to_string(seqOffsetP + 1);
-			voicesDisplay = std::to_string(playingVoicesP)+"/"+std::to_string(polyMaxVoicesP);
-			seqDisplayedTr = std::to_string(seqtransP);
-			polyDisplayedTr = std::to_string(polytransP);
-			frame = 0;
-		}
 		nvgFillColor(args.vg, nvgRGBA(0xFF,0xFF,0xFF,0xFF));
 		nvgFontSize(args.vg, mdfontSize);
 		nvgFontFaceId(args.vg, font->handle);
@@ -1803,23 +2232,59 @@ struct digiDisplay : TransparentWidget {
 		} else {thirdlineoff = 6.f;}
 		nvgTextBox(args.vg, 0.f, 3.f + mdfontSize + thirdlineoff, box.size.x, clockDisplay.c_str(), NULL);
 		nvgTextBox(args.vg, 0.f, 6.f + mdfontSize * 2.f + thirdlineoff, box.size.x, seqDisplay.c_str(), NULL);
-		nvgTextBox(args.vg, 87.f, -21.f, 48.f, voicesDisplay.c_str(), NULL);//PolyVoices Display
-		nvgTextBox(args.vg, 240.f, -21.f,30.f, polyDisplayedTr.c_str(), NULL);//VoicesTransp Display
-		nvgTextBox(args.vg, -7.f, 284.f,30.f, seqDisplayedTr.c_str(), NULL);//SeqTransp Display
 		}else{//PREVIEW
-			std::shared_ptr<Font> mfont;
-			std::string s1 = "MIDI to 16ch CV";
-			std::string s2 = "with Sequencer";
-			std::string s3 = "and Arpeggiator";
-			font = APP->window->loadFont(mFONT_FILE);
+			font = pluginFont(mFONT_FILE);
 			nvgFontSize(args.vg, 20.f);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
 			nvgFillColor(args.vg, nvgRGB(0xDD,0xDD,0xDD));
-			nvgTextBox(args.vg, 0.f, 12.f,box.size.x, s1.c_str(), NULL);
-			nvgTextBox(args.vg, 0.f, 27.0f,box.size.x, s2.c_str(), NULL);
-			nvgTextBox(args.vg, 0.f, 42.0f,box.size.x, s3.c_str(), NULL);
+			nvgTextBox(args.vg, 0.f, 12.f,box.size.x, "MIDI to 16ch CV", NULL);
+			nvgTextBox(args.vg, 0.f, 27.0f,box.size.x, "with Sequencer", NULL);
+			nvgTextBox(args.vg, 0.f, 42.0f,box.size.x, "and Arpeggiator", NULL);
+		}
+	}
+};
+
+/// voices and transpose values, each one cached in its own small framebuffer
+struct digiValueDisplay : TransparentWidget {
+	digiValueDisplay() {
+		font = pluginFont(FONT_FILE);
+	}
+	enum ValueIds {
+		VOICES_VALUE,
+		POLYTRANS_VALUE,
+		SEQTRANS_VALUE
+	};
+	MIDIpoly16 *module;
+	int valueId = 0;
+	float mdfontSize = 10.f;
+	std::shared_ptr<Font> font;
+	DispText valueDisplay;
+	int q_value = -1000;
+	void draw(const DrawArgs &args) override {
+		if (!module) return;
+		const MIDIpoly16::DispState &d = module->dispSnap.read();
+		int value;
+		switch (valueId){
+			case VOICES_VALUE:{
+				value = d.playingVoices * 32 + d.polyMaxVoices;
+				if (q_value != value) valueDisplay.clear().add(d.playingVoices).add('/').add(d.polyMaxVoices);
+			}break;
+			case POLYTRANS_VALUE:{
+				value = d.polyTrans;
+				if (q_value != value) valueDisplay.clear().add(value);
+			}break;
+			default:{
+				value = d.seqTrans;
+				if (q_value != value) valueDisplay.clear().add(value);
+			}break;
 		}
+		q_value = value;
+		nvgFillColor(args.vg, nvgRGBA(0xFF,0xFF,0xFF,0xFF));
+		nvgFontSize(args.vg, mdfontSize);
+		nvgFontFaceId(args.vg, font->handle);
+		nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
+		nvgTextBox(args.vg, 0.f, 10.f, box.size.x, valueDisplay.c_str(), NULL);
 	}
 };
 
@@ -1886,10 +2351,100 @@ struct WhiteYLight : GrayModuleLightWidget {
 	}
 };
 /////////////////////////////////////////////// WIDGET ///////////////////////////////////////////////
+struct ArpOrderItem : MenuItem {
+	MIDIpoly16 *module;
+	int order;
+	void onAction(const event::Action &e) override {
+		module->arpOrder = order;
+	}
+};
+
+struct GrooveOnItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->grooveOn = !module->grooveOn;
+	}
+};
+struct GrooveLoadItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		osdialog_filters *filters = osdialog_filters_parse("Groove (.txt .mid):txt,mid,midi");
+		char *path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+		osdialog_filters_free(filters);
+		if (!path) return;
+		GrooveTemplate newGroove;
+		if (newGroove.load(path)){
+			module->loadGroove(newGroove);
+			module->grooveOn = true;
+		}
+		free(path);
+	}
+};
+
+struct SongModeItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->songMode = !module->songMode;
+	}
+};
+struct SongAddItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->songAddPattern();
+	}
+};
+struct SongClearItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->songLength = 0;
+		module->songIx = 0;
+		module->songRepeat = 0;
+	}
+};
+
+struct RecArmItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->recArmed = !module->recArmed;
+	}
+};
+struct RecReplaceItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->recReplace = !module->recReplace;
+	}
+};
+struct RecStrengthItem : MenuItem {
+	MIDIpoly16 *module;
+	float strength;
+	void onAction(const event::Action &e) override {
+		module->recStrength = strength;
+	}
+};
+struct RecClearItem : MenuItem {
+	MIDIpoly16 *module;
+	void onAction(const event::Action &e) override {
+		module->recClearTiming();
+	}
+};
+
 struct MIDIpoly16Widget : ModuleWidget{
+	/// display generations taken from the module snapshot (framebuffers compare these)
+	unsigned int padGen[MIDIpoly16::numPads] = {0};
+	unsigned int mainGen = 0;
+	void step() override {
+		MIDIpoly16 *module = dynamic_cast<MIDIpoly16*>(this->module);
+		if (module) delete module->grooveDone.exchange(NULL);
+		if (module && module->dispSnap.update()){
+			const MIDIpoly16::DispState &d = module->dispSnap.read();
+			for (int i = 0; i < MIDIpoly16::numPads; i++) padGen[i] = d.padGen[i];
+			mainGen = d.mainGen;
+		}
+		ModuleWidget::step();
+	}
 	MIDIpoly16Widget(MIDIpoly16 *module){
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MIDIPoly.svg")));
+		setPanel(pluginSvg("res/MIDIPoly.svg"));
 		//Screws
 		addChild(createWidget<ScrewBlack>(Vec(0, 0)));
 		addChild(createWidget<ScrewBlack>(Vec(135, 0)));
@@ -1918,9 +2473,9 @@ struct MIDIpoly16Widget : ModuleWidget{
 		midiWidget->driverSeparator->box.pos = Vec(0.f, 12.f);
 		midiWidget->deviceSeparator->box.pos = Vec(0.f, 24.f);
 		
-//		midiWidget->driverChoice->font = APP->window->loadFont(mFONT_FILE);
-//		midiWidget->deviceChoice->font = APP->window->loadFont(mFONT_FILE);
-//		midiWidget->channelChoice->font = APP->window->loadFont(mFONT_FILE);
+//		midiWidget->driverChoice->font = pluginFont(mFONT_FILE);
+//		midiWidget->deviceChoice->font = pluginFont(mFONT_FILE);
+//		midiWidget->channelChoice->font = pluginFont(mFONT_FILE);
 		
 		midiWidget->driverChoice->textOffset = Vec(2.f,10.f);
 		midiWidget->deviceChoice->textOffset = Vec(2.f,10.f);
@@ -1993,7 +2548,7 @@ struct MIDIpoly16Widget : ModuleWidget{
 				notedisplay->box.size = Vec(48, 27);
 				notedisplay->module = module;
 				notedisplay->id = i;
-				addChild(notedisplay);
+				addChild(dispCache(notedisplay, (module) ? &padGen[i] : NULL));
 			}
 			addParam(createParam<moDllzSwitchLedHT>(Vec(xPos + 54 ,yPos + 11), module, MIDIpoly16::SEQSEND_PARAM + i));
 			addChild(createLight<TinyLight<BlueLight>>(Vec(xPos + 64.2, yPos + 4), module, MIDIpoly16::SEQ_LIGHT + i));
@@ -2213,8 +2768,84 @@ struct MIDIpoly16Widget : ModuleWidget{
 			mainDisplay->box.pos = Vec(63, 57);
 			mainDisplay->box.size = {198, 44};
 			mainDisplay->module = module;
-			addChild(mainDisplay);
+			addChild(dispCache(mainDisplay, (module) ? &mainGen : NULL));
+			const Vec valuePos[3] = {Vec(150, 26), Vec(303, 26), Vec(56, 331)};
+			const float valueWidth[3] = {48.f, 30.f, 30.f};
+			for (int i = 0; i < 3; i++){
+				digiValueDisplay *valueDisplay = new digiValueDisplay();
+				valueDisplay->box.pos = valuePos[i];
+				valueDisplay->box.size = Vec(valueWidth[i], 13.f);
+				valueDisplay->module = module;
+				valueDisplay->valueId = i;
+				addChild(dispCache(valueDisplay, (module) ? &mainGen : NULL));
+			}
+		}
+	}
+	void appendContextMenu(Menu *menu) override {
+		MIDIpoly16 *module = dynamic_cast<MIDIpoly16*>(this->module);
+		menu->addChild(new MenuEntry);
+		ReproDriftItem<MIDIpoly16> *reproDriftItem = createMenuItem<ReproDriftItem<MIDIpoly16>>("Reproducible drift", CHECKMARK(module->reproDrift));
+		reproDriftItem->module = module;
+		menu->addChild(reproDriftItem);
+		DriftSeedItem<MIDIpoly16> *driftSeedItem = createMenuItem<DriftSeedItem<MIDIpoly16>>("Drift seed: " + std::to_string(module->driftSeed), RIGHT_ARROW);
+		driftSeedItem->module = module;
+		menu->addChild(driftSeedItem);
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Smoothing"));
+		menu->addChild(createSmoothItem("Pitch bend", &module->smoothPB));
+		menu->addChild(createSmoothItem("Mod, sustain, pressure", &module->smoothCC));
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Notes (split / layer with other modules)"));
+		menu->addChild(createKeyZoneItem(&module->zone));
+		menu->addChild(createVelocityCurveItem(&module->velCurve));
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Arpeggiator order"));
+		const std::string orderNames[ArpEngine::NUM_ORDERS] = {"Pads", "Up", "Down", "Up-Down", "As played", "Random", "Chord"};
+		for (int i = 0; i < ArpEngine::NUM_ORDERS; i++){
+			ArpOrderItem *arpOrderItem = createMenuItem<ArpOrderItem>(orderNames[i], CHECKMARK(module->arpOrder == i));
+			arpOrderItem->module = module;
+			arpOrderItem->order = i;
+			menu->addChild(arpOrderItem);
+		}
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Groove (seq / arp swing switches)"));
+		std::string grooveName = (module->grooveSaved.name.empty()) ? "straight" : module->grooveSaved.name;
+		GrooveOnItem *grooveOnItem = createMenuItem<GrooveOnItem>("Groove: " + grooveName, CHECKMARK(module->grooveOn));
+		grooveOnItem->module = module;
+		menu->addChild(grooveOnItem);
+		GrooveLoadItem *grooveLoadItem = createMenuItem<GrooveLoadItem>("Load groove...");
+		grooveLoadItem->module = module;
+		menu->addChild(grooveLoadItem);
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Song (" + std::to_string(module->songLength) + " patterns)"));
+		SongModeItem *songModeItem = createMenuItem<SongModeItem>("Song mode", CHECKMARK(module->songMode));
+		songModeItem->module = module;
+		menu->addChild(songModeItem);
+		SongAddItem *songAddItem = createMenuItem<SongAddItem>("Add current steps / first to song");
+		songAddItem->module = module;
+		menu->addChild(songAddItem);
+		SongClearItem *songClearItem = createMenuItem<SongClearItem>("Clear song");
+		songClearItem->module = module;
+		menu->addChild(songClearItem);
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Live record (MIDI notes to seq pads)"));
+		RecArmItem *recArmItem = createMenuItem<RecArmItem>("Record", CHECKMARK(module->recArmed));
+		recArmItem->module = module;
+		menu->addChild(recArmItem);
+		RecReplaceItem *recReplaceItem = createMenuItem<RecReplaceItem>("Replace (off: overdub)", CHECKMARK(module->recReplace));
+		recReplaceItem->module = module;
+		menu->addChild(recReplaceItem);
+		const float strengths[4] = {1.f, 0.75f, 0.5f, 0.f};
+		for (int i = 0; i < 4; i++){
+			std::string strengthName = "Quantize " + std::to_string(static_cast<int>(strengths[i] * 100.f)) + "%";
+			RecStrengthItem *recStrengthItem = createMenuItem<RecStrengthItem>(strengthName, CHECKMARK(module->recStrength == strengths[i]));
+			recStrengthItem->module = module;
+			recStrengthItem->strength = strengths[i];
+			menu->addChild(recStrengthItem);
 		}
+		RecClearItem *recClearItem = createMenuItem<RecClearItem>("Clear recorded timing");
+		recClearItem->module = module;
+		menu->addChild(recClearItem);
 	}
 };
 
@@ -66,22 +66,29 @@ struct MIDIdualCV :  Module {
 	int mdriverJx = -1;
 	int mchannelJx = -1;
 	std::string mdeviceJx = "";
+	int midiLoadGen = 0;
 	bool resetMidi = false;
 	/////
 	bool MPEmode = false;
 	
-	uint8_t mod = 0;
-	dsp::ExponentialFilter modFilter;
-	uint8_t breath = 0;
-	dsp::ExponentialFilter breathFilter;
-	uint8_t expression = 0;
-	dsp::ExponentialFilter exprFilter;
+	MidiCCin ccIn[16];	// 14-bit CCs, RPN / NRPN per channel
+	uint16_t mod = 0;	// 14-bit
+	Smoother modFilter;
+	uint16_t breath = 0;
+	Smoother breathFilter;
+	uint16_t expression = 0;
+	Smoother exprFilter;
 	uint16_t pitch = 8192;
-	dsp::ExponentialFilter pitchFilter;
+	/// output smoothing per destination (context menu)
+	SmoothShape smoothPB;
+	SmoothShape smoothCC;	// CCs and pressure
+	KeyZone zone;
+	VelocityCurve velCurve;
+	Smoother pitchFilter;
 	uint8_t sustain = 0;
-	dsp::ExponentialFilter sustainFilter;
+	Smoother sustainFilter;
 	uint8_t pressure = 0;
-	dsp::ExponentialFilter pressureFilter;
+	Smoother pressureFilter;
 
 	struct NoteData {
 		uint8_t velocity = 0;
@@ -137,22 +144,17 @@ struct MIDIdualCV :  Module {
 		configParam(LWRRETRGGMODE_PARAM, 0.0, 1.0, 0.0);
 		configParam(UPRRETRGGMODE_PARAM, 0.0, 1.0, 0.0);
 		configParam(SUSTAINHOLD_PARAM, 0.0, 1.0, 1.0);
-		setLambdas();
+		setRates();
 	}
 //////////////////////////////////////////////////////////////////////////////////////
 	void onSampleRateChange() override {
-		setLambdas();
+		setRates();
 	}
 //////////////////////////////////////////////////////////////////////////////////////
-	void setLambdas(){
+	void setRates(){
 		srFrametime = APP->engine->getSampleRate() / 1000 ;
-		float srSampleTime = APP->engine->getSampleTime() * 100.f;
-		modFilter.lambda = srSampleTime;
-		breathFilter.lambda = srSampleTime;
-		exprFilter.lambda = srSampleTime;
-		sustainFilter.lambda = srSampleTime;
-		pressureFilter.lambda = srSampleTime;
-		pitchFilter.lambda = srSampleTime;
+		smoothPB.setSampleRate(APP->engine->getSampleRate());
+		smoothCC.setSampleRate(APP->engine->getSampleRate());
 		slewLwr = 0.f;//zero to refresh rate
 		slewUpr = 0.f;//zero to refresh rate
 	}
@@ -176,12 +178,15 @@ struct MIDIdualCV :  Module {
 		outputs[PRESSURE_OUTPUT].setVoltage(0.0f);
 		sustain = 0;
 		outputs[SUSTAIN_OUTPUT].setVoltage(0.0f);
+		for (int i = 0; i < 16; i++) ccIn[i].reset();
 		sustpedal = false;
 		midiActivity = 220;
 		resetMidi = false;
 	}
 //////////////////////////////////////////////////////////////////////////////////////
 	void onReset() override{
+		zone.set(0, 127, 1, 127);
+		velCurve.set(VelocityCurve::LINEAR);
 		resetVoices();
 	}
 //////////////////////////////////////////////////////////////////////////////////////
@@ -196,6 +201,10 @@ struct MIDIdualCV :  Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "midi", miditoJson());
+		json_object_set_new(rootJ, "smoothPB", smoothPB.toJson());
+		json_object_set_new(rootJ, "smoothCC", smoothCC.toJson());
+		json_object_set_new(rootJ, "keyZone", zone.toJson());
+		json_object_set_new(rootJ, "velCurve", velCurve.toJson());
 		return rootJ;
 	}
 //////////////////////////////////////////////////////////////////////////////////////
@@ -208,8 +217,13 @@ struct MIDIdualCV :  Module {
 			if (deviceNameJ) mdeviceJx = json_string_value(deviceNameJ);
 			json_t* channelJ = json_object_get(midiJ, "channel");
 			if (channelJ) mchannelJx = json_integer_value(channelJ);
+			midiLoadGen ++;// the display refreshes the saved device, the watcher keeps names and hot-plug
 			midiInput.fromJson(midiJ);
 		}
+		smoothPB.fromJson(json_object_get(rootJ, "smoothPB"));
+		smoothCC.fromJson(json_object_get(rootJ, "smoothCC"));
+		zone.fromJson(json_object_get(rootJ, "keyZone"));
+		velCurve.fromJson(json_object_get(rootJ, "velCurve"));
 	}
 //////////////////////////////////////////////////////////////////////////////////////
 	void updateHiLo(){
@@ -239,7 +253,9 @@ struct MIDIdualCV :  Module {
 			case 0x9: { // note on
 				uint8_t note = msg.getNote();
 				if (msg.getValue() > 0 ) {
-					noteData[note].velocity = msg.getValue();
+					if (zone.learning) zone.learnPending(note, msg.getValue());
+					if (!zone.takes(note, msg.getValue())) break;
+					noteData[note].velocity = velCurve.lookup7(msg.getValue());
 					noteData[note].aftertouch = 0;
 					firstNoGlideLwr = (!anynoteGate && (params[SLEW_LOWER_MODE_PARAM].getValue() > 0.5));
 					firstNoGlideUpr = (!anynoteGate  && (params[SLEW_UPPER_MODE_PARAM].getValue() > 0.5));
@@ -273,15 +289,21 @@ struct MIDIdualCV :  Module {
 	}
 //////////////////////////////////////////////////////////////////////////////////////
 	void processCC(midi::Message msg) {
-		switch (msg.getNote()) {
+		MidiCCin::Event cc = ccIn[msg.getChannel()].feed(msg.getNote(), msg.getValue());
+		if (cc.kind == MidiCCin::RPN){
+			if (cc.number == 0) setPbRange(cc.value >> 7);
+			return;
+		}
+		if (cc.kind != MidiCCin::CC) return;
+		switch (cc.number) {
 			case 0x01: // mod
-				mod = msg.getValue();
+				mod = cc.value;
 				break;
 			case 0x02: // breath
-				breath = msg.getValue();
+				breath = cc.value;
 				break;
 			case 0x0B: // Expression
-				expression = msg.getValue();
+				expression = cc.value;
 				break;
 			case 0x40: { // sustain
 				sustain = msg.getValue();
@@ -293,6 +315,14 @@ struct MIDIdualCV :  Module {
 			default: break;
 		}
 	}
+	/// RPN 0 (pitch bend sensitivity, semitones) sets both bend range pairs
+	void setPbRange(int semitones){
+		float range = clamp(static_cast<float>(semitones), 0.f, 24.f);
+		params[PBNEG_LOWER_PARAM].setValue(-range);
+		params[PBPOS_LOWER_PARAM].setValue(range);
+		params[PBNEG_UPPER_PARAM].setValue(-range);
+		params[PBPOS_UPPER_PARAM].setValue(range);
+	}
 ///////////////////         ////           ////          ////         /////////////////////
 /////////////////   ///////////////  /////////  ////////////  //////  ////////////////////
 /////////////////         ////////  /////////       ///////         /////////////////////
@@ -305,13 +335,13 @@ struct MIDIdualCV :  Module {
 		}
 		float pitchwheel;
 		if (pitch < 8192){
-			pitchwheel = pitchFilter.process(1.f,rescale(pitch, 0, 8192, -5.f, 0.f));
+			pitchwheel = pitchFilter.process(smoothPB, rescale(pitch, 0, 8192, -5.f, 0.f));
 			outputs[PBENDNEG_OUTPUT].setVoltage(pitchwheel * 2.f);
 			outputs[PBENDPOS_OUTPUT].setVoltage(0.f);
 			pitchtocvLWR = pitchwheel * params[PBNEG_LOWER_PARAM].getValue() / -60.f;
 			pitchtocvUPR = pitchwheel * params[PBNEG_UPPER_PARAM].getValue() / -60.f;
 		} else {
-			pitchwheel = pitchFilter.process(1.f,rescale(pitch, 8192, 16383, 0.f, 5.f));
+			pitchwheel = pitchFilter.process(smoothPB, rescale(pitch, 8192, 16383, 0.f, 5.f));
 			outputs[PBENDPOS_OUTPUT].setVoltage(pitchwheel * 2.f);
 			outputs[PBENDNEG_OUTPUT].setVoltage(0.f);
 			pitchtocvLWR = pitchwheel * params[PBPOS_LOWER_PARAM].getValue() / 60.f;
@@ -384,11 +414,11 @@ struct MIDIdualCV :  Module {
 		outputs[RETRIGGATE_OUTPUT_Lwr].setVoltage(gateout && !(retriggLwr)? 10.f : 0.f );
 		outputs[RETRIGGATE_OUTPUT_Upr].setVoltage(gateout && !(retriggUpr)? 10.f : 0.f );
 		outputs[GATE_OUTPUT].setVoltage(gateout ? 10.f : 0.f );
-		outputs[MOD_OUTPUT].setVoltage(modFilter.process(1.f, rescale(mod, 0, 127, 0.f, 10.f)));
-		outputs[BREATH_OUTPUT].setVoltage(breathFilter.process(1.f, rescale(breath, 0, 127, 0.f, 10.f)));
-		outputs[EXPRESSION_OUTPUT].setVoltage(exprFilter.process(1.f, rescale(expression, 0, 127, 0.f, 10.f)));
-		outputs[SUSTAIN_OUTPUT].setVoltage(sustainFilter.process(1.f, rescale(sustain, 0, 127, 0.f, 10.f)));
-		outputs[PRESSURE_OUTPUT].setVoltage(pressureFilter.process(1.f, rescale(pressure, 0, 127, 0.f, 10.f)));
+		outputs[MOD_OUTPUT].setVoltage(modFilter.process(smoothCC, mod * (10.f / 16383.f)));
+		outputs[BREATH_OUTPUT].setVoltage(breathFilter.process(smoothCC, breath * (10.f / 16383.f)));
+		outputs[EXPRESSION_OUTPUT].setVoltage(exprFilter.process(smoothCC, expression * (10.f / 16383.f)));
+		outputs[SUSTAIN_OUTPUT].setVoltage(sustainFilter.process(smoothCC, rescale(sustain, 0, 127, 0.f, 10.f)));
+		outputs[PRESSURE_OUTPUT].setVoltage(pressureFilter.process(smoothCC, rescale(pressure, 0, 127, 0.f, 10.f)));
 	
 		if (resetMidi) resetVoices();// resetMidi from MIDI widget;
 	}
@@ -402,7 +432,7 @@ struct MIDIdualCV :  Module {
 struct MIDIdualCVWidget : ModuleWidget {
 	MIDIdualCVWidget(MIDIdualCV *module){
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MIDIdualCV.svg")));
+		setPanel(pluginSvg("res/MIDIdualCV.svg"));
 		//Screws
 		addChild(createWidget<ScrewBlack>(Vec(0, 0)));
 		addChild(createWidget<ScrewBlack>(Vec(box.size.x - 15, 0)));
@@ -415,7 +445,7 @@ struct MIDIdualCVWidget : ModuleWidget {
 			//MIDI
 			MIDIscreen *dDisplay = createWidget<MIDIscreen>(Vec(3.5,yPos));
 			dDisplay->box.size = {128.f, 40.f};
-			dDisplay->setMidiPort (&module->midiInput, &module->MPEmode, &module->MPEmasterCh, &module->midiActivity, &module->mdriverJx, &module->mdeviceJx, &module->mchannelJx, &module->resetMidi);
+			dDisplay->setMidiPort (&module->midiInput, &module->MPEmode, &module->MPEmasterCh, &module->midiActivity, &module->mdriverJx, &module->mdeviceJx, &module->mchannelJx, &module->resetMidi, &module->midiLoadGen);
 			addChild(dDisplay);
 		}
 	
@@ -470,6 +500,17 @@ struct MIDIdualCVWidget : ModuleWidget {
 		addParam(createParam<moDllzSwitchLed>(Vec(104.5f, yPos+4.f), module, MIDIdualCV::SUSTAINHOLD_PARAM));
 		addChild(createLight<TranspOffRedLight>(Vec(104.5f, yPos+4.f), module, MIDIdualCV::SUSTHOLD_LIGHT));
 	}
+	void appendContextMenu(Menu *menu) override {
+		MIDIdualCV *module = dynamic_cast<MIDIdualCV*>(this->module);
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Smoothing"));
+		menu->addChild(createSmoothItem("Pitch bend", &module->smoothPB));
+		menu->addChild(createSmoothItem("CCs and pressure", &module->smoothCC));
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Notes (split / layer with other modules)"));
+		menu->addChild(createKeyZoneItem(&module->zone));
+		menu->addChild(createVelocityCurveItem(&module->velCurve));
+	}
 };
 
 Model *modelMIDIdualCV = createModel<MIDIdualCV, MIDIdualCVWidget>("MIDIdualCV");
@@ -58,11 +58,34 @@ struct MIDIpolyMPE : Module {
 ////MIDI
 	midi::InputQueue midiInput;
 	int MPEmasterCh = 0;// 0 ~ 15
+	/// MPE zones: lower (master ch 1, members up from ch 2) and upper (master ch 16, members down
+	/// from ch 15), member counts 0 ~ 15 from the menu or the MPE Configuration Message (RPN 6).
+	/// Any other MPEmasterCh (MIDI display) is one custom zone, all other channels are members.
+	int mpeLower = 15;
+	int mpeUpper = 0;
+	int mappedMasterCh = -1;
+	int8_t chVoice[16];	// channel -> voice, -1 on masters, unused channels and unbound members
+	int8_t voiceCh[16];	// voice -> channel, kept while the voice rings out
+	bool chMaster[16];
+	bool chMember[16];
+	/// dynamic MPE voices: a member channel takes the free voice unbound longest ago at note on
+	/// and lets it go when nothing sounds on it, numVOch follows the highest bound voice (shrinks one voice
+	/// per second of hold so release tails are not cut). Off: the fixed zone table.
+	bool dynMPE = true;
+	uint32_t boundVoices = 0;
+	uint32_t unbindClock = 0;	// dynamic MPE: voice unbind stamps, compared as clock - stamp
+	uint32_t unbound[16] = {0};
+	int shrinkHold = 0;	// display blocks
+	MidiUMPin midiIn;	// MIDI 1.0 and UMP to full resolution events, CC pairs and RPN / NRPN per channel
+	UMPfile umpFile;	// stand-in MIDI 2.0 source (context menu)
+	std::atomic<UMPfile *> umpLoad {NULL};	// ui -> process
+	std::atomic<UMPfile *> umpDone {NULL};	// process -> ui, the replaced file to free
 	int midiActivity = 0;
 	bool resetMidi = false;
 	int mdriverJx = -1;
 	int mchannelJx = -1;
 	std::string mdeviceJx = "";
+	int midiLoadGen = 0;
 /////
 	enum PolyMode {
 		MPE_MODE,
@@ -78,45 +101,67 @@ struct MIDIpolyMPE : Module {
 	};
 	int polyModeIx = ROTATE_MODE;
 
+	/// voice state keeps the input resolution: velocity 16-bit, expression and controllers
+	/// 32-bit, bends signed 32-bit (MidiUMPin::unit() / bipolar() to read them)
 	struct NoteData {
-		uint8_t velocity = 0;
-		uint8_t aftertouch = 0;
+		uint16_t velocity = 0;
+		uint32_t aftertouch = 0;
+		int32_t bend = 0;	// per note pitch bend (MIDI 2.0)
+		uint32_t y = 0;	// mpeYcc per note controller (128 = poly pressure)
+		uint32_t z = 0;	// poly pressure, or mpeZcc per note controller with polyZ
 	};
 	NoteData noteData[128];
+	/// voice state below is sized by sizeVoices() for voiceBanks poly cable groups of 16,
+	/// groups 2 and 3 go out on the spill expander (poly modes, MPE stays on 16 channels).
+	/// Capacity for maxBanks is reserved at construction so resizing never allocates.
+	static const int maxBanks = 3;
+	int voiceBanks = 1;	// sized now (1 ~ maxBanks)
+	int voiceBanksSet = 1;	// context menu / patch choice, sized by resetVoices()
+	int pendingNumVo = 0;	// patch voice count waiting for its banks
+	VoiceSpill spillScratch;	// groups 2 and 3 when no expander listens
+	/// poly modes: per note state of the note each voice plays, copied from noteData
+	/// when note or per note events arrive, read by the output loop
+	std::vector<int32_t> voiceBend;
+	std::vector<uint32_t> voiceY;
+	std::vector<uint32_t> voiceZ;
+	bool polyY = false;	// poly modes Y out: per note controller, else drifted pitch
+	bool polyZ = false;	// poly modes Z out: per note controller, else poly pressure
 	
 	std::vector<uint8_t> cachedNotes;// Stolen notes (UNISON_MODE and REASSIGN_MODE cache all played)
 	std::vector<uint8_t> cachedMPE[16];// MPE stolen notes
 	
-	uint8_t notes[16] = {0};
-	uint8_t vels[16] = {0};
-	uint8_t rvels[16] = {0};
-	int16_t mpex[16] = {0};
-	uint16_t mpey[16] = {0};
-	uint16_t mpez[16] = {0};
+	std::vector<uint8_t> notes;
+	std::vector<uint16_t> vels;
+	std::vector<uint16_t> rvels;
+	int32_t mpex[16] = {0};
+	uint32_t mpey[16] = {0};
+	uint32_t mpez[16] = {0};
 	uint8_t mpePlusLB[16] = {0};
-	uint8_t chAfTch = 0;
-	int16_t mPBnd = 0;
-	uint8_t midiCCsVal[8] = {0};
+	uint32_t chAfTch = 0;
+	int32_t mPBnd = 0;
+	uint32_t midiCCsVal[8] = {0};
 
 	int midiCCs[8] = {128,1,2,7,10,11,12,64};
-	bool gates[16] = {false};
+	VoiceFlags gates;
 
-	float xpitch[16] = {0.f};
-	float drift[16] = {0.f};
-	bool pedalgates[16] = {false}; // gates set to TRUE by pedal if current gate. FALSE by pedal.
+	std::vector<float> xpitch;
+	std::vector<float> drift;
+	DllzRandom rng; // per module drift source
+	bool reproDrift = false; // reseed with driftSeed on reset (render runs repeat the same drift)
+	uint32_t driftSeed = 0;	// per instance, set on add (dllzClaimSeed)
+	int driftSeedOwner = -1;
+	VoiceFlags pedalgates; // gates set to TRUE by pedal if current gate. FALSE by pedal.
 	bool pedal = false;
 	int rotateIndex = 0;
-	int stealIndex = 0;
+	VoiceAllocator<16 * maxBanks, StealPriority> voiceAlloc;	// steal mode / note protection from the context menu
 	int numVo = 8;
 	int numVOch = 1;
 	int pbMainDwn = -12;
 	int pbMainUp = 2;
 	int pbMPE = 96;
 	int driftcents = 0;
-	int noteMin = 0;
-	int noteMax = 127;
-	int velMin = 1;
-	int velMax = 127;
+	KeyZone zone;	// note and velocity range, edited on the display
+	VelocityCurve velCurve;
 	int trnsps = 0;
 	int mpeYcc = 74; //cc74 (default MPE Y)
 	int mpeZcc = 128; //128 = ChannelAfterTouch (default MPE Z)
@@ -132,17 +177,71 @@ struct MIDIpolyMPE : Module {
 	float dataKnob = 0.f;
 	int frameData = 0;
 	int autoFocusOff = 0;
-	//uint8_t MPEchMap[16];
-	//std::vector<uint8_t> dynMPEch;
 	
-	dsp::ExponentialFilter MPExFilter[16];
-	dsp::ExponentialFilter MPEyFilter[16];
-	dsp::ExponentialFilter MPEzFilter[16];
-	dsp::ExponentialFilter MCCsFilter[8];
-	dsp::ExponentialFilter mPBndFilter;
-	dsp::PulseGenerator reTrigger[16];	// retrigger for stolen notes
+	/// output smoothing per destination (context menu)
+	SmoothShape smoothX;	// MPE bend
+	SmoothShape smoothYZ;	// MPE Y Z
+	SmoothShape smoothCC;	// CCs and main bend
+	std::vector<Smoother> MPExFilter;
+	std::vector<Smoother> MPEyFilter;
+	std::vector<Smoother> MPEzFilter;
+	Smoother MCCsFilter[8];
+	Smoother mPBndFilter;
+	std::vector<dsp::PulseGenerator> reTrigger;	// retrigger for stolen notes
 	dsp::SchmittTrigger PlusOneTrigger;
 	dsp::SchmittTrigger MinusOneTrigger;
+	/// what the displays show, published every dispDivider block
+	struct DispState {
+		unsigned int gen = 0;
+		int polyModeIx = ROTATE_MODE;
+		int cursorIx = 0;
+		int learnNote = 0;
+		int learnCC = 0;
+		int pbMPE = 96;
+		int numVo = 8;
+		int numVOch = 1;
+		int noteMin = 0;
+		int noteMax = 127;
+		int velMin = 1;
+		int velMax = 127;
+		int displayYcc = 74;
+		int displayZcc = 128;
+		int driftcents = 0;
+		bool mpePbOut = true;
+		int trnsps = 0;
+		int pbMainDwn = -12;
+		int pbMainUp = 2;
+		int midiCCs[8] = {128,1,2,7,10,11,12,64};
+	};
+	DispSnapshot<DispState> dispSnap;
+	/// voice map panel (context menu), published with the display block only while shown
+	struct VoiceMap {
+		int polyModeIx = ROTATE_MODE;
+		int voices = 0;
+		int rotateIndex = 0;
+		uint8_t notes[16] = {0};
+		bool gates[16] = {false};
+		bool pedalgates[16] = {false};
+		float bend[16] = {0.f};	// semitones (MPE X)
+		float y[16] = {0.f};
+		float z[16] = {0.f};
+		unsigned int steals[16] = {0};
+		int numStacked[16] = {0};	// MPE notes cached under the voice
+		uint8_t stacked[16][4] = {{0}};
+		int numCached = 0;	// cached notes (poly modes), newest 16
+		uint8_t cached[16] = {0};
+	};
+	DispSnapshot<VoiceMap> voiceMapSnap;
+	std::atomic<bool> voiceMapOn {false};
+	std::vector<unsigned int> voiceSteals;	// voice taken while sounding
+	DispGen disp;
+	dsp::ClockDivider dispDivider;
+	/// lights are written at the divider rate only
+	dsp::ClockDivider lightDivider;
+	/// live meters: 8 CCs then X Y Z per voice channel (0 ~ 1), about one frame per UI frame
+	static const int numMeters = 8 + 16 * 3;
+	DispMeterRing<numMeters> meterRing;
+	dsp::ClockDivider meterDivider;
 
 	MIDIpolyMPE() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -151,8 +250,24 @@ struct MIDIpolyMPE : Module {
 		configParam(SUSTHOLD_PARAM, 0.f, 1.f, 1.f);
 		configParam(RETRIG_PARAM, 0.f, 1.f, 1.f);
 		configParam(DATAKNOB_PARAM, -1.f, 1.f, 0.f);
+		seedDrift();
+		mapMPEchannels();
+		dispDivider.setDivision(256);
+		lightDivider.setDivision(256);
+		setMeterRate(APP->engine->getSampleRate());
+		reserveVoices();
+		sizeVoices();
 		//onReset();
 	}
+	~MIDIpolyMPE() {
+		delete umpLoad.exchange(NULL);
+		delete umpDone.exchange(NULL);
+	}
+///////////////////////////////////////////////////////////////////////////////////////
+	void seedDrift(){
+		if (reproDrift) rng.seed(driftSeed);
+		else rng.seed(random::u64());
+	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	json_t* miditoJson() {//saves last valid driver/device/chn
 		json_t* rootJ = json_object();
@@ -172,6 +287,12 @@ struct MIDIpolyMPE : Module {
 		json_object_set_new(rootJ, "mpePbOut", json_integer(mpePbOut ? 1 : 0));
 		json_object_set_new(rootJ, "numVo", json_integer(numVo));
 		json_object_set_new(rootJ, "MPEmasterCh", json_integer(MPEmasterCh));
+		json_object_set_new(rootJ, "mpeLower", json_integer(mpeLower));
+		json_object_set_new(rootJ, "mpeUpper", json_integer(mpeUpper));
+		json_object_set_new(rootJ, "dynMPE", json_boolean(dynMPE));
+		json_object_set_new(rootJ, "polyY", json_boolean(polyY));
+		json_object_set_new(rootJ, "polyZ", json_boolean(polyZ));
+		json_object_set_new(rootJ, "voiceBanks", json_integer(voiceBanksSet));
 		json_object_set_new(rootJ, "midiAcc", json_integer(midiCCs[0]));
 		json_object_set_new(rootJ, "midiBcc", json_integer(midiCCs[1]));
 		json_object_set_new(rootJ, "midiCcc", json_integer(midiCCs[2]));
@@ -184,10 +305,20 @@ struct MIDIpolyMPE : Module {
 		json_object_set_new(rootJ, "mpeZcc", json_integer(mpeZcc));
 		json_object_set_new(rootJ, "driftcents", json_integer(driftcents));
 		json_object_set_new(rootJ, "trnsps", json_integer(trnsps));
-		json_object_set_new(rootJ, "noteMin", json_integer(noteMin));
-		json_object_set_new(rootJ, "noteMax", json_integer(noteMax));
-		json_object_set_new(rootJ, "velMin", json_integer(velMin));
-		json_object_set_new(rootJ, "velMax", json_integer(velMax));
+		json_object_set_new(rootJ, "noteMin", json_integer(zone.noteMin));
+		json_object_set_new(rootJ, "noteMax", json_integer(zone.noteMax));
+		json_object_set_new(rootJ, "velMin", json_integer(zone.velMin));
+		json_object_set_new(rootJ, "velMax", json_integer(zone.velMax));
+		json_object_set_new(rootJ, "velCurve", velCurve.toJson());
+		json_object_set_new(rootJ, "reproDrift", json_boolean(reproDrift));
+		json_object_set_new(rootJ, "driftSeed", json_integer(driftSeed));
+		json_object_set_new(rootJ, "driftSeedOwner", json_integer(driftSeedOwner));
+		json_object_set_new(rootJ, "smoothX", smoothX.toJson());
+		json_object_set_new(rootJ, "smoothYZ", smoothYZ.toJson());
+		json_object_set_new(rootJ, "smoothCC", smoothCC.toJson());
+		json_object_set_new(rootJ, "stealMode", json_integer(voiceAlloc.policy.mode));
+		json_object_set_new(rootJ, "keepLowest", json_boolean(voiceAlloc.policy.keepLowest));
+		json_object_set_new(rootJ, "keepHighest", json_boolean(voiceAlloc.policy.keepHighest));
 		return rootJ;
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -200,6 +331,7 @@ struct MIDIpolyMPE : Module {
 			if (deviceNameJ) mdeviceJx = json_string_value(deviceNameJ);
 			json_t* channelJ = json_object_get(midiJ, "channel");
 			if (channelJ) mchannelJx = json_integer_value(channelJ);
+			midiLoadGen ++;// the display refreshes the saved device, the watcher keeps names and hot-plug
 			midiInput.fromJson(midiJ);
 		}
 		json_t *polyModeIxJ = json_object_get(rootJ, "polyModeIx");
@@ -217,6 +349,24 @@ struct MIDIpolyMPE : Module {
 		if (numVoJ) numVo = json_integer_value(numVoJ);
 		json_t *MPEmasterChJ = json_object_get(rootJ, "MPEmasterCh");
 		if (MPEmasterChJ) MPEmasterCh = json_integer_value(MPEmasterChJ);
+		json_t *mpeLowerJ = json_object_get(rootJ, "mpeLower");
+		if (mpeLowerJ) mpeLower = clamp(static_cast<int>(json_integer_value(mpeLowerJ)), 0, 15);
+		json_t *mpeUpperJ = json_object_get(rootJ, "mpeUpper");
+		if (mpeUpperJ) mpeUpper = clamp(static_cast<int>(json_integer_value(mpeUpperJ)), 0, 15);
+		json_t *dynMPEJ = json_object_get(rootJ, "dynMPE");
+		dynMPE = dynMPEJ && json_is_true(dynMPEJ);// patches from before keep the fixed channels
+		json_t *polyYJ = json_object_get(rootJ, "polyY");
+		if (polyYJ) polyY = json_is_true(polyYJ);
+		json_t *polyZJ = json_object_get(rootJ, "polyZ");
+		if (polyZJ) polyZ = json_is_true(polyZJ);
+		json_t *voiceBanksJ = json_object_get(rootJ, "voiceBanks");
+		if (voiceBanksJ) voiceBanksSet = clamp(static_cast<int>(json_integer_value(voiceBanksJ)), 1, maxBanks);
+		if (numVo > 16 * voiceBanks){// more voices than sized: wait for resetVoices()
+			pendingNumVo = numVo;
+			numVo = 16 * voiceBanks;
+			resetMidi = true;
+		}
+		mapMPEchannels();
 		json_t *midiAccJ = json_object_get(rootJ, "midiAcc");
 		if (midiAccJ) midiCCs[0] = json_integer_value(midiAccJ);
 		json_t *midiBccJ = json_object_get(rootJ, "midiBcc");
@@ -241,39 +391,63 @@ struct MIDIpolyMPE : Module {
 		if (driftcentsJ) driftcents = json_integer_value(driftcentsJ);
 		json_t *trnspsJ = json_object_get(rootJ, "trnsps");
 		if (trnspsJ) trnsps = json_integer_value(trnspsJ);
-		json_t *noteMinJ = json_object_get(rootJ, "noteMin");
-		if (noteMinJ) noteMin = json_integer_value(noteMinJ);
-		json_t *noteMaxJ = json_object_get(rootJ, "noteMax");
-		if (noteMaxJ) noteMax = json_integer_value(noteMaxJ);
-		json_t *velMinJ = json_object_get(rootJ, "velMin");
-		if (velMinJ) velMin = json_integer_value(velMinJ);
-		json_t *velMaxJ = json_object_get(rootJ, "velMax");
-		if (velMaxJ) velMax = json_integer_value(velMaxJ);
+		zone.fromJson(rootJ);
+		velCurve.fromJson(json_object_get(rootJ, "velCurve"));
+		json_t *reproDriftJ = json_object_get(rootJ, "reproDrift");
+		if (reproDriftJ) reproDrift = json_is_true(reproDriftJ);
+		json_t *driftSeedJ = json_object_get(rootJ, "driftSeed");
+		if (driftSeedJ) driftSeed = json_integer_value(driftSeedJ);
+		json_t *driftSeedOwnerJ = json_object_get(rootJ, "driftSeedOwner");
+		if (driftSeedOwnerJ) driftSeedOwner = json_integer_value(driftSeedOwnerJ);
+		seedDrift();
+		smoothX.fromJson(json_object_get(rootJ, "smoothX"));
+		smoothYZ.fromJson(json_object_get(rootJ, "smoothYZ"));
+		smoothCC.fromJson(json_object_get(rootJ, "smoothCC"));
+		json_t *stealModeJ = json_object_get(rootJ, "stealMode");
+		if (stealModeJ) voiceAlloc.policy.mode = clamp(static_cast<int>(json_integer_value(stealModeJ)), 0, StealPriority::NUM_MODES - 1);
+		json_t *keepLowestJ = json_object_get(rootJ, "keepLowest");
+		if (keepLowestJ) voiceAlloc.policy.keepLowest = json_is_true(keepLowestJ);
+		json_t *keepHighestJ = json_object_get(rootJ, "keepHighest");
+		if (keepHighestJ) voiceAlloc.policy.keepHighest = json_is_true(keepHighestJ);
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	void resetVoices(){
-		float lambdaf = 100.f * APP->engine->getSampleTime();
+		float sampleRate = APP->engine->getSampleRate();
+		smoothX.setSampleRate(sampleRate);
+		smoothYZ.setSampleRate(sampleRate);
+		smoothCC.setSampleRate(sampleRate);
 		pedal = false;
 		lights[SUSTHOLD_LIGHT].value = 0.f;
-		for (int i = 0; i < 16; i++) {
+		if (voiceBanks != voiceBanksSet){
+			voiceBanks = voiceBanksSet;
+			sizeVoices();
+		}
+		if (pendingNumVo > 0) numVo = pendingNumVo;
+		pendingNumVo = 0;
+		numVo = clamp(numVo, 1, 16 * voiceBanks);
+		gates.mask = 0;
+		pedalgates.mask = 0;
+		for (int i = 0; i < 16 * voiceBanks; i++) {
 			notes[i] = 60;
-			gates[i] = false;
-			pedalgates[i] = false;
-			mpey[i] = 0;
 			vels[i] = 0;
 			rvels[i] = 0;
 			xpitch[i] = {0.f};
+			voiceBend[i] = 0;
+			voiceY[i] = 0;
+			voiceZ[i] = 0;
+		}
+		for (int i = 0; i < 16; i++) {
+			mpey[i] = 0;
 			mpex[i] = 0;
 			mpez[i] = 0;
 			cachedMPE[i].clear();
-			MPExFilter[i].lambda = lambdaf;
-			MPEyFilter[i].lambda = lambdaf;
-			MPEzFilter[i].lambda = lambdaf;
 			mpePlusLB[i] = 0;
 			lights[CH_LIGHT+ i].value = 0.f;
 			outputs[GATE_OUTPUT].setVoltage( 0.f, i);
 		}
+		for (int i = 0; i < 128; i++) noteData[i] = NoteData();
 		rotateIndex = -1;
+		voiceAlloc.reset();
 		cachedNotes.clear();
 		if (polyModeIx < ROTATE_MODE) {
 			if (polyModeIx > 0){// Haken MPE Plus
@@ -283,8 +457,7 @@ struct MIDIpolyMPE : Module {
 				displayYcc = mpeYcc;
 				displayZcc = mpeZcc;
 			}
-			numVOch = 1;
-			//dynMPEch.clear();
+			mapMPEchannels();
 		}else {
 			displayYcc = 130;
 			displayZcc = 129;
@@ -293,19 +466,57 @@ struct MIDIpolyMPE : Module {
 		learnCC = 0;
 		learnNote = 0;
 		for (int i=0; i < 8; i++){
-			MCCsFilter[i].lambda = lambdaf;
 			midiCCsVal[i] = 0;
 		}
-		mPBndFilter.lambda = lambdaf;
+		midiIn.reset();
+		if (reproDrift) rng.seed(driftSeed);
 		midiActivity = 96;
 		resetMidi = false;
 	}
+	/// the most voices the menu offers, so sizeVoices() stays within capacity
+	void reserveVoices(){
+		int voices = 16 * maxBanks;
+		voiceBend.reserve(voices);
+		voiceY.reserve(voices);
+		voiceZ.reserve(voices);
+		notes.reserve(voices);
+		vels.reserve(voices);
+		rvels.reserve(voices);
+		xpitch.reserve(voices);
+		drift.reserve(voices);
+		MPExFilter.reserve(voices);
+		MPEyFilter.reserve(voices);
+		MPEzFilter.reserve(voices);
+		reTrigger.reserve(voices);
+		voiceSteals.reserve(voices);
+	}
+	/// voice state for voiceBanks groups of 16: construction, and resetVoices() on the
+	/// audio thread after a bank change, within the reserved capacity (no allocation)
+	void sizeVoices(){
+		int voices = 16 * voiceBanks;
+		voiceBend.assign(voices, 0);
+		voiceY.assign(voices, 0);
+		voiceZ.assign(voices, 0);
+		notes.assign(voices, 60);
+		vels.assign(voices, 0);
+		rvels.assign(voices, 0);
+		xpitch.assign(voices, 0.f);
+		drift.assign(voices, 0.f);
+		MPExFilter.assign(voices, Smoother());
+		MPEyFilter.assign(voices, Smoother());
+		MPEzFilter.assign(voices, Smoother());
+		reTrigger.assign(voices, dsp::PulseGenerator());
+		voiceSteals.assign(voices, 0);
+	}
 	///////////////////////////////////////////////////////////////////////////////////////
 	void onAdd() override{
+		dllzClaimSeed(driftSeed, driftSeedOwner, id);
+		seedDrift();
 		resetVoices();
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	void onReset() override{
+		voiceBanksSet = 1;
 		resetVoices();
 		//default midi CCs
 		midiCCs[0] = 128;
@@ -323,91 +534,162 @@ struct MIDIpolyMPE : Module {
 		pbMPE = 96;
 		mpePbOut = true;
 		driftcents = 10;
-		noteMin = 0;
-		noteMax = 127;
-		velMin = 1;
-		velMax = 127;
+		zone.set(0, 127, 1, 127);
+		velCurve.set(VelocityCurve::LINEAR);
 		mpeYcc = 74; //cc74 (default MPE Y)
 		mpeZcc = 128; //128 = ChannelAfterTouch (default MPE Z)
 		MPEmasterCh = 0;// 0 ~ 15
+		mpeLower = 15;
+		mpeUpper = 0;
+		dynMPE = true;
+		polyY = false;
+		polyZ = false;
+		mapMPEchannels();
 		displayYcc = 74;
 		displayZcc = 128;
 		cursorIx = 0;
 		polyModeIx = ROTATE_MODE;
+		voiceAlloc.policy.mode = StealPriority::ROTATE;
+		voiceAlloc.policy.keepLowest = false;
+		voiceAlloc.policy.keepHighest = false;
+		smoothX.set(SmoothShape::ONEPOLE, 10.f);
+		smoothYZ.set(SmoothShape::ONEPOLE, 10.f);
+		smoothCC.set(SmoothShape::ONEPOLE, 10.f);
+	}
+///////////////////////////////////////////////////////////////////////////////////////
+	/// channel tables of the zones. Fixed: lower members take the first voices, then upper
+	/// members from ch 15 down. Dynamic: members only, voices are bound at note on.
+	void mapMPEchannels(){
+		// master ch 1 / 16 picked on the MIDI display: its zone takes the members if it had none
+		if (((MPEmasterCh == 0) && (mpeLower == 0)) || ((MPEmasterCh == 15) && (mpeUpper == 0)))
+			std::swap(mpeLower, mpeUpper);
+		int order[16];
+		int members = 0;
+		for (int ch = 0; ch < 16; ch++) {
+			chVoice[ch] = -1;
+			voiceCh[ch] = ch;
+			chMaster[ch] = false;
+			chMember[ch] = false;
+		}
+		if ((MPEmasterCh > 0) && (MPEmasterCh < 15)) {
+			chMaster[MPEmasterCh] = true;
+			for (int ch = 0; ch < 16; ch++) {
+				if (ch != MPEmasterCh) order[members++] = ch;
+			}
+		}else {
+			int lower = ((mpeLower + mpeUpper) > 0) ? mpeLower : 15;
+			if (lower > 0) {
+				chMaster[0] = true;
+				for (int ch = 1; ch <= lower; ch++) order[members++] = ch;
+			}
+			if (mpeUpper > 0) {
+				chMaster[15] = true;
+				for (int ch = 14; ch >= 15 - mpeUpper; ch--) order[members++] = ch;
+			}
+		}
+		for (int i = 0; i < members; i++) {
+			chMember[order[i]] = true;
+			if (dynMPE) continue;
+			chVoice[order[i]] = i;
+			voiceCh[i] = order[i];
+		}
+		boundVoices = 0;
+		for (int i = 0; i < 16; i++) unbound[i] = unbindClock;
+		mappedMasterCh = MPEmasterCh;
+		if (polyModeIx < ROTATE_MODE) numVOch = dynMPE ? 1 : std::max(members, 1);
+	}
+	/// dynamic MPE: the free voice unbound longest ago, so release tails of the last notes
+	/// ring on. The lowest free voice only when all outputs are bound (the outputs grow).
+	int bindVoice(uint8_t channel){
+		uint32_t free = ~boundVoices & 0xffffu;
+		if (!free) return -1;
+		uint32_t shown = free & ((1u << numVOch) - 1u);
+		int voice = __builtin_ctz(free);
+		uint32_t age = 0;
+		for (uint32_t m = shown; m; m &= m - 1){
+			int i = __builtin_ctz(m);
+			if ((m == shown) || (unbindClock - unbound[i] > age)){
+				voice = i;
+				age = unbindClock - unbound[i];
+			}
+		}
+		chVoice[channel] = voice;
+		voiceCh[voice] = channel;
+		boundVoices |= 1u << voice;
+		// no glide from the previous note of the voice to the channel bend
+		MPExFilter[voice].reset(MidiUMPin::bipolar(mpex[channel]) * 5.f);
+		if (voice + 1 > numVOch) numVOch = voice + 1;
+		return voice;
+	}
+	/// dynamic MPE: a voice with nothing left to sound lets go of its channel
+	void unbindVoice(int voice){
+		if (!(boundVoices & (1u << voice))) return;
+		if (gates[voice] || pedalgates[voice] || !cachedMPE[voice].empty()) return;
+		chVoice[voiceCh[voice]] = -1;
+		boundVoices &= ~(1u << voice);
+		unbound[voice] = ++unbindClock;
+	}
+	/// dynamic MPE: drop the top voice once it has been unbound for a hold (one voice per hold)
+	void shrinkVoices(int hold){
+		int top = boundVoices ? 32 - __builtin_clz(boundVoices) : 1;
+		if (top >= numVOch) {
+			shrinkHold = hold;
+		}else if (--shrinkHold < 1) {
+			numVOch --;
+			lights[CH_LIGHT + numVOch].value = 0.f;
+			shrinkHold = hold;
+		}
+	}
+	/// one zone from the MCM or the menu, the other zone gives up channels (MPE spec).
+	/// Callers reset the voices (the menu through resetMidi).
+	void setMPEzone(bool upper, int members){
+		members = clamp(members, 0, 15);
+		int &other = upper ? mpeLower : mpeUpper;
+		(upper ? mpeUpper : mpeLower) = members;
+		if ((members > 0) && (other > 14 - members)) other = std::max(14 - members, 0);
+		if (mpeUpper == 0) MPEmasterCh = 0;
+		else if (mpeLower == 0) MPEmasterCh = 15;
+		else if (MPEmasterCh != 15) MPEmasterCh = 0;
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	int getPolyIndex(int nowIndex) {
-		for (int i = 0; i < numVo; i++) {
-			nowIndex++;
-			if (nowIndex > (numVo - 1))
-				nowIndex = 0;
-			if (!(gates[nowIndex] || pedalgates[nowIndex])) {
-				stealIndex = nowIndex;
-				return nowIndex;
+		voiceAlloc.numVoices = numVo;
+		voiceAlloc.policy.held = gates.mask;
+		if (voiceAlloc.policy.mode == StealPriority::QUIETEST){
+			for (int i = 0; i < numVo; i++) {// current pressure if any, else velocity
+				uint8_t aftertouch = noteData[notes[i]].aftertouch >> 25;
+				voiceAlloc.policy.levels[i] = (aftertouch > 0) ? aftertouch : (vels[i] >> 9);
 			}
 		}
+		bool stolen = false;
+		int voice = voiceAlloc.allocate(gates.mask | pedalgates.mask, nowIndex, stolen);
 		// All taken = steal (rotates)
-		stealIndex++;
-		if (stealIndex > (numVo - 1))
-			stealIndex = 0;
-		if ((polyModeIx < REASSIGN_MODE) && (gates[stealIndex]))//&&(polyMode > MPE_MODE).cannot reach here if MPE mode true
-			cachedNotes.push_back(notes[stealIndex]);
-		return stealIndex;
+		if (stolen && (polyModeIx < REASSIGN_MODE) && (gates[voice]))//&&(polyMode > MPE_MODE).cannot reach here if MPE mode true
+			cachedNotes.push_back(notes[voice]);
+		return voice;
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
-	void pressNote(uint8_t channel, uint8_t note, uint8_t vel) {
-		switch (learnNote){
-			case 0:
-				break;
-			case 1:{
-				noteMin = note;
-				if (noteMax < note) noteMax = note;
-				learnNote = 0;
-				cursorIx = 0;
-				}break;
-			case 2:{
-				noteMax = note;
-				if (noteMin > note) noteMin = note;
-				learnNote = 0;
-				cursorIx = 0;
-			}break;
-			case 3:{
-				velMin = vel;
-				if (velMax < vel) velMax = vel;
-				learnNote = 0;
-				cursorIx = 0;
-			}break;
-			case 4:{
-				velMax = vel;
-				if (velMin > vel) velMin = vel;
-				learnNote = 0;
-				cursorIx = 0;
-			}break;
+	void pressNote(uint8_t channel, uint8_t note, uint16_t vel) {
+		int vel7 = std::max(vel >> 9, 1);// learn and range in MIDI 1.0 steps
+		if (learnNote > 0){// display learn: 1 ~ 4 as KeyZone::Learn
+			zone.learn(learnNote, note, vel7);
+			learnNote = 0;
+			cursorIx = 0;
 		}
-		if (note < noteMin) return;
-		if (note > noteMax) return;
-		if (vel < velMin) return;
-		if (vel > velMax) return;
+		if (!zone.takes(note, vel7)) return;
+		vel = velCurve.lookup16(vel);
 		// Set notes and gates
 		switch (polyModeIx) {
 			case MPE_MODE:
 			case MPEPLUS_MODE:{
-				if (channel == MPEmasterCh) return; /////  R E T U R N !!!!!!!
-				//uint8_t ixch;
-				if (channel + 1 > numVOch) numVOch = channel + 1;
-				rotateIndex = channel; // ASSIGN VOICE Index
-				if (gates[channel]) cachedMPE[channel].push_back(notes[channel]);///if gate push note to mpe_buffer
-//				std::vector<uint8_t>::iterator it = std::find(dynMPEch.begin(), dynMPEch.end(), channel);
-//				if (it != dynMPEch.end()) {//found = get the index of the channel
-//					 ixch = std::distance(dynMPEch.begin(), it);
-//				}else {// not found = get index (old size) and add
-//					ixch = dynMPEch.size();
-//					dynMPEch.push_back(channel);
-//					numVOch = ixch + 1; // grow dynamic voices
-//				}
-//				rotateIndex = ixch; // ASSIGN VOICE Index
-//				if (gates[ixch]) cachedMPE[ixch].push_back(notes[ixch]);///if gate push note to mpe_buffer
-//				MPEchMap[channel] = ixch; //map channel for chPB Y Z and note off
+				int voice = chVoice[channel];
+				if ((voice < 0) && dynMPE && chMember[channel]) voice = bindVoice(channel);
+				if (voice < 0) return; /////  R E T U R N !!!!!!! (master or not a member)
+				rotateIndex = voice; // ASSIGN VOICE Index
+				if (gates[voice]){
+					cachedMPE[voice].push_back(notes[voice]);///if gate push note to mpe_buffer
+					voiceSteals[voice] ++;
+				}
 			} break;
 			case ROTATE_MODE: {
 				rotateIndex = getPolyIndex(rotateIndex);
@@ -439,7 +721,7 @@ struct MIDIpolyMPE : Module {
 					vels[i] = vel;
 					gates[i] = true;
 					pedalgates[i] = pedal;
-					drift[i] = static_cast<float>(rand() % 200  - 100) * static_cast<float>(driftcents) / 120000.f;
+					drift[i] = rng.bipolar() * static_cast<float>(driftcents) / 1200.f;
 					if (retrignow) reTrigger[i].trigger(1e-3);
 				}
 				return;/////  R E T U R N !!!!!!!
@@ -453,7 +735,7 @@ struct MIDIpolyMPE : Module {
 					vels[i] = vel;
 					gates[i] = true;
 					pedalgates[i] = pedal;
-					drift[i] = static_cast<float>(rand() % 200  - 100) * static_cast<float>(driftcents) / 120000.f;
+					drift[i] = rng.bipolar() * static_cast<float>(driftcents) / 1200.f;
 					if (retrignow) reTrigger[i].trigger(1e-3);
 				}
 				return;/////  R E T U R N !!!!!!!
@@ -467,7 +749,7 @@ struct MIDIpolyMPE : Module {
 					vels[i] = vel;
 					gates[i] = true;
 					pedalgates[i] = pedal;
-					drift[i] = static_cast<float>(rand() % 200  - 100) * static_cast<float>(driftcents) / 120000.f;
+					drift[i] = rng.bipolar() * static_cast<float>(driftcents) / 1200.f;
 					if (retrignow) reTrigger[i].trigger(1e-3);
 				}
 				return;/////  R E T U R N !!!!!!!
@@ -475,46 +757,57 @@ struct MIDIpolyMPE : Module {
 			default: break;
 		}
 		// Set notes and gates
-		if (static_cast<bool>(params[RETRIG_PARAM].getValue()) && (gates[rotateIndex] || pedalgates[rotateIndex]))
+		bool sounding = gates[rotateIndex] || pedalgates[rotateIndex];
+		if (sounding) voiceSteals[rotateIndex] ++;
+		if (static_cast<bool>(params[RETRIG_PARAM].getValue()) && sounding)
 			reTrigger[rotateIndex].trigger(1e-3);
 		notes[rotateIndex] = note;
 		vels[rotateIndex] = vel;
 		gates[rotateIndex] = true;
 		pedalgates[rotateIndex] = pedal;
-		drift[rotateIndex] = static_cast<float>((rand() % 1000 - 500) * driftcents) / 1200000.f;
-		midiActivity = vel;
+		voiceAlloc.policy.noteOn(rotateIndex, note, vel7);
+		drift[rotateIndex] = rng.bipolar() * static_cast<float>(driftcents) / 2400.f;
+		midiActivity = vel7;
+		if (polyModeIx > MPEPLUS_MODE){// no glide from the expression of the previous note
+			const NoteData &n = noteData[note];
+			MPExFilter[rotateIndex].reset(MidiUMPin::bipolar(n.bend) * 5.f);
+			MPEyFilter[rotateIndex].reset(MidiUMPin::unit(n.y) * 10.f);
+			MPEzFilter[rotateIndex].reset(MidiUMPin::unit(n.z) * 10.f);
+		}
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
-	void releaseNote(uint8_t channel, uint8_t note, uint8_t vel) {
+	void releaseNote(uint8_t channel, uint8_t note, uint32_t vel) {
+		if (vel == MidiUMPin::noVelocity) vel = 0x8000;// 64 is the default rel velocity.
 		bool backnote = false;
+		int mpeVo = chVoice[channel];
 		if (polyModeIx > MPEPLUS_MODE) {
 		// Remove the note
 			if (!cachedNotes.empty()) backnote = (note == cachedNotes.back());
 			std::vector<uint8_t>::iterator it = std::find(cachedNotes.begin(), cachedNotes.end(), note);
 			if (it != cachedNotes.end()) cachedNotes.erase(it);
 		}else{
-			if (channel == MPEmasterCh) return;
-			//get channel from dynamic map
-			std::vector<uint8_t>::iterator it = std::find(cachedMPE[channel].begin(), cachedMPE[channel].end(), note);
-			if (it != cachedMPE[channel].end()) cachedMPE[channel].erase(it);
+			if (mpeVo < 0) return;
+			std::vector<uint8_t>::iterator it = std::find(cachedMPE[mpeVo].begin(), cachedMPE[mpeVo].end(), note);
+			if (it != cachedMPE[mpeVo].end()) cachedMPE[mpeVo].erase(it);
 		}
 		switch (polyModeIx) {
 			case MPE_MODE:
 			case MPEPLUS_MODE:{
-				if (note == notes[channel]) {
-					if (pedalgates[channel]) {
-						gates[channel] = false;
+				if (note == notes[mpeVo]) {
+					if (pedalgates[mpeVo]) {
+						gates[mpeVo] = false;
 					}
 					/// check for cachednotes on MPE buffers...
-					else if (!cachedMPE[channel].empty()) {
-						notes[channel] = cachedMPE[channel].back();
-						cachedMPE[channel].pop_back();
+					else if (!cachedMPE[mpeVo].empty()) {
+						notes[mpeVo] = cachedMPE[mpeVo].back();
+						cachedMPE[mpeVo].pop_back();
 					}
 					else {
-						gates[channel] = false;
+						gates[mpeVo] = false;
 					}
-					rvels[channel] = vel;
+					rvels[mpeVo] = vel;
 				}
+				unbindVoice(mpeVo);
 			} break;
 			case REASSIGN_MODE: {
 				for (int i = 0; i < numVo; i++) {
@@ -524,13 +817,13 @@ struct MIDIpolyMPE : Module {
 						pedalgates[i] = pedal;
 					}
 					else {
+						if (gates[i]) voiceAlloc.policy.noteOff(i);
 						gates[i] = false;
 						rvels[i] = vel;
 					}
 				}
 			} break;
 			case UNISON_MODE: {
-				if (vel > 128) vel = 64;
 				if (!cachedNotes.empty()) {
 					uint8_t backnote = cachedNotes.back();
 					bool retrignow = static_cast<bool>(params[RETRIG_PARAM].getValue()) && (backnote);
@@ -549,7 +842,6 @@ struct MIDIpolyMPE : Module {
 				}
 			} break;
 			case UNISONLWR_MODE: {
-				if (vel > 128) vel = 64;
 				if (!cachedNotes.empty()) {
 					uint8_t lnote = *min_element(cachedNotes.begin(),cachedNotes.end());
 					for (int i = 0; i < numVo; i++) {
@@ -566,7 +858,6 @@ struct MIDIpolyMPE : Module {
 				}
 			} break;
 			case UNISONUPR_MODE: {
-				if (vel > 128) vel = 64;
 				if (!cachedNotes.empty()) {
 					uint8_t unote = *max_element(cachedNotes.begin(),cachedNotes.end());
 					for (int i = 0; i < numVo; i++) {
@@ -588,20 +879,23 @@ struct MIDIpolyMPE : Module {
 					if (notes[i] == note) {
 						if (pedalgates[i]) {
 							gates[i] = false;
+							voiceAlloc.policy.noteOff(i);
 						}
 						else if (!cachedNotes.empty()) {
 							notes[i] = cachedNotes.back();
 							cachedNotes.pop_back();
+							voiceAlloc.policy.noteOn(i, notes[i], vels[i] >> 9);
 						}
 						else {
 							gates[i] = false;
+							voiceAlloc.policy.noteOff(i);
 						}
 						rvels[i] = vel;
 					}
 				}
 			} break;
 		}
-		midiActivity = vel;
+		midiActivity = vel >> 9;
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	void pressPedal() {
@@ -630,9 +924,11 @@ struct MIDIpolyMPE : Module {
 						cachedMPE[i].pop_back();
 						gates[i] = true;
 				}
+				unbindVoice(i);
 			}
 		}else{
 			for (int i = 0; i < numVo; i++) {
+				if (pedalgates[i] && !gates[i]) voiceAlloc.policy.noteOff(i);// sustained tail starts
 				pedalgates[i] = false;
 				if (!cachedNotes.empty()) {
 					if  (polyModeIx < REASSIGN_MODE){
@@ -653,124 +949,180 @@ struct MIDIpolyMPE : Module {
 					}
 				}
 			}
+			refreshNoteState();
+		}
+	}
+///////////////////////////////////////////////////////////////////////////////////////
+	/// poly modes: the voices pick up the per note state of the notes they play now
+	void refreshNoteState() {
+		for (int i = 0; i < numVo; i++) {
+			const NoteData &n = noteData[notes[i]];
+			voiceBend[i] = n.bend;
+			voiceY[i] = n.y;
+			voiceZ[i] = n.z;
 		}
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
-	void processMessage(midi::Message msg) {
-		switch (msg.getStatus()) {
-				// note off
-			case 0x8: {
-				if ((polyModeIx < ROTATE_MODE) && (msg.getChannel() == MPEmasterCh)) return;
-				releaseNote(msg.getChannel(), msg.getNote(), msg.getValue());
+	/// MIDI 1.0 (fromMidi1) and UMP (decode) events, full resolution
+	void processMessage(const MidiUMPin::Event &ev) {
+		uint8_t channel = ev.channel;
+		switch (ev.kind) {
+			case MidiUMPin::NOTEOFF: {
+				if ((polyModeIx < ROTATE_MODE) && !chMember[channel]) return;
+				releaseNote(channel, ev.note, ev.value);
+				if (polyModeIx > MPEPLUS_MODE) refreshNoteState();
 			} break;
-				// note on
-			case 0x9: {
-				if ((polyModeIx < ROTATE_MODE) && (msg.getChannel() == MPEmasterCh)) return;
-				if (msg.getValue() > 0) {
-					pressNote(msg.getChannel(), msg.getNote(), msg.getValue());
-				}
-				else {
-					releaseNote(msg.getChannel(), msg.getNote(), 64);//64 is the default rel velocity.
-				}
+			case MidiUMPin::NOTEON: {
+				if ((polyModeIx < ROTATE_MODE) && !chMember[channel]) return;
+				pressNote(channel, ev.note, ev.value);
+				if (polyModeIx > MPEPLUS_MODE) refreshNoteState();
 			} break;
 				// note (poly) aftertouch
-			case 0xa: {
+			case MidiUMPin::POLYPRESS: {
 				if (polyModeIx < ROTATE_MODE) return;
-				noteData[msg.getNote()].aftertouch = msg.getValue();
-				midiActivity = msg.getValue();
+				noteData[ev.note].aftertouch = ev.value;
+				if (mpeYcc == 128) noteData[ev.note].y = ev.value;
+				if (!polyZ || (mpeZcc == 128)) noteData[ev.note].z = ev.value;
+				refreshNoteState();
+				midiActivity = ev.value >> 25;
 			} break;
 				// channel aftertouch
-			case 0xd: {
+			case MidiUMPin::CHPRESS: {
 				if (learnCC > 0) {// learn enabled ???
 					midiCCs[learnCC - 1] = 128;
 					learnCC = 0;
 					return;
 				}////////////////////////////////////////
 				else if (polyModeIx < ROTATE_MODE){
-					uint8_t channel = msg.getChannel();
-					if (channel == MPEmasterCh){
-						chAfTch = msg.getNote();
+					if (chMaster[channel]){
+						chAfTch = ev.value;
+					}else if (!chMember[channel]){
+						return;
 					}else if (polyModeIx > 0){
-						mpez[channel] =  msg.getNote() * 128 + mpePlusLB[channel];
-						mpePlusLB[channel] = 0;
+						mpez[channel] = plusValue(channel, ev.value);
 					}else {
 						if (mpeZcc == 128)
-							mpez[channel] = msg.getNote() * 128;
+							mpez[channel] = ev.value;
 						if (mpeYcc == 128)
-							mpey[channel] = msg.getNote() * 128;
+							mpey[channel] = ev.value;
 					}
 				}else{
-					chAfTch = msg.getNote();
+					chAfTch = ev.value;
 				}
-				midiActivity = msg.getNote();
+				midiActivity = ev.value >> 25;
 			} break;
-				// pitch Bend
-			case 0xe:{
+			case MidiUMPin::PITCHBEND:{
 				if (learnCC > 0) {// learn enabled ???
 					midiCCs[learnCC - 1] = 128;
 					learnCC = 0;
 					return;
 				}////////////////////////////////////////
 				else if (polyModeIx < ROTATE_MODE){
-					uint8_t channel = msg.getChannel();
-					if (channel == MPEmasterCh){
-						mPBnd = msg.getValue() * 128 + msg.getNote()  - 8192;
-					}else{
-						mpex[channel] = msg.getValue() * 128 + msg.getNote()  - 8192;
+					if (chMaster[channel]){
+						mPBnd = MidiUMPin::bend(ev.value);
+					}else if (chMember[channel]){
+						mpex[channel] = MidiUMPin::bend(ev.value);
 					}
 				}else{
-					mPBnd = msg.getValue() * 128 + msg.getNote() - 8192; //14bit Pitch Bend
+					mPBnd = MidiUMPin::bend(ev.value);
+				}
+				midiActivity = ev.value >> 25;
+			} break;
+				// MIDI 2.0 per note pitch and controllers: a member channel plays one note,
+				// poly modes keep them per note (Y and Z mapped by the MPE Y / Z cc)
+			case MidiUMPin::NOTEBEND:{
+				if (polyModeIx > MPEPLUS_MODE){
+					noteData[ev.note].bend = MidiUMPin::bend(ev.value);
+					refreshNoteState();
+				}else if (chMember[channel]) mpex[channel] = MidiUMPin::bend(ev.value);
+			} break;
+			case MidiUMPin::NOTECC:{
+				if (polyModeIx > MPEPLUS_MODE){
+					if (ev.index == mpeYcc) noteData[ev.note].y = ev.value;
+					if (polyZ && (ev.index == mpeZcc)) noteData[ev.note].z = ev.value;
+					refreshNoteState();
+				}else if (chMember[channel]){
+					if (ev.index == ((polyModeIx == MPEPLUS_MODE) ? 74 : mpeYcc)) mpey[channel] = ev.value;
+					else if ((polyModeIx == MPE_MODE) && (ev.index == mpeZcc)) mpez[channel] = ev.value;
+				}
+			} break;
+			case MidiUMPin::RPN:{
+				if ((polyModeIx < ROTATE_MODE) && (ev.index == 6) && ((channel == 0) || (channel == 15))){// MPE Configuration Message
+					setMPEzone(channel == 15, ev.value >> 25);
+					resetVoices();
+				}else if (ev.index == 0){
+					setPbRange((polyModeIx < ROTATE_MODE) && !chMaster[channel], ev.value >> 25);
+				}else if (ev.index == 7){// MIDI 2.0 per note bend sensitivity
+					setPbRange(true, ev.value >> 25);
 				}
-				midiActivity = msg.getValue();
 			} break;
-				// cc
-			case 0xb: {
+			case MidiUMPin::CC: {
 				if (polyModeIx < ROTATE_MODE){
-					uint8_t channel = msg.getChannel();
-					if (channel == MPEmasterCh){
-						if (learnCC > 0) {///////// LEARN CC MPE master
-							midiCCs[learnCC - 1] = msg.getNote();
-							learnCC = 0;
-							return;
-						}else processCC(msg);
+					if (chMaster[channel] && (learnCC > 0)) {///////// LEARN CC MPE master
+						midiCCs[learnCC - 1] = ev.index;
+						learnCC = 0;
+						return;
+					}
+					if (chMaster[channel]){
+						processCC(ev);
+					}else if (!chMember[channel]){
+						return;
 					}else if (polyModeIx == MPEPLUS_MODE){ //Continuum
-						if (msg.getNote() == 87){
-							mpePlusLB[channel] = msg.getValue();
-						}else if (msg.getNote() == 74){
-							mpey[channel] =  msg.getValue() * 128 + mpePlusLB[channel];
-							mpePlusLB[channel] = 0;
+						if (ev.index == 87){
+							mpePlusLB[channel] = ev.value >> 25;
+						}else if (ev.index == 74){
+							mpey[channel] = plusValue(channel, ev.value);
 						}
-					}else if (msg.getNote() == mpeYcc){
+					}else if (ev.index == mpeYcc){
 						//cc74 0x4a default
-						mpey[channel] = msg.getValue() * 128;
-					}else if (msg.getNote() == mpeZcc){
-						mpez[channel] = msg.getValue() * 128;
+						mpey[channel] = ev.value;
+					}else if (ev.index == mpeZcc){
+						mpez[channel] = ev.value;
 					}
 				}else if (learnCC > 0) {///////// LEARN CC Poly
-					midiCCs[learnCC - 1] = msg.getNote();
+					midiCCs[learnCC - 1] = ev.index;
 					learnCC = 0;
 					return;
-				}else processCC(msg);
-				midiActivity = msg.getValue();
+				}else{
+					processCC(ev);
+				}
+				midiActivity = ev.value >> 25;
 			} break;
 			default: break;
 		}
 	}
+	/// Haken MPE+: a 7-bit LSB sent ahead (CC 87) makes the next Y or Z 14-bit
+	uint32_t plusValue(uint8_t channel, uint32_t value) {
+		if (!mpePlusLB[channel]) return value;
+		uint32_t fine = MidiUMPin::scaleUp(((value >> 25) << 7) | mpePlusLB[channel], 14, 32);
+		mpePlusLB[channel] = 0;
+		return fine;
+	}
 ///////////////////////////////////////////////////////////////////////////////////////
-	void processCC(midi::Message msg) {
-		if (msg.getNote() ==  0x40) { //internal sust pedal
-			if (msg.getValue() >= 64)
+	/// master / poly channel controllers, 32-bit values
+	void processCC(const MidiUMPin::Event &cc) {
+		if (cc.index ==  0x40) { //internal sust pedal
+			if (cc.value >= 0x80000000u)
 				pressPedal();
 			else
 				releasePedal();
 		}
 		for (int i = 0; i < 8; i++){
-			if (midiCCs[i] == msg.getNote()){
-				midiCCsVal[i] = msg.getValue();
+			if (midiCCs[i] == cc.index){
+				midiCCsVal[i] = cc.value;
 				return;
 			}
 		}
 	}
+	/// RPN 0 (pitch bend sensitivity, semitones): MPE members set the voice bend, others the main bend
+	void setPbRange(bool member, int semitones) {
+		if (member) {
+			pbMPE = clamp(semitones, 0, 96);
+		}else {
+			pbMainUp = clamp(semitones, 0, 96);
+			pbMainDwn = -pbMainUp;
+		}
+	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	void dataPlus(){
 		switch (cursorIx){
@@ -800,21 +1152,25 @@ struct MIDIpolyMPE : Module {
 				if (polyModeIx < ROTATE_MODE) {
 					if (pbMPE < 96) pbMPE ++;
 				} else {
-					if (numVo < 16) numVo ++;
+					if (numVo < 16 * voiceBanks) numVo ++;
 					resetVoices();
 				}
 			}break;
 			case 3: {
-				if (noteMin < noteMax) noteMin ++;
+				if (zone.noteMin < zone.noteMax) zone.noteMin ++;
+				zone.build();
 			}break;
 			case 4: {
-				if (noteMax < 127) noteMax ++;
+				if (zone.noteMax < 127) zone.noteMax ++;
+				zone.build();
 			}break;
 			case 5: {
-				if (velMin < velMax) velMin ++;
+				if (zone.velMin < zone.velMax) zone.velMin ++;
+				zone.build();
 			}break;
 			case 6: {
-				if (velMax < 127) velMax ++;
+				if (zone.velMax < 127) zone.velMax ++;
+				zone.build();
 			}break;
 			case 7: {
 				if (polyModeIx == MPE_MODE) {
@@ -883,16 +1239,20 @@ struct MIDIpolyMPE : Module {
 				}
 			}break;
 			case 3: {
-				if (noteMin > 0) noteMin --;
+				if (zone.noteMin > 0) zone.noteMin --;
+				zone.build();
 			}break;
 			case 4: {
-				if (noteMax > noteMin) noteMax --;
+				if (zone.noteMax > zone.noteMin) zone.noteMax --;
+				zone.build();
 			}break;
 			case 5: {
-				if (velMin > 1) velMin --;
+				if (zone.velMin > 1) zone.velMin --;
+				zone.build();
 			}break;
 			case 6: {
-				if (velMax > velMin) velMax --;
+				if (zone.velMax > zone.velMin) zone.velMax --;
+				zone.build();
 			}break;
 			case 7: {
 				if (polyModeIx == MPE_MODE) {
@@ -928,66 +1288,185 @@ struct MIDIpolyMPE : Module {
 	}
 ///////////////////////////////////////////////////////////////////////////////////////
 	void onSampleRateChange() override {
+		setMeterRate(APP->engine->getSampleRate());
 		resetVoices();
 	}
+	void publishVoiceMap(){
+		VoiceMap &v = voiceMapSnap.write();
+		v.polyModeIx = polyModeIx;
+		v.voices = std::min((polyModeIx > MPEPLUS_MODE) ? numVo : numVOch, 16);// first group
+		v.rotateIndex = rotateIndex;
+		for (int i = 0; i < 16; i++){
+			v.notes[i] = notes[i];
+			v.gates[i] = gates[i];
+			v.pedalgates[i] = pedalgates[i];
+			v.bend[i] = xpitch[i] * pbMPE / 5.f;
+			v.y[i] = MidiUMPin::unit(mpey[voiceCh[i]]);
+			v.z[i] = MidiUMPin::unit(mpez[voiceCh[i]]);
+			v.steals[i] = voiceSteals[i];
+			int stacked = static_cast<int>(cachedMPE[i].size());
+			v.numStacked[i] = std::min(stacked, 4);
+			for (int j = 0; j < v.numStacked[i]; j++) v.stacked[i][j] = cachedMPE[i][stacked - 1 - j];
+		}
+		int cached = static_cast<int>(cachedNotes.size());
+		v.numCached = std::min(cached, 16);
+		for (int j = 0; j < v.numCached; j++) v.cached[j] = cachedNotes[cached - 1 - j];
+		voiceMapSnap.publish();
+	}
+	/// ~60 meter frames per second, never more than the ui draws
+	void setMeterRate(float sampleRate){
+		meterDivider.setDivision(std::max(1, static_cast<int>(sampleRate / 60.f)));
+	}
+	void pushMeters(){
+		float *m = meterRing.write();
+		for (int i = 0; i < 8; i++) m[i] = MidiUMPin::unit((midiCCs[i] == 128) ? chAfTch : midiCCsVal[i]);
+		for (int i = 0; i < 16; i++){
+			m[8 + i * 3] = std::min(std::fabs(xpitch[i]) / 5.f, 1.f);
+			m[9 + i * 3] = MidiUMPin::unit(mpey[voiceCh[i]]);
+			m[10 + i * 3] = MidiUMPin::unit(mpez[voiceCh[i]]);
+		}
+		meterRing.push();
+	}
 	
+	void publishDisplay(){
+		DispState &d = dispSnap.write();
+		d.polyModeIx = polyModeIx;
+		d.cursorIx = cursorIx;
+		d.learnNote = learnNote;
+		d.learnCC = learnCC;
+		d.pbMPE = pbMPE;
+		d.numVo = numVo;
+		d.numVOch = numVOch;
+		d.noteMin = zone.noteMin;
+		d.noteMax = zone.noteMax;
+		d.velMin = zone.velMin;
+		d.velMax = zone.velMax;
+		d.displayYcc = displayYcc;
+		d.displayZcc = ((polyModeIx > MPEPLUS_MODE) && polyZ && (mpeZcc < 128)) ? mpeZcc : displayZcc;
+		d.driftcents = driftcents;
+		d.mpePbOut = mpePbOut;
+		d.trnsps = trnsps;
+		d.pbMainDwn = pbMainDwn;
+		d.pbMainUp = pbMainUp;
+		for (int i = 0; i < 8; i++) d.midiCCs[i] = midiCCs[i];
+		disp.begin();
+		disp.add(d.polyModeIx);
+		disp.add(d.cursorIx);
+		disp.add(d.learnNote);
+		disp.add(d.learnCC);
+		disp.add(d.pbMPE);
+		disp.add(d.numVo);
+		disp.add(d.numVOch);
+		disp.add(d.noteMin);
+		disp.add(d.noteMax);
+		disp.add(d.velMin);
+		disp.add(d.velMax);
+		disp.add(d.displayYcc);
+		disp.add(d.displayZcc);
+		disp.add(d.driftcents);
+		disp.add(d.mpePbOut);
+		disp.add(d.trnsps);
+		disp.add(d.pbMainDwn);
+		disp.add(d.pbMainUp);
+		for (int i = 0; i < 8; i++) disp.add(d.midiCCs[i]);
+		if (disp.end()){
+			d.gen = disp.gen;
+			dispSnap.publish();
+		}
+	}
+	/// voice lights: rotation index plus held gate, Rack smoothing on release
+	void processLights(float lightTime){
+		bool sustainHold = (params[SUSTHOLD_PARAM].getValue() > .5 );
+		int voices = std::min((polyModeIx > MPEPLUS_MODE) ? numVo : numVOch, 16);
+		for (int i = 0; i < voices; i++) {
+			bool held = gates[i] || (sustainHold && pedalgates[i]);
+			lights[CH_LIGHT + i].setBrightnessSmooth(((i == rotateIndex)? 0.2f : 0.f) + (held ? .8f : 0.f), lightTime);
+		}
+	}
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////
 //////   STEP START
 ///////////////////////
 	void process(const ProcessArgs &args) override {
-		outputs[X_OUTPUT].setChannels(numVOch);
-		outputs[Y_OUTPUT].setChannels(numVOch);
-		outputs[Z_OUTPUT].setChannels(numVOch);
-		outputs[VEL_OUTPUT].setChannels(numVOch);
-		outputs[RVEL_OUTPUT].setChannels(numVOch);
-		outputs[GATE_OUTPUT].setChannels(numVOch);
+		if (dispDivider.process()){
+			if ((polyModeIx < ROTATE_MODE) && (MPEmasterCh != mappedMasterCh)) resetVoices();// master set on the MIDI display
+			if ((polyModeIx < ROTATE_MODE) && dynMPE) shrinkVoices(static_cast<int>(args.sampleRate) / dispDivider.getDivision());
+			publishDisplay();
+			if (voiceMapOn.load(std::memory_order_relaxed)) publishVoiceMap();
+		}
+		if (lightDivider.process()) processLights(args.sampleTime * lightDivider.getDivision());
+		if (meterDivider.process()) pushMeters();
+		int channels = std::min(numVOch, 16);
+		outputs[X_OUTPUT].setChannels(channels);
+		outputs[Y_OUTPUT].setChannels(channels);
+		outputs[Z_OUTPUT].setChannels(channels);
+		outputs[VEL_OUTPUT].setChannels(channels);
+		outputs[RVEL_OUTPUT].setChannels(channels);
+		outputs[GATE_OUTPUT].setChannels(channels);
 		midi::Message msg;
 		while (midiInput.shift(&msg)) {
-			processMessage(msg);
+			processMessage(midiIn.fromMidi1(msg));
+		}
+		if (!umpDone.load()){// the ui frees the replaced file, nothing is freed here
+			if (UMPfile *loaded = umpLoad.exchange(NULL)){
+				std::swap(umpFile, *loaded);
+				umpDone.store(loaded);
+			}
 		}
-		float pbVo = 0.f, pbVoice = 0.f;
-		if (mPBnd < 0){
-			pbVo = mPBndFilter.process(1.f ,rescale(mPBnd, -8192, 0, -5.f, 0.f));
-			pbVoice = -1.f * pbVo * pbMainDwn / 60.f;
-		} else {
-			pbVo = mPBndFilter.process(1.f ,rescale(mPBnd, 0, 8191, 0.f, 5.f));
-			pbVoice = pbVo * pbMainUp / 60.f;
+		if (!umpFile.done()){
+			umpFile.advance(args.sampleTime * 1000.f);
+			while (const uint32_t *packet = umpFile.next()) processMessage(midiIn.decode(packet));
 		}
+		float pbVo = mPBndFilter.process(smoothCC, MidiUMPin::bipolar(mPBnd) * 5.f);
+		float pbVoice = pbVo * ((mPBnd < 0) ? -pbMainDwn : pbMainUp) / 60.f;
 		outputs[PBEND_OUTPUT].setVoltage(pbVo);
 		bool sustainHold = (params[SUSTHOLD_PARAM].getValue() > .5 );
+		Module *spillModule = (rightExpander.module && (rightExpander.module->model == modelMIDIpolySpill)) ? rightExpander.module : NULL;
+		VoiceSpill *spill = spillModule ? static_cast<VoiceSpill *>(spillModule->leftExpander.producerMessage) : &spillScratch;
+		for (int g = 0; g < VoiceSpill::groups; g++) spill->channels[g] = 0;
 		if (polyModeIx > MPEPLUS_MODE){
-			for (int i = 0; i < numVo; i++) {
-				float lastGate = ((gates[i] || (sustainHold && pedalgates[i])) && (!(reTrigger[i].process(args.sampleTime))))? 10.f : 0.f;
-				outputs[GATE_OUTPUT].setVoltage(lastGate, i);
-				float thispitch = ((notes[i] - 60 + trnsps) / 12.f) + pbVoice;
-				outputs[X_OUTPUT].setVoltage(thispitch, i);
-				outputs[Y_OUTPUT].setVoltage(thispitch + drift[i] , i);	//drifted out
-				outputs[VEL_OUTPUT].setVoltage(rescale(vels[i], 0, 127, 0.f, 10.f), i);
-				outputs[RVEL_OUTPUT].setVoltage(rescale(rvels[i], 0, 127, 0.f, 10.f), i);
-				outputs[Z_OUTPUT].setVoltage(rescale(noteData[notes[i]].aftertouch, 0, 127, 0.f, 10.f), i);
-				lights[CH_LIGHT+ i].value = ((i == rotateIndex)? 0.2f : 0.f) + (lastGate * .08f);
+			/// one pass per group of 16, the first on the poly outputs, the others spill
+			for (int b = 0; b < voiceBanks; b++) {
+				float *out[VoiceSpill::NUM_OUTS];
+				for (int o = 0; o < VoiceSpill::NUM_OUTS; o++)
+					out[o] = (b == 0) ? outputs[X_OUTPUT + o].voltages : spill->voltages[b - 1][o];
+				int first = b * 16;
+				int last = std::min(numVo, first + 16);
+				if (b > 0) spill->channels[b - 1] = std::max(last - first, 0);
+				for (int i = first; i < last; i++) {
+					int c = i - first;
+					float lastGate = ((gates[i] || (sustainHold && pedalgates[i])) && (!(reTrigger[i].process(args.sampleTime))))? 10.f : 0.f;
+					out[VoiceSpill::GATE][c] = lastGate;
+					xpitch[i] = MPExFilter[i].process(smoothX, MidiUMPin::bipolar(voiceBend[i]) * 5.f);// per note bend, MPE range
+					float thispitch = ((notes[i] - 60 + trnsps) / 12.f) + pbVoice + xpitch[i] * pbMPE / 60.f;
+					out[VoiceSpill::X][c] = thispitch;
+					if (polyY) out[VoiceSpill::Y][c] = MPEyFilter[i].process(smoothYZ, MidiUMPin::unit(voiceY[i]) * 10.f);
+					else out[VoiceSpill::Y][c] = thispitch + drift[i];	//drifted out
+					out[VoiceSpill::VEL][c] = vels[i] * (10.f / 65535.f);
+					out[VoiceSpill::RVEL][c] = rvels[i] * (10.f / 65535.f);
+					out[VoiceSpill::Z][c] = MPEzFilter[i].process(smoothYZ, MidiUMPin::unit(voiceZ[i]) * 10.f);
+				}
 			}
 		} else {/// MPE MODE!!!
 			for (int i = 0; i < numVOch; i++) {
+					int ch = voiceCh[i];
 					float lastGate = ((gates[i] || (sustainHold && pedalgates[i])) && (!(reTrigger[i].process(args.sampleTime))))? 10.f : 0.f;
 					outputs[GATE_OUTPUT].setVoltage(lastGate, i);
-					if (mpex[i] < 0) xpitch[i] = (MPExFilter[i].process(1.f ,rescale(mpex[i], -8192, 0, -5.f, 0.f)));
-					else xpitch[i] = (MPExFilter[i].process(1.f ,rescale(mpex[i], 0, 8191, 0.f, 5.f)));
+					xpitch[i] = MPExFilter[i].process(smoothX, MidiUMPin::bipolar(mpex[ch]) * 5.f);
 					outputs[X_OUTPUT].setVoltage(xpitch[i]  * pbMPE / 60.f + ((notes[i] - 60) / 12.f) + pbVoice, i);
-					outputs[VEL_OUTPUT].setVoltage(rescale(vels[i], 0, 127, 0.f, 10.f), i);
+					outputs[VEL_OUTPUT].setVoltage(vels[i] * (10.f / 65535.f), i);
 					if (mpePbOut || (polyModeIx > MPE_MODE)) outputs[RVEL_OUTPUT].setVoltage(xpitch[i], i);
-					else outputs[RVEL_OUTPUT].setVoltage(rescale(rvels[i], 0, 127, 0.f, 10.f), i);
-					outputs[Y_OUTPUT].setVoltage(MPEyFilter[i].process(1.f ,rescale(mpey[i], 0, 16383, 0.f, 10.f)), i);
-					outputs[Z_OUTPUT].setVoltage(MPEzFilter[i].process(1.f ,rescale(mpez[i], 0, 16383, 0.f, 10.f)), i);
-					lights[CH_LIGHT + i].value = ((i == rotateIndex)? 0.2f : 0.f) + (lastGate * .08f);
+					else outputs[RVEL_OUTPUT].setVoltage(rvels[i] * (10.f / 65535.f), i);
+					outputs[Y_OUTPUT].setVoltage(MPEyFilter[i].process(smoothYZ, MidiUMPin::unit(mpey[ch]) * 10.f), i);
+					outputs[Z_OUTPUT].setVoltage(MPEzFilter[i].process(smoothYZ, MidiUMPin::unit(mpez[ch]) * 10.f), i);
 			}
 		}
+		if (spillModule) spillModule->leftExpander.messageFlipRequested = true;
 		for (int i = 0; i < 8; i++){
 			if (midiCCs[i] == 128)
-				outputs[MM_OUTPUT + i].setVoltage(MCCsFilter[i].process(1.f ,rescale(chAfTch, 0, 127, 0.f, 10.f)));
+				outputs[MM_OUTPUT + i].setVoltage(MCCsFilter[i].process(smoothCC, MidiUMPin::unit(chAfTch) * 10.f));
 			else
-				outputs[MM_OUTPUT + i].setVoltage(MCCsFilter[i].process(1.f ,rescale(midiCCsVal[i], 0, 127, 0.f, 10.f)));
+				outputs[MM_OUTPUT + i].setVoltage(MCCsFilter[i].process(smoothCC, MidiUMPin::unit(midiCCsVal[i]) * 10.f));
 		}
 		if (resetMidi) resetVoices();// resetMidi from MIDI widget;
 		if (autoFocusOff > 0){
@@ -1034,21 +1513,25 @@ struct MIDIpolyMPE : Module {
 // Main Display///////////////////////////////////////////////////////////////////////////////////////
 struct PolyModeDisplay : TransparentWidget {
 	PolyModeDisplay(){
-		font = APP->window->loadFont(mFONT_FILE);
+		font = pluginFont(mFONT_FILE);
 	}
 	MIDIpolyMPE *module;
+	DispFlash *flash = NULL;
 	float mdfontSize = 12.f;
-	std::string sMode = "";
-	std::string sVo = "";
-	std::string sPBM = "";
-	std::string snoteMin = "";
-	std::string snoteMax = "";
-	std::string svelMin = "";
-	std::string svelMax = "";
-	std::string yyDisplay = "";
-	std::string zzDisplay = "";
+	DispText sVo;
+	DispText snoteMin;
+	DispText snoteMax;
+	DispText svelMin;
+	DispText svelMax;
+	/// last formatted values
+	int p_polyModeIx = -1;
+	int p_voValue = -1;
+	int p_noteMin = -1;
+	int p_noteMax = -1;
+	int p_velMin = -1;
+	int p_velMax = -1;
 	std::shared_ptr<Font> font;
-	std::string polyModeStr[9] = {
+	const char *polyModeStr[9] = {
 		"M. P. E.",
 		"M. P. E. Plus",
 		"R O T A T E",
@@ -1059,138 +1542,99 @@ struct PolyModeDisplay : TransparentWidget {
 		"U N I S O N Lower",
 		"U N I S O N Upper",
 	};
-	std::string noteName[12] = {"C","C#","D","Eb","E","F","F#","G","Ab","A","Bb","B"};
-	int drawFrame = 0;
 	int cursorIxI = 0;
-	int flashFocus = 0;
-	unsigned char lrnflash = 0x55;
 	const unsigned char rgbx = 0xdd;
-	unsigned char rgblrn, gb1, gb2, gb3, gb4, gb1f, gb2f, gb3f, gb4f;
-	unsigned char rgbf1 = 0xdd;
-	unsigned char rgbf2 = 0xdd;
+	const Rect focusBoxes[6] = {
+		Rect(1.f, 1.f, 134.f, 12.f),// PolyMode
+		Rect(1.f, 14.f, 134.f, 12.f),//numVoices/PB MPE
+		Rect(19.f, 28.f, 29.f, 12.f),//minNote
+		Rect(48.f, 28.f, 29.f, 12.f),//maxNote
+		Rect(93.f, 28.f, 20.f, 12.f),//minVel
+		Rect(113.f, 28.f, 20.f, 12.f),//maxVel
+	};
 
+	/// cached in a framebuffer: redrawn when the module display generation moves,
+	/// the focus flash and learn blink run on the overlay
 	void draw(const DrawArgs &args) override {
-		if (cursorIxI != module->cursorIx){
-			cursorIxI = module->cursorIx;
-			flashFocus = 64;
+		const MIDIpolyMPE::DispState &d = module->dispSnap.read();
+		bool newFocus = (cursorIxI != d.cursorIx);
+		cursorIxI = d.cursorIx;
+		int voValue = (d.polyModeIx < 2) ? d.pbMPE : d.numVo;
+		if ((p_polyModeIx != d.polyModeIx) || (p_voValue != voValue)){
+			p_polyModeIx = d.polyModeIx;
+			p_voValue = voValue;
+			sVo.set((p_polyModeIx < 2) ? "Vo chnl PBend: " : "Voice channels: ").add(voValue);
 		}
-		sMode = polyModeStr[module->polyModeIx];
-		if (module->polyModeIx < 2){
-			sVo =  "Vo chnl PBend: " + std::to_string(module->pbMPE);
-		}else{
-			sVo = "Voice channels: " + std::to_string(module->numVo);
-		}
-		snoteMin = noteName[module->noteMin % 12] + std::to_string((module->noteMin / 12) - 2);
-		snoteMax = noteName[module->noteMax % 12] + std::to_string((module->noteMax / 12) - 2);
-		svelMin = std::to_string(module->velMin);
-		svelMax = std::to_string(module->velMax);
-		gb1 = rgbx;
-		gb2 = rgbx;
-		gb3 = rgbx;
-		gb4 = rgbx;
-		rgbf1 = rgbx;
-		rgbf2 = rgbx;
-		gb1f = rgbx;
-		gb2f = rgbx;
-		gb3f = rgbx;
-		gb4f = rgbx;
-		rgblrn =  0x64;
-		switch (cursorIxI){
-			case 0:{
-				goto noFocus;
-			}break;
-			case 1:{ // PolyMode
-				nvgBeginPath(args.vg);
-				nvgRoundedRect(args.vg, 1.f, 1.f, 134.f, 12.f, 3.f);
-				lrnflash = 0x64;
-				rgbf1 = 0;
-			}break;
-			case 2:{ //numVoices/PB MPE
-				nvgBeginPath(args.vg);
-				nvgRoundedRect(args.vg, 1.f, 14.f, 134.f, 12.f, 3.f);
-				lrnflash = 0x64;
-				rgbf2 = 0;
-			}break;
-			case 3:{ //minNote
-				nvgBeginPath(args.vg);
-				nvgRoundedRect(args.vg, 19.f, 28.f, 29.f, 12.f, 3.f);
-				gb1f = 0;
-				if (module->learnNote == 1) {
-					snoteMin = "LRN";
-					if ((lrnflash += 16) > 255) lrnflash = 0;
-					gb1 = 0;
-					rgblrn = 0;
-				}else{
-					lrnflash = 0x64;
-				}
-			}break;
-			case 4:{ //maxNote
-				nvgBeginPath(args.vg);
-				nvgRoundedRect(args.vg, 48.f, 28.f, 29.f, 12.f, 3.f);
-				gb2f = 0;
-				if (module->learnNote == 2) {
-					snoteMax = "LRN";
-					if ((lrnflash += 16) > 255) lrnflash = 0;
-					gb2 = 0;
-					rgblrn = 0;
-				}else{
-					lrnflash = 0x64;
-				}
-			}break;
-			case 5:{ //minVel
-				nvgBeginPath(args.vg);
-				nvgRoundedRect(args.vg, 93.f, 28.f, 20.f, 12.f, 3.f);
-				gb3f = 0;
-				if (module->learnNote == 3) {
-					svelMin = "LRN";
-					if ((lrnflash += 16) > 255) lrnflash = 0;
-					gb3 = 0;
-					rgblrn = 0;
-				}else{
-					lrnflash = 0x64;
-				}
-			}break;
-			case 6:{ //maxVel
-				nvgBeginPath(args.vg);
-				nvgRoundedRect(args.vg, 113.f, 28.f, 20.f, 12.f, 3.f);
-				gb4f = 0;
-				if (module->learnNote == 4) {
-					svelMax = "LRN";
-					if ((lrnflash += 16) > 255) lrnflash = 0;
-					gb4 = 0;
-					rgblrn = 0;
-				}else{
-					lrnflash = 0x64;
-				}
-			}break;
-			default:{
-				goto noFocus;
+		if (p_noteMin != d.noteMin){
+			p_noteMin = d.noteMin;
+			snoteMin.clear().addNote(p_noteMin);
+		}
+		if (p_noteMax != d.noteMax){
+			p_noteMax = d.noteMax;
+			snoteMax.clear().addNote(p_noteMax);
+		}
+		if (p_velMin != d.velMin){
+			p_velMin = d.velMin;
+			svelMin.clear().add(p_velMin);
+		}
+		if (p_velMax != d.velMax){
+			p_velMax = d.velMax;
+			svelMax.clear().add(p_velMax);
+		}
+		const char *minMaxTxt[4] = {snoteMin.c_str(), snoteMax.c_str(), svelMin.c_str(), svelMax.c_str()};
+		unsigned char gb[4] = {rgbx, rgbx, rgbx, rgbx};
+		unsigned char gbf[4] = {rgbx, rgbx, rgbx, rgbx};
+		unsigned char rgbf1 = rgbx;
+		unsigned char rgbf2 = rgbx;
+		if ((cursorIxI > 0) && (cursorIxI < 7)){
+			const Rect &r = focusBoxes[cursorIxI - 1];
+			bool learning = false;
+			switch (cursorIxI){
+				case 1:{ // PolyMode
+					rgbf1 = 0;
+				}break;
+				case 2:{ //numVoices/PB MPE
+					rgbf2 = 0;
+				}break;
+				default:{ //min max note / vel
+					int i = cursorIxI - 3;
+					gbf[i] = 0;
+					if (d.learnNote == i + 1) {
+						minMaxTxt[i] = "LRN";
+						gb[i] = 0;
+						learning = true;
+					}
+				}break;
 			}
+			nvgBeginPath(args.vg);
+			nvgRoundedRect(args.vg, r.pos.x, r.pos.y, r.size.x, r.size.y, 3.f);
+			nvgFillColor(args.vg, nvgRGBA(0x64, (learning) ? 0 : 0x64, 0, 0xc0)); //SELECTED
+			nvgFill(args.vg);
+			if (newFocus) flash->focus(r, 64, 1);
+			flash->learn(r, learning);
+		}else{
+			flash->learn(Rect(), false);
+			flash->fade = 0;
 		}
-		if (flashFocus > 0)	flashFocus --;
-		nvgFillColor(args.vg, nvgRGBA(lrnflash, rgblrn, 0, 0xc0 + flashFocus)); //SELECTED
-		nvgFill(args.vg);
-		//nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
-	noFocus:
 		nvgFontSize(args.vg, mdfontSize);
 		nvgFontFaceId(args.vg, font->handle);
 		nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
 		nvgFillColor(args.vg, nvgRGB(rgbx, rgbx, rgbf1));
-		nvgTextBox(args.vg, 1.f, 11.0f, 134.f, sMode.c_str(), NULL);
+		nvgTextBox(args.vg, 1.f, 11.0f, 134.f, polyModeStr[p_polyModeIx], NULL);
 		nvgFillColor(args.vg, nvgRGB(rgbx, rgbx, rgbf2));
 		nvgTextBox(args.vg, 1.f, 24.f, 134.f, sVo.c_str(), NULL);
-		nvgFillColor(args.vg, nvgRGB(rgbx, gb1 & gb2, gb1f & gb2f));
+		nvgFillColor(args.vg, nvgRGB(rgbx, gb[0] & gb[1], gbf[0] & gbf[1]));
 		nvgTextBox(args.vg, 1.f, 37.f, 18.f, "nte:", NULL);
-		nvgFillColor(args.vg, nvgRGB(rgbx, gb1, gb1f));
-		nvgTextBox(args.vg, 19.f, 37.f, 29.f, snoteMin.c_str(), NULL);
-		nvgFillColor(args.vg, nvgRGB(rgbx, gb2, gb2f));
-		nvgTextBox(args.vg, 48.f, 37.f, 29.f, snoteMax.c_str(), NULL);
-		nvgFillColor(args.vg, nvgRGB(rgbx, gb3 & gb4, gb3f & gb4f));
+		nvgFillColor(args.vg, nvgRGB(rgbx, gb[0], gbf[0]));
+		nvgTextBox(args.vg, 19.f, 37.f, 29.f, minMaxTxt[0], NULL);
+		nvgFillColor(args.vg, nvgRGB(rgbx, gb[1], gbf[1]));
+		nvgTextBox(args.vg, 48.f, 37.f, 29.f, minMaxTxt[1], NULL);
+		nvgFillColor(args.vg, nvgRGB(rgbx, gb[2] & gb[3], gbf[2] & gbf[3]));
 		nvgTextBox(args.vg, 77.f, 37.f, 16.f, "vel:", NULL);
-		nvgFillColor(args.vg, nvgRGB(rgbx, gb3, gb3f));
-		nvgTextBox(args.vg, 93.f, 37.f, 20.f, svelMin.c_str(), NULL);
-		nvgFillColor(args.vg, nvgRGB(rgbx, gb4, gb4f));
-		nvgTextBox(args.vg, 113.f, 37.f, 20.f, svelMax.c_str(), NULL);
+		nvgFillColor(args.vg, nvgRGB(rgbx, gb[2], gbf[2]));
+		nvgTextBox(args.vg, 93.f, 37.f, 20.f, minMaxTxt[2], NULL);
+		nvgFillColor(args.vg, nvgRGB(rgbx, gb[3], gbf[3]));
+		nvgTextBox(args.vg, 113.f, 37.f, 20.f, minMaxTxt[3], NULL);
 	}
 	void onButton(const event::Button &e) override {
 		if ((e.button == GLFW_MOUSE_BUTTON_LEFT) && (e.action == GLFW_PRESS)){
@@ -1226,11 +1670,12 @@ struct PolyModeDisplay : TransparentWidget {
 ///////////////////////////////////////////////////////////////////////////////////////
 struct MidiccDisplay : OpaqueWidget {
 	MidiccDisplay(){
-	font = APP->window->loadFont(mFONT_FILE);
+	font = pluginFont(mFONT_FILE);
 	}
 	MIDIpolyMPE *module;
+	DispFlash *flash = NULL;
 	float mdfontSize = 12.f;
-	std::string sDisplay = "";
+	DispText sDisplay;
 	int displayID = 0;
 	int ccNumber = -1;
 	int pbDwn = 222;
@@ -1240,101 +1685,99 @@ struct MidiccDisplay : OpaqueWidget {
 	bool learnOn = false;
 	int mymode = 0;
 	bool focusOn = false;
-	int flashFocus = 0;
+	bool newFocus = false;
+	bool waitCursor = false; // clicked, the snapshot has not caught up yet
 	bool canlearn = true;
 	bool canedit = true;
 	int polychanged = -1;
-	int lrncol = 0;
 	std::shared_ptr<Font> font;
-	void draw(const DrawArgs &args) override{
+	/// text, mode and focus from the snapshot (shared with MidiccGrid)
+	void update(const MIDIpolyMPE::DispState &d){
 			switch (displayID){
 				case 1:{
-					if (module->polyModeIx < MIDIpolyMPE::ROTATE_MODE) {
-						if ((ccNumber != module->displayYcc) || (polychanged != module->polyModeIx)) {
-							ccNumber = module->displayYcc;
+					if (d.polyModeIx < MIDIpolyMPE::ROTATE_MODE) {
+						if ((ccNumber != d.displayYcc) || (polychanged != d.polyModeIx)) {
+							ccNumber = d.displayYcc;
 							//mymode = 0;
-							polychanged = module->polyModeIx;
+							polychanged = d.polyModeIx;
 							displayedCC();
 						}
-						canedit = (module->polyModeIx == MIDIpolyMPE::MPE_MODE);
+						canedit = (d.polyModeIx == MIDIpolyMPE::MPE_MODE);
 					}else{
-						if ((driftcents != module->driftcents) || (polychanged != module->polyModeIx)) {
-							driftcents = module->driftcents;
-							polychanged = module->polyModeIx;
-							sDisplay = "+-" + std::to_string(module->driftcents) + "cnt";
+						if ((driftcents != d.driftcents) || (polychanged != d.polyModeIx)) {
+							driftcents = d.driftcents;
+							polychanged = d.polyModeIx;
+							sDisplay.set("+-").add(driftcents).add("cnt");
 						}
 						canedit = true;
 					}
 					canlearn = false;
 				}break;
 				case 2:{
-					if (ccNumber != module->displayZcc) {
-						ccNumber = module->displayZcc;
+					if (ccNumber != d.displayZcc) {
+						ccNumber = d.displayZcc;
 						//mymode = 0;
 						displayedCC();
 					}
-					canedit = (module->polyModeIx == MIDIpolyMPE::MPE_MODE);
+					canedit = (d.polyModeIx == MIDIpolyMPE::MPE_MODE);
 					canlearn = false;
 				}break;
 				case 3:{
-					switch (module->polyModeIx) {
+					switch (d.polyModeIx) {
 						case MIDIpolyMPE::MPE_MODE: {
-							if (module->mpePbOut) sDisplay = "chnPB";
-							else sDisplay = "relVel";
+							sDisplay.set((d.mpePbOut) ? "chnPB" : "relVel");
 							canedit = true;
 						}break;
 						case MIDIpolyMPE::MPEPLUS_MODE: {
-							sDisplay = "chnPB";
+							sDisplay.set("chnPB");
 							canedit = false;
 						}break;
 						default: {
-							sDisplay = "relVel";
+							sDisplay.set("relVel");
 							canedit = false;
 						}break;
 					}
 					canlearn = false;
 				}break;
 				case 4:{
-					if (trnsps != module->trnsps){
-						trnsps = module->trnsps;
-						if (trnsps > 0) sDisplay = "t+" + std::to_string(trnsps);
-						else if (trnsps < 0) sDisplay = "t" + std::to_string(trnsps);
-						else sDisplay = "t 0";
+					if (trnsps != d.trnsps){
+						trnsps = d.trnsps;
+						if (trnsps != 0) sDisplay.set("t").addSigned(trnsps);
+						else sDisplay.set("t 0");
 					}
 					canedit = true;
 					canlearn = false;
 				}break;
 				case 5:{
-					if (pbDwn != module->pbMainDwn){
-						pbDwn = module->pbMainDwn;
-						if (pbDwn > 0) sDisplay = "d+" + std::to_string(pbDwn);
-						else if (pbDwn < 0) sDisplay = "d" + std::to_string(pbDwn);
-						else sDisplay = "d 0";
+					if (pbDwn != d.pbMainDwn){
+						pbDwn = d.pbMainDwn;
+						if (pbDwn != 0) sDisplay.set("d").addSigned(pbDwn);
+						else sDisplay.set("d 0");
 					};
 					canlearn = false;
 				}break;
 				case 6:{
-					if (pbUp != module->pbMainUp){
-						pbUp = module->pbMainUp;
-						if (pbUp > 0) sDisplay = "u+" + std::to_string(pbUp);
-						else if (pbUp > 0) sDisplay = "u" + std::to_string(pbUp);
-						else sDisplay = "u 0";
+					if (pbUp != d.pbMainUp){
+						pbUp = d.pbMainUp;
+						if (pbUp != 0) sDisplay.set("u").addSigned(pbUp);
+						else sDisplay.set("u 0");
 					}
 					canlearn = false;
 				}break;
 				default:{
-					if (ccNumber !=  module->midiCCs[displayID - 7]) {
-						ccNumber =  module->midiCCs[displayID - 7];
+					if (ccNumber !=  d.midiCCs[displayID - 7]) {
+						ccNumber =  d.midiCCs[displayID - 7];
 						displayedCC();
 					}
 					canlearn = true;
-					if ((mymode==2) && (module->learnCC == 0)) {
+					if ((mymode==2) && (!waitCursor) && (d.learnCC == 0)) {
 						mymode = 0;
 						displayedCC();
 					}
 				}break;
 			}
-			if (focusOn && (displayID != (module->cursorIx - module->numPolycur))){
+			if (waitCursor && (displayID == (d.cursorIx - module->numPolycur))) waitCursor = false;
+			if (focusOn && (!waitCursor) && (displayID != (d.cursorIx - module->numPolycur))){
 				focusOn = false;
 				if (mymode == 2) {
 					displayedCC();
@@ -1342,6 +1785,10 @@ struct MidiccDisplay : OpaqueWidget {
 				}
 				mymode = 0;
 			}
+	}
+	/// cached in a framebuffer (module display generation and clicks), flashes on the overlay
+	void draw(const DrawArgs &args) override{
+			update(module->dispSnap.read());
 			nvgFontSize(args.vg, mdfontSize);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
@@ -1353,22 +1800,26 @@ struct MidiccDisplay : OpaqueWidget {
 				case 1:{
 					nvgBeginPath(args.vg);
 					nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y,3.f);
-					if (flashFocus > 0) flashFocus -= 2;
-					nvgFillColor(args.vg, nvgRGBA(0x64, 0x64, 0, 0xc0 + flashFocus)); //SELECTED
+					nvgFillColor(args.vg, nvgRGBA(0x64, 0x64, 0, 0xc0)); //SELECTED
 					nvgFill(args.vg);
 					nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
 					nvgFillColor(args.vg, nvgRGB(0xdd, 0xdd, 0));
 				}break;
 				case 2:{
-					if ((lrncol += 16) > 255) lrncol = 0;
 					nvgBeginPath(args.vg);
 					nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y,3.f);
-					nvgFillColor(args.vg, nvgRGBA(lrncol, 0, 0, 0xc0));
+					nvgFillColor(args.vg, nvgRGBA(0x64, 0, 0, 0xc0));
 					nvgFill(args.vg);
 					nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
 					nvgFillColor(args.vg, nvgRGB(0xdd , 0, 0));//LEARN
 				}break;
 			}
+			if (newFocus){
+				newFocus = false;
+				flash->focus(box.zeroPos(), 64, 2);
+			}
+			flash->learn(box.zeroPos(), mymode == 2);
+			if (mymode == 0) flash->fade = 0;
 		nvgTextBox(args.vg, 0.f, 10.f,box.size.x, sDisplay.c_str(), NULL);
 	}
 	void mymodeAction(){
@@ -1381,15 +1832,17 @@ struct MidiccDisplay : OpaqueWidget {
 			}break;
 			case 1:{
 				if (canlearn) displayedCC();
-				flashFocus = 64;
+				newFocus = true;
 				focusOn = true;
+				waitCursor = true;
 				module->learnCC = 0;
 				module->cursorIx = displayID + module->numPolycur;
 				module->autoFocusOff = 10 * APP->engine->getSampleRate();
 			}break;
 			case 2:{
-				sDisplay = "LRN";
+				sDisplay.set("LRN");
 				focusOn = true;
+				waitCursor = true;
 				module->cursorIx = displayID + module->numPolycur;
 				module->learnCC = displayID - 6;
 				module->autoFocusOff = 10 * APP->engine->getSampleRate();
@@ -1399,40 +1852,40 @@ struct MidiccDisplay : OpaqueWidget {
 	void displayedCC(){
 		switch (ccNumber) {
 			case 1 :{
-				sDisplay = "Mod";
+				sDisplay.set("Mod");
 			}break;
 			case 2 :{
-				sDisplay = "BrC";
+				sDisplay.set("BrC");
 			}break;
 			case 7 :{
-				sDisplay = "Vol";
+				sDisplay.set("Vol");
 			}break;
 			case 10 :{
-				sDisplay = "Pan";
+				sDisplay.set("Pan");
 			}break;
 			case 11 :{
-				sDisplay = "Expr";
+				sDisplay.set("Expr");
 			}break;
 			case 64 :{
-				sDisplay = "Sust";
+				sDisplay.set("Sust");
 			}break;
 			case 128 :{
-				sDisplay = "chAT";
+				sDisplay.set("chAT");
 			}break;
 			case 129 :{
-				sDisplay = "noteAT";
+				sDisplay.set("noteAT");
 			}break;
 			case 130 :{
-				sDisplay = "Dtn";
+				sDisplay.set("Dtn");
 			}break;
 			case 131 :{//HiRes MPE Y
-				sDisplay = "cc74+";
+				sDisplay.set("cc74+");
 			}break;
 			case 132 :{//HiRes MPE Z
-				sDisplay = "chAT+";
+				sDisplay.set("chAT+");
 			}break;
 			default :{
-				sDisplay = "cc" + std::to_string(ccNumber);
+				sDisplay.set("cc").add(ccNumber);
 			}
 		}
 	}
@@ -1453,11 +1906,338 @@ struct MidiccDisplay : OpaqueWidget {
 	}
 };
 ///////////////////////////////////////////////////////////////////////////////////////
+/// CC cells drawn as one grid: the cells keep their state and clicks, the grid draws
+/// one path per highlight class and the labels in a single font state (text grouped by color)
+struct MidiccGrid : Widget {
+	MidiccGrid(){
+	font = pluginFont(mFONT_FILE);
+	}
+	MIDIpolyMPE *module;
+	DispFlash *flash = NULL;
+	float mdfontSize = 12.f;
+	std::vector<MidiccDisplay *> cells;
+	std::shared_ptr<Font> font;
+	/// cell at pos in grid coordinates
+	MidiccDisplay *addCell(Vec pos, Vec size, int displayID){
+		MidiccDisplay *cell = createWidget<MidiccDisplay>(pos);
+		cell->box.size = size;
+		cell->displayID = displayID;
+		cell->module = module;
+		addChild(cell);
+		cells.push_back(cell);
+		return cell;
+	}
+	void fillMode(NVGcontext *vg, int mode, NVGcolor color){
+		bool any = false;
+		nvgBeginPath(vg);
+		for (MidiccDisplay *cell : cells) {
+			if (cell->mymode != mode) continue;
+			nvgRoundedRect(vg, cell->box.pos.x, cell->box.pos.y, cell->box.size.x, cell->box.size.y, 3.f);
+			any = true;
+		}
+		if (!any) return;
+		nvgFillColor(vg, color);
+		nvgFill(vg);
+	}
+	void textMode(NVGcontext *vg, int mode, bool canedit, NVGcolor color){
+		bool colorSet = false;
+		for (MidiccDisplay *cell : cells) {
+			if ((cell->mymode != mode) || ((mode == 0) && (cell->canedit != canedit))) continue;
+			if (!colorSet){
+				nvgFillColor(vg, color);
+				colorSet = true;
+			}
+			nvgTextBox(vg, cell->box.pos.x, cell->box.pos.y + 10.f, cell->box.size.x, cell->sDisplay.c_str(), NULL);
+		}
+	}
+	/// cached in a framebuffer (module display generation and clicks), one flash overlay for all cells
+	void draw(const DrawArgs &args) override{
+		const MIDIpolyMPE::DispState &d = module->dispSnap.read();
+		for (MidiccDisplay *cell : cells) cell->update(d);
+		fillMode(args.vg, 1, nvgRGBA(0x64, 0x64, 0, 0xc0)); //SELECTED
+		fillMode(args.vg, 2, nvgRGBA(0x64, 0, 0, 0xc0));
+		nvgFontSize(args.vg, mdfontSize);
+		nvgFontFaceId(args.vg, font->handle);
+		nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
+		textMode(args.vg, 0, true, nvgRGB(0xdd, 0xdd, 0xdd));
+		textMode(args.vg, 0, false, nvgRGB(0x99, 0x99, 0x99));
+		nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
+		textMode(args.vg, 1, true, nvgRGB(0xdd, 0xdd, 0));
+		textMode(args.vg, 2, true, nvgRGB(0xdd , 0, 0));//LEARN
+		MidiccDisplay *focused = NULL;
+		MidiccDisplay *learning = NULL;
+		for (MidiccDisplay *cell : cells) {
+			if (cell->newFocus){
+				cell->newFocus = false;
+				flash->focus(cell->box, 64, 2);
+			}
+			if (cell->mymode > 0) focused = cell;
+			if (cell->mymode == 2) learning = cell;
+		}
+		if (learning) flash->learn(learning->box, true);
+		else flash->learn(Rect(), false);
+		if (!focused) flash->fade = 0;
+	}
+};
+///////////////////////////////////////////////////////////////////////////////////////
+/// CC value traces over the grid cells, drawn every frame from the meter ring (not cached)
+struct MidiccMeters : TransparentWidget {
+	MIDIpolyMPE *module;
+	MidiccGrid *grid;
+	void draw(const DrawArgs &args) override {
+		const DispMeterRing<MIDIpolyMPE::numMeters> &ring = module->meterRing;
+		unsigned int now = ring.pushed();
+		if (now < 2) return;
+		int n = (now < ring.history) ? now : ring.history;
+		nvgBeginPath(args.vg);
+		for (int c = 0; c < static_cast<int>(grid->cells.size()) && (c < 8); c++){
+			Rect r = grid->cells[c]->box;
+			float step = (r.size.x - 4.f) / (ring.history - 1);
+			float bottom = r.pos.y + r.size.y - 1.5f;
+			float h = r.size.y - 3.f;
+			for (int i = 0; i < n; i++){
+				float x = r.pos.x + r.size.x - 2.f - i * step;
+				float y = bottom - ring.at(now - 1 - i)[c] * h;
+				if (i == 0) nvgMoveTo(args.vg, x, y);
+				else nvgLineTo(args.vg, x, y);
+			}
+		}
+		nvgStrokeWidth(args.vg, 1.f);
+		nvgStrokeColor(args.vg, nvgRGBA(0x00, 0xcc, 0x66, 0x80));
+		nvgStroke(args.vg);
+	}
+};
+///////////////////////////////////////////////////////////////////////////////////////
+/// MPE voice X Y Z bars (with history peak) behind the voice channels line, MPE modes only
+struct VoiceMeters : TransparentWidget {
+	MIDIpolyMPE *module;
+	void draw(const DrawArgs &args) override {
+		const MIDIpolyMPE::DispState &d = module->dispSnap.read();
+		if (d.polyModeIx > MIDIpolyMPE::MPEPLUS_MODE) return;
+		const DispMeterRing<MIDIpolyMPE::numMeters> &ring = module->meterRing;
+		unsigned int now = ring.pushed();
+		if (now < 1) return;
+		const float *m = ring.at(now - 1);
+		int voices = clamp(d.numVOch, 1, 16);
+		float col = box.size.x / voices;
+		float bw = std::min(3.f, (col - 2.f) / 3.f);
+		const NVGcolor colors[3] = {nvgRGB(0x50, 0x28, 0x00), nvgRGB(0x00, 0x40, 0x18), nvgRGB(0x18, 0x18, 0x50)};
+		nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
+		for (int k = 0; k < 3; k++){
+			nvgBeginPath(args.vg);
+			for (int v = 0; v < voices; v++){
+				float h = m[8 + v * 3 + k] * box.size.y;
+				nvgRect(args.vg, v * col + 1.f + k * bw, box.size.y - h, bw, h);
+			}
+			nvgFillColor(args.vg, colors[k]);
+			nvgFill(args.vg);
+		}
+		nvgBeginPath(args.vg);
+		for (int v = 0; v < voices; v++){
+			for (int k = 0; k < 3; k++){
+				float p = ring.peak(8 + v * 3 + k, now);
+				if (p > 0.f) nvgRect(args.vg, v * col + 1.f + k * bw, box.size.y - p * box.size.y, bw, 1.f);
+			}
+		}
+		nvgFillColor(args.vg, nvgRGB(0x40, 0x40, 0x40));
+		nvgFill(args.vg);
+	}
+};
+///////////////////////////////////////////////////////////////////////////////////////
+/// Voice allocation piano roll (context menu), one row per voice over the 128 notes:
+/// held / pedal / released note, MPE bend line, stacked MPE notes, steal flash, Y Z bars
+/// and the cached notes row. Live (not cached), the module only publishes while shown.
+struct VoiceMapDisplay : OpaqueWidget {
+	MIDIpolyMPE *module;
+	unsigned int seenSteals[16] = {0};
+	int stealFlash[16] = {0};
+	void show(bool on){
+		visible = on;
+		module->voiceMapOn = on;
+	}
+	void step() override {
+		if (visible) module->voiceMapSnap.update();
+		OpaqueWidget::step();
+	}
+	void draw(const DrawArgs &args) override {
+		const MIDIpolyMPE::VoiceMap &v = module->voiceMapSnap.read();
+		int voices = clamp(v.voices, 1, 16);
+		float rollW = box.size.x - 14.f;
+		float rowH = (box.size.y - 8.f) / voices;
+		float noteW = rollW / 128.f;
+		nvgBeginPath(args.vg);
+		nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y, 3.f);
+		nvgFillColor(args.vg, nvgRGBA(0, 0, 0, 0xe8));
+		nvgFill(args.vg);
+		/// octave grid (C)
+		nvgBeginPath(args.vg);
+		for (int c = 0; c < 128; c += 12) nvgRect(args.vg, 2.f + c * noteW, 0.f, 0.5f, box.size.y);
+		nvgFillColor(args.vg, nvgRGB(0x20, 0x20, 0x20));
+		nvgFill(args.vg);
+		for (int i = 0; i < voices; i++){
+			if (v.steals[i] != seenSteals[i]){
+				seenSteals[i] = v.steals[i];
+				stealFlash[i] = 30;
+			}
+		}
+		/// current voice row, steal flashes
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0.f, v.rotateIndex * rowH, 2.f, rowH - 1.f);
+		nvgFillColor(args.vg, nvgRGB(0xdd, 0xdd, 0x00));
+		nvgFill(args.vg);
+		nvgBeginPath(args.vg);
+		for (int i = 0; i < voices; i++){
+			if (stealFlash[i] < 1) continue;
+			stealFlash[i] --;
+			nvgRect(args.vg, 2.f, i * rowH, rollW, rowH - 1.f);
+		}
+		nvgFillColor(args.vg, nvgRGBA(0x80, 0x00, 0x00, 0x60));
+		nvgFill(args.vg);
+		/// notes by state: released, pedal, held
+		const NVGcolor noteColors[3] = {nvgRGB(0x44, 0x44, 0x44), nvgRGB(0xcc, 0x88, 0x00), nvgRGB(0x00, 0xdd, 0x66)};
+		for (int state = 0; state < 3; state++){
+			nvgBeginPath(args.vg);
+			for (int i = 0; i < voices; i++){
+				int noteState = v.gates[i] ? 2 : (v.pedalgates[i] ? 1 : 0);
+				if (noteState != state) continue;
+				nvgRect(args.vg, 2.f + v.notes[i] * noteW - 1.f, i * rowH, 3.f, rowH - 1.f);
+			}
+			nvgFillColor(args.vg, noteColors[state]);
+			nvgFill(args.vg);
+		}
+		/// MPE bend lines and stacked notes
+		if (v.polyModeIx <= MIDIpolyMPE::MPEPLUS_MODE){
+			nvgBeginPath(args.vg);
+			for (int i = 0; i < voices; i++){
+				if (!v.gates[i]) continue;
+				float x = 2.f + (v.notes[i] + 0.5f) * noteW;
+				float y = (i + 0.5f) * rowH;
+				nvgMoveTo(args.vg, x, y);
+				nvgLineTo(args.vg, clamp(x + v.bend[i] * noteW, 2.f, 2.f + rollW), y);
+			}
+			nvgStrokeWidth(args.vg, 1.f);
+			nvgStrokeColor(args.vg, nvgRGB(0x00, 0xaa, 0xff));
+			nvgStroke(args.vg);
+			nvgBeginPath(args.vg);
+			for (int i = 0; i < voices; i++){
+				for (int j = 0; j < v.numStacked[i]; j++)
+					nvgRect(args.vg, 2.f + v.stacked[i][j] * noteW - 0.5f, i * rowH + 1.f, 1.f, rowH - 3.f);
+			}
+			nvgFillColor(args.vg, nvgRGB(0x88, 0x44, 0xaa));
+			nvgFill(args.vg);
+		}
+		/// Y Z bars
+		nvgBeginPath(args.vg);
+		for (int i = 0; i < voices; i++) nvgRect(args.vg, rollW + 5.f, (i + 1) * rowH - 1.f - v.y[i] * (rowH - 1.f), 3.f, v.y[i] * (rowH - 1.f));
+		nvgFillColor(args.vg, nvgRGB(0x00, 0x80, 0x30));
+		nvgFill(args.vg);
+		nvgBeginPath(args.vg);
+		for (int i = 0; i < voices; i++) nvgRect(args.vg, rollW + 9.f, (i + 1) * rowH - 1.f - v.z[i] * (rowH - 1.f), 3.f, v.z[i] * (rowH - 1.f));
+		nvgFillColor(args.vg, nvgRGB(0x30, 0x30, 0xa0));
+		nvgFill(args.vg);
+		/// cached notes (poly modes)
+		nvgBeginPath(args.vg);
+		for (int j = 0; j < v.numCached; j++) nvgRect(args.vg, 2.f + v.cached[j] * noteW - 0.5f, box.size.y - 6.f, 1.f, 5.f);
+		nvgFillColor(args.vg, nvgRGB(0x88, 0x44, 0xaa));
+		nvgFill(args.vg);
+	}
+	/// click closes the panel
+	void onButton(const event::Button &e) override {
+		if ((e.button == GLFW_MOUSE_BUTTON_LEFT) && (e.action == GLFW_PRESS)){
+			show(false);
+			e.consume(this);
+		}
+	}
+};
+///////////////////////////////////////////////////////////////////////////////////////
+struct VoiceMapItem : MenuItem {
+	VoiceMapDisplay *voiceMap;
+	void onAction(const event::Action &e) override {
+		voiceMap->show(!voiceMap->visible);
+	}
+};
+
+struct StealModeItem : MenuItem {
+	MIDIpolyMPE *module;
+	int mode;
+	void onAction(const event::Action &e) override {
+		module->voiceAlloc.policy.mode = mode;
+	}
+};
+
+struct MPEzoneValueItem : MenuItem {
+	MIDIpolyMPE *module;
+	bool upper;
+	int members;
+	void onAction(const event::Action &e) override {
+		module->setMPEzone(upper, members);
+		module->resetMidi = true;
+	}
+};
+
+struct MPEzoneItem : MenuItem {
+	MIDIpolyMPE *module;
+	bool upper;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		int current = upper ? module->mpeUpper : module->mpeLower;
+		for (int i = 0; i < 16; i++){
+			std::string name = (i > 0) ? std::to_string(i) + " member channels" : "off";
+			MPEzoneValueItem *valueItem = createMenuItem<MPEzoneValueItem>(name, CHECKMARK(current == i));
+			valueItem->module = module;
+			valueItem->upper = upper;
+			valueItem->members = i;
+			menu->addChild(valueItem);
+		}
+		return menu;
+	}
+};
+
+struct DynMPEItem : MenuItem {
+	MIDIpolyMPE *module;
+	void onAction(const event::Action &e) override {
+		module->dynMPE = !module->dynMPE;
+		module->resetMidi = true;
+	}
+};
+
+struct PolyYItem : MenuItem {
+	MIDIpolyMPE *module;
+	void onAction(const event::Action &e) override {
+		module->polyY = !module->polyY;
+	}
+};
+
+struct PolyZItem : MenuItem {
+	MIDIpolyMPE *module;
+	void onAction(const event::Action &e) override {
+		module->polyZ = !module->polyZ;
+	}
+};
+
+struct VoiceBanksItem : MenuItem {
+	MIDIpolyMPE *module;
+	int banks;
+	void onAction(const event::Action &e) override {
+		module->voiceBanksSet = banks;
+		module->resetMidi = true;
+	}
+};
+
+struct KeepNoteItem : MenuItem {
+	MIDIpolyMPE *module;
+	bool highest;
+	void onAction(const event::Action &e) override {
+		if (highest) module->voiceAlloc.policy.keepHighest = !module->voiceAlloc.policy.keepHighest;
+		else module->voiceAlloc.policy.keepLowest = !module->voiceAlloc.policy.keepLowest;
+	}
+};
+///////////////////////////////////////////////////////////////////////////////////////
 struct springDataKnobB : SvgKnob {
 	springDataKnobB() {
 		minAngle = -0.75*M_PI;
 		maxAngle = 0.75*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dataKnobB.svg")));
+		setSvg(pluginSvg("res/dataKnobB.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -1471,9 +2251,26 @@ struct springDataKnobB : SvgKnob {
 /////// MODULE WIDGET ////////
 //////////////////////////////
 struct MIDIpolyMPEWidget : ModuleWidget {
+	/// display generation taken from the module snapshot (framebuffers compare it)
+	unsigned int dispGen = 0;
+	VoiceMapDisplay *voiceMap = NULL;
+	void step() override {
+		MIDIpolyMPE *module = dynamic_cast<MIDIpolyMPE*>(this->module);
+		if (module) delete module->umpDone.exchange(NULL);
+		if (module && module->dispSnap.update()) dispGen = module->dispSnap.read().gen;
+		ModuleWidget::step();
+	}
+	/// display in its framebuffer (module display generation) with the flash overlay on top
+	template <class TDisplay>
+	void addCachedDisplay(TDisplay *display){
+		DispFlash *flash = dispFlashOver(display);
+		display->flash = flash;
+		addChild(dispCache(display, &dispGen));
+		addChild(flash);
+	}
 	MIDIpolyMPEWidget(MIDIpolyMPE *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance,"res/MIDIpolyMPE.svg")));
+		setPanel(pluginSvg("res/MIDIpolyMPE.svg"));
 		//Screws
 		addChild(createWidget<ScrewBlack>(Vec(0, 0)));
 		addChild(createWidget<ScrewBlack>(Vec(135, 0)));
@@ -1487,7 +2284,7 @@ struct MIDIpolyMPEWidget : ModuleWidget {
 			//MIDI
 			MIDIscreen *dDisplay = createWidget<MIDIscreen>(Vec(xPos,yPos));
 			dDisplay->box.size = {136.f, 40.f};
-			dDisplay->setMidiPort (&module->midiInput, &module->MPEmode, &module->MPEmasterCh, &module->midiActivity, &module->mdriverJx, &module->mdeviceJx, &module->mchannelJx, &module->resetMidi);
+			dDisplay->setMidiPort (&module->midiInput, &module->MPEmode, &module->MPEmasterCh, &module->midiActivity, &module->mdriverJx, &module->mdeviceJx, &module->mchannelJx, &module->resetMidi, &module->midiLoadGen);
 			addChild(dDisplay);
 			//PolyModes LCD
 			xPos = 7.f;
@@ -1495,7 +2292,11 @@ struct MIDIpolyMPEWidget : ModuleWidget {
 			PolyModeDisplay *polyModeDisplay = createWidget<PolyModeDisplay>(Vec(xPos,yPos));
 			polyModeDisplay->box.size = {136.f, 40.f};
 			polyModeDisplay->module = module;
-			addChild(polyModeDisplay);
+			addCachedDisplay(polyModeDisplay);
+			VoiceMeters *voiceMeters = createWidget<VoiceMeters>(Vec(xPos + 1.f, yPos + 14.f));
+			voiceMeters->box.size = {134.f, 12.f};
+			voiceMeters->module = module;
+			addChild(voiceMeters);
 			//  Y Z LCDs
 			xPos = 55.f;
 			yPos = 156.f;
@@ -1504,7 +2305,7 @@ struct MIDIpolyMPEWidget : ModuleWidget {
 				MccDisplay->box.size = {40.f, 13.f};
 				MccDisplay->displayID =  dispID ++;;
 				MccDisplay->module = (module ? module : NULL);
-				addChild(MccDisplay);
+				addCachedDisplay(MccDisplay);
 				xPos += 44.f;
 			}
 			// RelVel / chPbend LCD
@@ -1514,7 +2315,7 @@ struct MIDIpolyMPEWidget : ModuleWidget {
 			rvelDisplay->box.size = {34.f, 13.f};
 			rvelDisplay->displayID =  dispID ++;;
 			rvelDisplay->module = module;
-			addChild(rvelDisplay);
+			addCachedDisplay(rvelDisplay);
 			// trnsp Pitch Bend LCD
 			xPos = 10.5f;
 			yPos = 256.5f;
@@ -1523,7 +2324,7 @@ struct MIDIpolyMPEWidget : ModuleWidget {
 				MccDisplay->box.size = {25.f, 13.f};
 				MccDisplay->displayID =  dispID ++;;
 				MccDisplay->module = module;
-				addChild(MccDisplay);
+				addCachedDisplay(MccDisplay);
 				xPos += 28.f - static_cast<float>(i * 3);
 			}
 		}
@@ -1572,21 +2373,104 @@ struct MIDIpolyMPEWidget : ModuleWidget {
 		addOutput(createOutput<moDllzPortG>(Vec(xPos, yPos),  module, MIDIpolyMPE::PBEND_OUTPUT));
 		// CC's x 8
 		yPos = 283.f;
+		if (module){
+			MidiccGrid *MccGrid = createWidget<MidiccGrid>(Vec(10.5f, yPos));
+			MccGrid->box.size = {4 * 33.f - 3.f, 40.f + 13.f};
+			MccGrid->module = module;
+			for ( int r = 0; r < 2; r++){
+				for ( int i = 0; i < 4; i++) MccGrid->addCell(Vec(i * 33.f, r * 40.f), Vec(30.f, 13.f), dispID ++);
+			}
+			MidiccMeters *MccMeters = createWidget<MidiccMeters>(MccGrid->box.pos);
+			MccMeters->box.size = MccGrid->box.size;
+			MccMeters->module = module;
+			MccMeters->grid = MccGrid;
+			addCachedDisplay(MccGrid);
+			addChild(MccMeters);
+		}
 		for ( int r = 0; r < 2; r++){
 			xPos = 10.5f;
 			for ( int i = 0; i < 4; i++){
-				if (module){
-					MidiccDisplay *MccDisplay = createWidget<MidiccDisplay>(Vec(xPos,yPos));
-					MccDisplay->box.size = {30.f, 13.f};
-					MccDisplay->displayID = dispID ++;
-					MccDisplay->module = module;
-					addChild(MccDisplay);
-				}
 				addOutput(createOutput<moDllzPortG>(Vec(xPos + 3.5f, yPos + 13.f),  module, MIDIpolyMPE::MM_OUTPUT + i + r * 4));
 				xPos += 33.f;
 			}
 			yPos += 40.f;
 		}
+		if (module){
+			voiceMap = createWidget<VoiceMapDisplay>(Vec(5.f, 148.f));
+			voiceMap->box.size = {140.f, 128.f};
+			voiceMap->module = module;
+			voiceMap->visible = false;
+			addChild(voiceMap);
+		}
+	}
+	void appendContextMenu(Menu *menu) override {
+		MIDIpolyMPE *module = dynamic_cast<MIDIpolyMPE*>(this->module);
+		menu->addChild(new MenuEntry);
+		ReproDriftItem<MIDIpolyMPE> *reproDriftItem = createMenuItem<ReproDriftItem<MIDIpolyMPE>>("Reproducible drift", CHECKMARK(module->reproDrift));
+		reproDriftItem->module = module;
+		menu->addChild(reproDriftItem);
+		DriftSeedItem<MIDIpolyMPE> *driftSeedItem = createMenuItem<DriftSeedItem<MIDIpolyMPE>>("Drift seed: " + std::to_string(module->driftSeed), RIGHT_ARROW);
+		driftSeedItem->module = module;
+		menu->addChild(driftSeedItem);
+		menu->addChild(createVelocityCurveItem(&module->velCurve));
+		if (voiceMap){
+			VoiceMapItem *voiceMapItem = createMenuItem<VoiceMapItem>("Voice map", CHECKMARK(voiceMap->visible));
+			voiceMapItem->voiceMap = voiceMap;
+			menu->addChild(voiceMapItem);
+		}
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("MPE zones (MCM sets them too)"));
+		MPEzoneItem *lowerItem = createMenuItem<MPEzoneItem>("Lower zone (master ch 1)", RIGHT_ARROW);
+		lowerItem->module = module;
+		lowerItem->upper = false;
+		menu->addChild(lowerItem);
+		MPEzoneItem *upperItem = createMenuItem<MPEzoneItem>("Upper zone (master ch 16)", RIGHT_ARROW);
+		upperItem->module = module;
+		upperItem->upper = true;
+		menu->addChild(upperItem);
+		DynMPEItem *dynMPEItem = createMenuItem<DynMPEItem>("Dynamic voices (outputs follow the notes)", CHECKMARK(module->dynMPE));
+		dynMPEItem->module = module;
+		menu->addChild(dynMPEItem);
+		UMPfileItem *umpFileItem = createMenuItem<UMPfileItem>("Play UMP file (MIDI 2.0 test input)...");
+		umpFileItem->pending = &module->umpLoad;
+		umpFileItem->done = &module->umpDone;
+		menu->addChild(umpFileItem);
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Smoothing"));
+		menu->addChild(createSmoothItem("MPE bend", &module->smoothX));
+		menu->addChild(createSmoothItem("MPE Y Z", &module->smoothYZ));
+		menu->addChild(createSmoothItem("CCs and bend", &module->smoothCC));
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Poly modes"));
+		PolyYItem *polyYItem = createMenuItem<PolyYItem>("Y out: per note controller (MPE Y cc)", CHECKMARK(module->polyY));
+		polyYItem->module = module;
+		menu->addChild(polyYItem);
+		PolyZItem *polyZItem = createMenuItem<PolyZItem>("Z out: per note controller (MPE Z cc)", CHECKMARK(module->polyZ));
+		polyZItem->module = module;
+		menu->addChild(polyZItem);
+		const std::string bankNames[MIDIpolyMPE::maxBanks] = {"16 voices", "32 voices (spill expander)", "48 voices (spill expander)"};
+		for (int i = 0; i < MIDIpolyMPE::maxBanks; i++){
+			VoiceBanksItem *voiceBanksItem = createMenuItem<VoiceBanksItem>(bankNames[i], CHECKMARK(module->voiceBanksSet == i + 1));
+			voiceBanksItem->module = module;
+			voiceBanksItem->banks = i + 1;
+			menu->addChild(voiceBanksItem);
+		}
+		menu->addChild(createMenuLabel("Voice stealing (poly modes)"));
+		const std::string stealNames[StealPriority::NUM_MODES] = {"Rotate", "Oldest note", "Quietest note", "Released (sustained) first"};
+		for (int i = 0; i < StealPriority::NUM_MODES; i++){
+			StealModeItem *stealModeItem = createMenuItem<StealModeItem>(stealNames[i], CHECKMARK(module->voiceAlloc.policy.mode == i));
+			stealModeItem->module = module;
+			stealModeItem->mode = i;
+			menu->addChild(stealModeItem);
+		}
+		KeepNoteItem *keepLowestItem = createMenuItem<KeepNoteItem>("Protect lowest note", CHECKMARK(module->voiceAlloc.policy.keepLowest));
+		keepLowestItem->module = module;
+		keepLowestItem->highest = false;
+		menu->addChild(keepLowestItem);
+		KeepNoteItem *keepHighestItem = createMenuItem<KeepNoteItem>("Protect highest note", CHECKMARK(module->voiceAlloc.policy.keepHighest));
+		keepHighestItem->module = module;
+		keepHighestItem->highest = true;
+		menu->addChild(keepHighestItem);
 	}
 };
 
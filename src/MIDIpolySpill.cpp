@@ -0,0 +1,100 @@
+/*
+MIDIpolySpill: voices 17 ~ 48 of MIDIpolyMPE (expander)
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+#include "moDllz.hpp"
+
+/// Placed right of MIDIpolyMPE, outputs its second and third 16 voice groups.
+/// MIDIpolyMPE writes the producer message, the expander reads the flipped one.
+struct MIDIpolySpill : Module {
+	enum ParamIds {
+		NUM_PARAMS
+	};
+	enum InputIds {
+		NUM_INPUTS
+	};
+	enum OutputIds {
+		ENUMS(GROUP2_OUTPUT, VoiceSpill::NUM_OUTS),
+		ENUMS(GROUP3_OUTPUT, VoiceSpill::NUM_OUTS),
+		NUM_OUTPUTS
+	};
+	enum LightIds {
+		NUM_LIGHTS
+	};
+
+	VoiceSpill messages[2] = {};
+
+	MIDIpolySpill() {
+		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		leftExpander.producerMessage = &messages[0];
+		leftExpander.consumerMessage = &messages[1];
+	}
+
+	void process(const ProcessArgs &args) override {
+		bool linked = leftExpander.module && (leftExpander.module->model == modelMIDIpolyMPE);
+		const VoiceSpill *spill = static_cast<VoiceSpill *>(leftExpander.consumerMessage);
+		for (int g = 0; g < VoiceSpill::groups; g++){
+			int channels = linked ? clamp(spill->channels[g], 0, 16) : 0;
+			for (int o = 0; o < VoiceSpill::NUM_OUTS; o++){
+				Output &output = outputs[GROUP2_OUTPUT + g * VoiceSpill::NUM_OUTS + o];
+				output.setChannels(std::max(channels, 1));
+				if (channels == 0) output.voltages[0] = 0.f;
+				for (int c = 0; c < channels; c++)
+					output.voltages[c] = spill->voltages[g][o][c];
+			}
+		}
+	}
+};
+
+struct SpillLabels : TransparentWidget {
+	SpillLabels(){
+		font = pluginFont(mFONT_FILE);
+	}
+	std::shared_ptr<Font> font;
+	void draw(const DrawArgs &args) override {
+		const char *outNames[VoiceSpill::NUM_OUTS] = {"X", "Y", "Z", "vel", "rvel", "gate"};
+		nvgFontSize(args.vg, 10.f);
+		nvgFontFaceId(args.vg, font->handle);
+		nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
+		nvgFillColor(args.vg, nvgRGB(0xee, 0xee, 0xee));
+		nvgText(args.vg, 16.f, 30.f, "17~32", NULL);
+		nvgText(args.vg, 44.f, 30.f, "33~48", NULL);
+		for (int o = 0; o < VoiceSpill::NUM_OUTS; o++)
+			nvgText(args.vg, 30.f, 50.f + o * 50.f, outNames[o], NULL);
+	}
+};
+
+struct MIDIpolySpillWidget : ModuleWidget {
+	MIDIpolySpillWidget(MIDIpolySpill *module) {
+		setModule(module);
+		setPanel(pluginSvg("res/MIDIpolySpill.svg"));
+		//Screws
+		addChild(createWidget<ScrewBlack>(Vec(0, 0)));
+		addChild(createWidget<ScrewBlack>(Vec(box.size.x - 15, 365)));
+		{
+			SpillLabels *labels = createWidget<SpillLabels>(Vec(0, 0));
+			labels->box.size = box.size;
+			addChild(labels);
+		}
+		for (int o = 0; o < VoiceSpill::NUM_OUTS; o++){
+			float yPos = 54.f + o * 50.f;
+			addOutput(createOutput<moDllzPortPoly>(Vec(4.f, yPos), module, MIDIpolySpill::GROUP2_OUTPUT + o));
+			addOutput(createOutput<moDllzPortPoly>(Vec(32.f, yPos), module, MIDIpolySpill::GROUP3_OUTPUT + o));
+		}
+	}
+};
+
+Model *modelMIDIpolySpill = createModel<MIDIpolySpill, MIDIpolySpillWidget>("MIDIpolySpill");
@@ -277,7 +277,7 @@ struct TwinGliderWidget : ModuleWidget {
 	
 	TwinGliderWidget(TwinGlider *module){
 		setModule(module);
-	setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/TwinGlider.svg")));
+	setPanel(pluginSvg("res/TwinGlider.svg"));
 	//Screws
 	addChild(createWidget<ScrewBlack>(Vec(0, 0)));
 	addChild(createWidget<ScrewBlack>(Vec(box.size.x - 15, 0)));
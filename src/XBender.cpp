@@ -96,6 +96,19 @@ struct XBender : Module {
 	
 	dsp::SlewLimiter slewlimiter;
 	
+	/// what the displays show, published every dispDivider block
+	struct DispState {
+		float dZoom = 1.f;
+		float dCenter = 0.5f;
+		float selectedAxisF = 0.f;
+		float finalAxis = 0.f;
+		float axisXfade = 0.f;
+		int axisTransParam = 0;
+		ioXBended ioxbended[8];
+	};
+	DispSnapshot<DispState> dispSnap;
+	dsp::ClockDivider dispDivider;
+	
 	XBender() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(YCENTER_PARAM, -120.f, 120.f, 0.f);
@@ -115,8 +128,20 @@ struct XBender : Module {
 		configParam(XBENDRANGE_PARAM, 1.f, 5.f, 1.f);
 		configParam(BEND_PARAM, -1.f, 1.f, 0.f);
 		configParam(BENDCVTRIM_PARAM, 0.f, 60.f, 12.f);
+		dispDivider.setDivision(256);
 	}
 	void process(const ProcessArgs &args) override;
+	void publishDisplay(){
+		DispState &d = dispSnap.write();
+		d.dZoom = dZoom;
+		d.dCenter = dCenter;
+		d.selectedAxisF = selectedAxisF;
+		d.finalAxis = finalAxis;
+		d.axisXfade = axisXfade;
+		d.axisTransParam = axisTransParam;
+		for (int i = 0; i < 8; i++) d.ioxbended[i] = ioxbended[i];
+		dispSnap.publish();
+	}
 	void onReset() override {
 		for (int ix = 0; ix < 8 ; ix++){
 		outputs[OUT_OUTPUT + ix].setVoltage(inputs[IN_INPUT + ix].getVoltage());
@@ -142,6 +167,7 @@ struct XBender : Module {
 /////////////////////////////////////////////
 
 void XBender::process(const ProcessArgs &args) {
+	if (dispDivider.process()) publishDisplay();
 	
 	if(inputs[AXISSELECT_INPUT].isConnected()) {
 		if (params[SNAPAXIS_PARAM].getValue() > 0.5f){
@@ -256,13 +282,14 @@ struct BenderDisplay : TransparentWidget {
 	void draw(const DrawArgs &args) override
 	{
 		if (module) {
+			const XBender::DispState &d = module->dispSnap.read();
 			const float dispHeight = 228.f;
 			const float dispCenter = dispHeight / 2.f;
-			float yZoom = module->dZoom;
-			float yCenter = module->dCenter * yZoom + dispCenter;
-			float AxisIx = module->selectedAxisF;
-			float Axis = module->finalAxis;
-			float AxisXfade = module->axisXfade;
+			float yZoom = d.dZoom;
+			float yCenter = d.dCenter * yZoom + dispCenter;
+			float AxisIx = d.selectedAxisF;
+			float Axis = d.finalAxis;
+			float AxisXfade = d.axisXfade;
 			float keyw = 10.f * yZoom /12.f;
 			nvgScissor(args.vg, 0.f, 0.f, 152.f, dispHeight);// crop drawing to display
 			///// BACKGROUND
@@ -346,10 +373,10 @@ struct BenderDisplay : TransparentWidget {
 			const float yfirst = 10.5f;
 			const float ystep = 26.f;
 			for (int i = 0; i < 8 ; i++){
-				if (module->ioxbended[i].iactive) {
+				if (d.ioxbended[i].iactive) {
 				float yport = yfirst + i * ystep;
-					float yi =  yZoom * module->ioxbended[i].inx * -10.f + yCenter ;
-					float yo =  yZoom * module->ioxbended[i].xout * -10.f + yCenter ;
+					float yi =  yZoom * d.ioxbended[i].inx * -10.f + yCenter ;
+					float yo =  yZoom * d.ioxbended[i].xout * -10.f + yCenter ;
 					nvgBeginPath(args.vg);
 					nvgStrokeWidth(args.vg,1.f);
 					nvgStrokeColor(args.vg,nvgRGBA(0xff, 0xff, 0xff,0x80));
@@ -396,15 +423,13 @@ struct BenderDisplay : TransparentWidget {
 			nvgStroke(args.vg);
 		}else{///PREVIEW
 			std::shared_ptr<Font> font;
-			std::string s1 = "8 Channel";
-			std::string s2 = "Axis X-fader";
-			font = APP->window->loadFont(mFONT_FILE);
+			font = pluginFont(mFONT_FILE);
 			nvgFontSize(args.vg, 24.f);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
 			nvgFillColor(args.vg, nvgRGB(0xDD,0xDD,0xDD));
-			nvgTextBox(args.vg, 0.f, 80.0f,box.size.x, s1.c_str(), NULL);
-			nvgTextBox(args.vg, 0.f, 112.0f,box.size.x, s2.c_str(), NULL);
+			nvgTextBox(args.vg, 0.f, 80.0f,box.size.x, "8 Channel", NULL);
+			nvgTextBox(args.vg, 0.f, 112.0f,box.size.x, "Axis X-fader", NULL);
 		}
 	}
 };
@@ -413,14 +438,18 @@ struct BenderDisplay : TransparentWidget {
 struct AxisTranspDisplay : TransparentWidget {
 	XBender *module;
 	std::shared_ptr<Font> font;
-	std::string s;
+	DispText s;
+	int q_AxisTrans = 1000;
 	float mdfontSize = 11.f;
 	AxisTranspDisplay(){
-		font = APP->window->loadFont(FONT_FILE);
+		font = pluginFont(FONT_FILE);
 	}
 	void draw(const DrawArgs &args) override {
-		int AxisTransP = module ? module->axisTransParam : 0;
-		s = std::to_string(AxisTransP);
+		int AxisTransP = module ? module->dispSnap.read().axisTransParam : 0;
+		if (q_AxisTrans != AxisTransP){
+			q_AxisTrans = AxisTransP;
+			s.clear().add(AxisTransP);
+		}
 		nvgFontSize(args.vg, mdfontSize);
 		nvgFontFaceId(args.vg, font->handle);
 		nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
@@ -440,7 +469,7 @@ struct xbendKnob : SvgKnob {
 	xbendKnob() {
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/xbendKnob.svg")));
+		setSvg(pluginSvg("res/xbendKnob.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -451,7 +480,7 @@ struct zTTrim : SvgKnob {
 	zTTrim() {
 		minAngle = 0;
 		maxAngle = 1.75*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/zTTrim.svg")));
+		setSvg(pluginSvg("res/zTTrim.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -463,7 +492,7 @@ struct cTTrim : SvgKnob {
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
 		snap = true;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/cTTrim.svg")));
+		setSvg(pluginSvg("res/cTTrim.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -472,8 +501,8 @@ struct cTTrim : SvgKnob {
 
 struct autoZoom : SvgSwitch {
 	autoZoom() {
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/autoButton.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/autoButton.svg")));
+		addFrame(pluginSvg("res/autoButton.svg"));
+		addFrame(pluginSvg("res/autoButton.svg"));
 	}
 	void randomize() override{
 	}
@@ -481,17 +510,22 @@ struct autoZoom : SvgSwitch {
 
 struct snapAxisButton : SvgSwitch {
   snapAxisButton() {
-	  addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/snapButton.svg")));
-	  addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/snapButton.svg")));
+	  addFrame(pluginSvg("res/snapButton.svg"));
+	  addFrame(pluginSvg("res/snapButton.svg"));
   }
 	void randomize() override{
 	}
 };
 
 struct XBenderWidget : ModuleWidget {
+	void step() override {
+		XBender *module = dynamic_cast<XBender*>(this->module);
+		if (module) module->dispSnap.update();
+		ModuleWidget::step();
+	}
 	XBenderWidget(XBender *module) {
 		setModule(module);
-		setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/XBender.svg")));
+		setPanel(pluginSvg("res/XBender.svg"));
 		float xPos;
 		float yPos;
 		float xyStep = 26.f ;
@@ -0,0 +1,148 @@
+/*
+arpDllz.hpp Arpeggiator note order tables
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// The step table is rebuilt only when the held notes (or order / octaves) change,
+/// every clock step is then a lookup. New modes add a case in build() and, if they
+/// need more per step data (ratchet, probability...), a field in ArpStep.
+struct ArpEngine {
+	enum ArpOrder {
+		PADS_ORDER,
+		UP_ORDER,
+		DOWN_ORDER,
+		UPDOWN_ORDER,
+		PLAYED_ORDER,
+		RANDOM_ORDER,
+		CHORD_ORDER,
+		NUM_ORDERS
+	};
+	static const int maxNotes = 16;
+	static const int maxOcts = 5;
+	static const int maxSteps = maxNotes * 2 * maxOcts;
+
+	struct ArpStep {
+		int pad = 0;
+		int oct = 0;
+		bool chord = false; // all held notes
+	};
+	ArpStep steps[maxSteps];
+	int numSteps = 0;
+	/// distinct pads of the table, in table order (random reshuffle)
+	int pads[maxNotes];
+	int numPads = 0;
+	int stepIx = -1;
+
+	/// signature of the current table
+	uint32_t noteSig = 0;
+	int order = -1;
+	int octRow = -1;
+	bool notesFirst = false;
+
+	bool needsBuild(uint32_t sig, int ord, int row, bool nFirst) const {
+		return (sig != noteSig) || (ord != order) || (row != octRow) || (nFirst != notesFirst);
+	}
+	/// held : pad mask, keys / stamps : per pad, octs : octave shifts ended by a value > 2
+	void build(uint32_t sig, uint32_t held, const int *keys, const int *stamps, int ord, const int *octs, int row, bool nFirst, DllzRandom &rng){
+		noteSig = sig;
+		order = ord;
+		octRow = row;
+		notesFirst = nFirst;
+		int notes[maxNotes * 2]; // up-down mirrors n - 2 notes
+		int n = 0;
+		for (int i = 0; i < maxNotes; i++){
+			if (held & (1u << i)) notes[n++] = i;
+		}
+		numSteps = 0;
+		numPads = 0;
+		if (n == 0) {
+			stepIx = -1;
+			return;
+		}
+		switch (ord){
+			case UP_ORDER:
+			case UPDOWN_ORDER:
+			case CHORD_ORDER:{
+				std::sort(notes, notes + n, [keys](int a, int b){ return keys[a] < keys[b]; });
+			}break;
+			case DOWN_ORDER:{
+				std::sort(notes, notes + n, [keys](int a, int b){ return keys[a] > keys[b]; });
+			}break;
+			case PLAYED_ORDER:{
+				std::sort(notes, notes + n, [stamps](int a, int b){ return stamps[a] < stamps[b]; });
+			}break;
+			case RANDOM_ORDER:{
+				shuffle(notes, n, rng);
+				for (int i = 0; i < n; i++) pads[i] = notes[i];
+				numPads = n;
+			}break;
+			default: break; // PADS_ORDER
+		}
+		if (ord == UPDOWN_ORDER){ // up then down without repeating the ends
+			for (int i = n - 2; i > 0; i--) notes[n++] = notes[i];
+		}
+		int numOcts = 0;
+		while ((numOcts < maxOcts) && (octs[numOcts] <= 2)) numOcts++;
+		if (ord == CHORD_ORDER){
+			for (int o = 0; o < numOcts; o++) addStep(notes[0], octs[o], true);
+		}else if (nFirst){
+			for (int o = 0; o < numOcts; o++)
+				for (int i = 0; i < n; i++) addStep(notes[i], octs[o], false);
+		}else{
+			for (int i = 0; i < n; i++)
+				for (int o = 0; o < numOcts; o++) addStep(notes[i], octs[o], false);
+		}
+		if (stepIx >= numSteps) stepIx = -1;
+	}
+	const ArpStep &next(DllzRandom &rng){
+		if (++stepIx >= numSteps){
+			stepIx = 0;
+			if (order == RANDOM_ORDER) reshuffle(rng);
+		}
+		return steps[stepIx];
+	}
+	void restart(){
+		stepIx = -1;
+	}
+	bool empty() const {
+		return numSteps < 1;
+	}
+private:
+	void addStep(int pad, int oct, bool chord){
+		steps[numSteps].pad = pad;
+		steps[numSteps].oct = oct;
+		steps[numSteps].chord = chord;
+		numSteps++;
+	}
+	static void shuffle(int *v, int n, DllzRandom &rng){
+		for (int i = n - 1; i > 0; i--){
+			int j = static_cast<int>(rng.u32() % static_cast<uint32_t>(i + 1));
+			std::swap(v[i], v[j]);
+		}
+	}
+	/// new random order for the next cycle, only the pads move so the octave layout stays
+	void reshuffle(DllzRandom &rng){
+		if (numPads < 2) return;
+		int ix[maxNotes] = {};
+		for (int i = 0; i < numPads; i++) ix[pads[i]] = i;
+		int mixed[maxNotes];
+		for (int i = 0; i < numPads; i++) mixed[i] = pads[i];
+		shuffle(mixed, numPads, rng);
+		for (int i = 0; i < numSteps; i++) steps[i].pad = mixed[ix[steps[i].pad]];
+		for (int i = 0; i < numPads; i++) pads[i] = mixed[i];
+	}
+};
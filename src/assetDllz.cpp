@@ -0,0 +1,64 @@
+/*
+assetDllz.cpp Shared svg / font cache
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+#include "moDllz.hpp"
+
+struct DllzAssets {
+	std::map<std::string, std::shared_ptr<Svg>> svgs;	// written once by the thread, then read only
+	std::atomic<bool> ready;
+	std::thread thread;
+	std::map<std::string, std::shared_ptr<Font>> fonts;	// ui thread
+	
+	DllzAssets() : ready(false) {
+	}
+	~DllzAssets(){
+		if (thread.joinable()) thread.join();
+	}
+	void preload(){
+		std::map<std::string, std::shared_ptr<Svg>> parsed;
+		for (const std::string &path : system::getEntries(asset::plugin(pluginInstance, "res"))) {
+			if (!string::endsWith(path, ".svg")) continue;
+			std::shared_ptr<Svg> svg = std::make_shared<Svg>();
+			svg->loadFile(path);
+			if (svg->handle) parsed["res/" + string::filename(path)] = svg;
+		}
+		svgs.swap(parsed);
+		ready.store(true, std::memory_order_release);
+	}
+};
+static DllzAssets dllzAssets;
+///////////////////////////////////////////////////////////////////////////////////////
+void assetPreload(){
+	if (settings::headless || dllzAssets.thread.joinable()) return;
+	dllzAssets.thread = std::thread(&DllzAssets::preload, &dllzAssets);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<Svg> pluginSvg(const std::string &file){
+	if (dllzAssets.ready.load(std::memory_order_acquire)){
+		auto it = dllzAssets.svgs.find(file);
+		if (it != dllzAssets.svgs.end()) return it->second;
+	}
+	return APP->window->loadSvg(asset::plugin(pluginInstance, file));
+}
+///////////////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<Font> pluginFont(const std::string &file){
+	std::shared_ptr<Font> &font = dllzAssets.fonts[file];
+	if (!font) font = APP->window->loadFont(asset::plugin(pluginInstance, file));
+	return font;
+}
@@ -0,0 +1,28 @@
+/*
+assetDllz.hpp Shared svg / font cache
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+using namespace rack;
+
+/// Plugin asset cache, res paths relative to the plugin ("res/x.svg").
+/// assetPreload() (plugin init) parses every res/*.svg once on a background thread and keeps
+/// them for the whole session, Window caches only while a widget holds them.
+/// pluginSvg() hands a preloaded Svg over as is and falls back to Window::loadSvg while
+/// the thread is still busy. Fonts need the NanoVG context, pluginFont() keeps them on the UI thread.
+void assetPreload();
+std::shared_ptr<Svg> pluginSvg(const std::string &file);
+std::shared_ptr<Font> pluginFont(const std::string &file);
@@ -0,0 +1,194 @@
+/*
+dispDllz.hpp Cached displays
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+using namespace rack;
+
+/// Module side display generation.
+/// The engine folds the values a display shows into a key (begin/add/end, once per block)
+/// and gen only moves when the key does. Gens travel to the UI inside the DispSnapshot,
+/// a static panel costs one compare per frame.
+struct DispGen {
+	unsigned int gen = 1;
+	uint32_t key = 0;
+	uint32_t acc = 0;
+
+	void begin(){
+		acc = 2166136261u;
+	}
+	void add(int value){
+		acc = (acc ^ static_cast<uint32_t>(value)) * 16777619u;
+	}
+	/// true if the generation moved
+	bool end(){
+		if (acc == key) return false;
+		key = acc;
+		gen++;
+		return true;
+	}
+};
+
+/// Engine -> UI display snapshot, triple buffer with one writer and one reader (no locks).
+/// The engine fills all of write() and publish() hands it over once per block,
+/// the module widget calls update() once per frame and displays draw from read(),
+/// so the UI thread never reads the live DSP fields.
+template <class T>
+struct DispSnapshot {
+	static const int freshBit = 4;
+	T buffers[3];
+	std::atomic<int> middle;
+	int back = 0;	// engine side
+	int front = 2;	// ui side
+
+	DispSnapshot() : middle(1) {
+	}
+	T &write(){
+		return buffers[back];
+	}
+	void publish(){
+		back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & 3;
+	}
+	/// true if a new snapshot was taken
+	bool update(){
+		if (!(middle.load(std::memory_order_acquire) & freshBit)) return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+		return true;
+	}
+	const T &read() const {
+		return buffers[front];
+	}
+};
+
+/// Engine -> UI meter history: one frame of channels (0 ~ 1) per push, the module decimates
+/// the pushes to about one per UI frame. One writer / one reader ring without locks, readers
+/// look at the newest history frames only so the writer stays length - history frames away.
+template <int channels, int length = 32>
+struct DispMeterRing {
+	static const int history = 24;
+	float frames[length][channels] = {};
+	std::atomic<unsigned int> count;
+
+	DispMeterRing() : count(0) {
+	}
+	/// engine side: fill write() then push()
+	float *write(){
+		return frames[count.load(std::memory_order_relaxed) % length];
+	}
+	void push(){
+		count.fetch_add(1, std::memory_order_release);
+	}
+	/// ui side: frames pushed so far, at(pushed - 1) is the newest
+	unsigned int pushed() const {
+		return count.load(std::memory_order_acquire);
+	}
+	const float *at(unsigned int n) const {
+		return frames[n % length];
+	}
+	/// highest value of channel in the history
+	float peak(int channel, unsigned int now) const {
+		unsigned int n = (now < history) ? now : history;
+		float p = 0.f;
+		for (unsigned int i = 1; i <= n; i++) p = std::max(p, at(now - i)[channel]);
+		return p;
+	}
+};
+
+/// Framebuffer around one display, re-rendered only when *gen moves, on clicks
+/// (local ui state) or when the display asks for it with dispRedraw()
+struct DispFramebuffer : FramebufferWidget {
+	const unsigned int *gen = NULL;
+	unsigned int drawnGen = 0;
+
+	void step() override {
+		if (gen && (*gen != drawnGen)){
+			drawnGen = *gen;
+			dirty = true;
+		}
+		FramebufferWidget::step();
+	}
+	void onButton(const event::Button &e) override {
+		FramebufferWidget::onButton(e);
+		dirty = true;
+	}
+};
+
+/// Wraps display in a DispFramebuffer placed where the display was (gen NULL: render once, previews)
+inline DispFramebuffer *dispCache(Widget *display, const unsigned int *gen){
+	DispFramebuffer *fb = new DispFramebuffer;
+	fb->box = display->box;
+	display->box.pos = Vec(0.f, 0.f);
+	fb->gen = gen;
+	fb->addChild(display);
+	return fb;
+}
+
+/// For changes the module does not see (display timers)
+inline void dispRedraw(Widget *display){
+	FramebufferWidget *fb = display->getAncestorOfType<FramebufferWidget>();
+	if (fb) fb->dirty = true;
+}
+
+/// Thin overlay for the focus / learn flashes of a cached display.
+/// Placed over the display box, draws nothing when idle.
+struct DispFlash : TransparentWidget {
+	Rect flashBox;
+	NVGcolor color = nvgRGB(0x64, 0x64, 0x00);
+	bool additive = false;
+	int fade = 0;
+	int fadeStep = 1;
+	bool blink = false;
+	unsigned char blinkPhase = 0;
+
+	/// focus flash fading from frames (alpha, or grey level if additive)
+	void focus(Rect r, int frames, int step){
+		flashBox = r;
+		fade = frames;
+		fadeStep = step;
+	}
+	/// learn blink on r while on
+	void learn(Rect r, bool on){
+		if (on) flashBox = r;
+		blink = on;
+	}
+	void draw(const DrawArgs &args) override {
+		if (blink){
+			blinkPhase += 16;
+			nvgBeginPath(args.vg);
+			nvgRoundedRect(args.vg, flashBox.pos.x, flashBox.pos.y, flashBox.size.x, flashBox.size.y, 3.f);
+			nvgFillColor(args.vg, nvgRGBA(blinkPhase, 0, 0, blinkPhase >> 2));
+			nvgFill(args.vg);
+		}else if (fade > 0){
+			nvgBeginPath(args.vg);
+			nvgRoundedRect(args.vg, flashBox.pos.x, flashBox.pos.y, flashBox.size.x, flashBox.size.y, 3.f);
+			if (additive){
+				nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
+				nvgFillColor(args.vg, nvgRGB(fade, fade, fade));
+			}else{
+				nvgFillColor(args.vg, nvgTransRGBA(color, fade));
+			}
+			nvgFill(args.vg);
+			fade -= fadeStep;
+		}
+	}
+};
+
+/// Flash overlay over display, create it before dispCache() and add it after the cache
+inline DispFlash *dispFlashOver(Widget *display){
+	DispFlash *flash = new DispFlash;
+	flash->box = display->box;
+	return flash;
+}
@@ -0,0 +1,182 @@
+/*
+grooveDllz.cpp Groove templates (per step timing / velocity)
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+#include "moDllz.hpp"
+#include <fstream> // ifstream
+GrooveTemplate::GrooveTemplate(){
+	clear();
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void GrooveTemplate::clear(){
+	length = 16;
+	for (int i = 0; i < maxSteps; i++){
+		timing[i] = 0.f;
+		velocity[i] = 1.f;
+	}
+	name = "";
+}
+///////////////////////////////////////////////////////////////////////////////////////
+bool GrooveTemplate::loadText(const std::string &path){
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+	float tim[maxSteps];
+	float vel[maxSteps];
+	int steps = 0;
+	std::string line;
+	while ((steps < maxSteps) && std::getline(file, line)){
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+		std::istringstream ss(line);
+		float t;
+		if (!(ss >> t)) continue;
+		float v = 1.f;
+		ss >> v;
+		tim[steps] = clamp(t, -0.5f, 0.5f);
+		vel[steps] = clamp(v, 0.f, 2.f);
+		steps ++;
+	}
+	if (steps < 1) return false;
+	clear();
+	length = (steps > 16) ? 32 : 16;
+	for (int i = 0; i < length; i++){ // short patterns repeat
+		timing[i] = tim[i % steps];
+		velocity[i] = vel[i % steps];
+	}
+	name = string::filenameBase(string::filename(path));
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+static uint32_t readVarLen(const std::vector<uint8_t> &d, size_t &p){
+	uint32_t value = 0;
+	for (int i = 0; (i < 4) && (p < d.size()); i++){
+		uint8_t c = d[p++];
+		value = (value << 7) | (c & 0x7f);
+		if (!(c & 0x80)) break;
+	}
+	return value;
+}
+static uint32_t readBE(const std::vector<uint8_t> &d, size_t p, int bytes){
+	uint32_t value = 0;
+	for (int i = 0; i < bytes; i++) value = (value << 8) | d[p + i];
+	return value;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+bool GrooveTemplate::loadMidi(const std::string &path){
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	std::vector<uint8_t> d((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if ((d.size() < 14) || (readBE(d, 0, 4) != 0x4d546864)) return false; // MThd
+	uint32_t division = readBE(d, 12, 2);
+	if ((division == 0) || (division & 0x8000)) return false; // SMPTE time not supported
+	float ticksPerStep = division / 4.f;
+	float tim[maxSteps];
+	int vel[maxSteps];
+	bool stepOn[maxSteps] = {false};
+	int topStep = -1;
+	int maxVel = 1;
+	size_t p = 8 + readBE(d, 4, 4);
+	while (p + 8 <= d.size()){
+		uint32_t chunkLen = readBE(d, p + 4, 4);
+		size_t end = std::min(d.size(), p + 8 + chunkLen);
+		if (readBE(d, p, 4) == 0x4d54726b){ // MTrk
+			size_t q = p + 8;
+			uint32_t tick = 0;
+			uint8_t status = 0;
+			while (q < end){
+				tick += readVarLen(d, q);
+				if (q >= end) break;
+				if (d[q] & 0x80) status = d[q++];
+				if (status == 0xff){ // meta
+					if (q >= end) break;
+					q++;
+					q += readVarLen(d, q);
+					status = 0;
+				}else if ((status == 0xf0) || (status == 0xf7)){ // sysex
+					q += readVarLen(d, q);
+					status = 0;
+				}else if ((status & 0xf0) == 0x90){
+					if (q + 2 > end) break;
+					int v = d[q + 1];
+					q += 2;
+					if (v == 0) continue;
+					int step = static_cast<int>(tick / ticksPerStep + 0.5f);
+					if ((step >= maxSteps) || stepOn[step]) continue;
+					stepOn[step] = true;
+					tim[step] = clamp((tick - step * ticksPerStep) / ticksPerStep, -0.5f, 0.5f);
+					vel[step] = v;
+					if (v > maxVel) maxVel = v;
+					if (step > topStep) topStep = step;
+				}else if (((status & 0xf0) == 0xc0) || ((status & 0xf0) == 0xd0)){
+					q += 1;
+				}else if (status >= 0x80){
+					q += 2;
+				}else break; // running status without status
+			}
+		}
+		p = end;
+	}
+	if (topStep < 0) return false;
+	clear();
+	length = (topStep > 15) ? 32 : 16;
+	for (int i = 0; i < maxSteps; i++){
+		if (stepOn[i]){
+			timing[i] = tim[i];
+			velocity[i] = static_cast<float>(vel[i]) / static_cast<float>(maxVel);
+		}
+	}
+	name = string::filenameBase(string::filename(path));
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+bool GrooveTemplate::load(const std::string &path){
+	std::string ext = string::lowercase(string::filenameExtension(path));
+	if ((ext == "mid") || (ext == "midi")) return loadMidi(path);
+	return loadText(path);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+json_t *GrooveTemplate::toJson() const {
+	json_t *grooveJ = json_object();
+	json_object_set_new(grooveJ, "name", json_string(name.c_str()));
+	json_t *timingJ = json_array();
+	json_t *velocityJ = json_array();
+	for (int i = 0; i < length; i++){
+		json_array_append_new(timingJ, json_real(timing[i]));
+		json_array_append_new(velocityJ, json_real(velocity[i]));
+	}
+	json_object_set_new(grooveJ, "timing", timingJ);
+	json_object_set_new(grooveJ, "velocity", velocityJ);
+	return grooveJ;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void GrooveTemplate::fromJson(json_t *grooveJ){
+	json_t *timingJ = json_object_get(grooveJ, "timing");
+	json_t *velocityJ = json_object_get(grooveJ, "velocity");
+	if (!timingJ || !velocityJ) return;
+	int steps = std::min(static_cast<int>(json_array_size(timingJ)), maxSteps);
+	if (steps < 1) return;
+	clear();
+	length = (steps > 16) ? 32 : 16;
+	for (int i = 0; i < steps; i++){
+		timing[i] = clamp(static_cast<float>(json_number_value(json_array_get(timingJ, i))), -0.5f, 0.5f);
+		json_t *velJ = json_array_get(velocityJ, i);
+		if (velJ) velocity[i] = clamp(static_cast<float>(json_number_value(velJ)), 0.f, 2.f);
+	}
+	json_t *nameJ = json_object_get(grooveJ, "name");
+	if (nameJ) name = json_string_value(nameJ);
+}
@@ -0,0 +1,44 @@
+/*
+grooveDllz.hpp Groove templates (per step timing / velocity)
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// One template can be read by several clocks, each one keeps its own step index.
+struct GrooveTemplate {
+	static const int maxSteps = 32;
+	int length = 16;
+	float timing[maxSteps]; // step offset in steps (-0.5 ~ 0.5)
+	float velocity[maxSteps]; // velocity scale (0 ~ 2)
+	std::string name = "";
+
+	GrooveTemplate();
+	void clear();
+	/// phase from step ix to the next one (1.f = straight)
+	float stepLength(int ix) const {
+		return 1.f + timing[(ix + 1) % length] - timing[ix % length];
+	}
+	float velScale(int ix) const {
+		return velocity[ix % length];
+	}
+	/// text: one step per line "timing velocity", # comments
+	bool loadText(const std::string &path);
+	/// standard midi file: note ons quantized to 16ths
+	bool loadMidi(const std::string &path);
+	bool load(const std::string &path);
+	json_t *toJson() const;
+	void fromJson(json_t *grooveJ);
+};
@@ -0,0 +1,345 @@
+/*
+keysDllz.hpp Velocity curves and key zones
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// Note on velocity curve. Tables are rebuilt on menu changes only, a note on is a lookup:
+/// lookup7() for MIDI 1.0 velocities, lookup16() interpolates 16-bit (MIDI 2.0) ones.
+/// Played velocities never map to 0 so a note on stays a note on.
+/// The UI thread builds into a spare buffer and publishes it through a DispSnapshot
+/// (here the UI writes and the engine reads), a drag on the pad never tears a table.
+struct VelocityCurve {
+	enum Shape {
+		LINEAR,
+		SOFT,	// more level on soft playing
+		HARD,	// less level on soft playing
+		SCURVE,
+		USER,	// drawn in the menu
+		NUM_SHAPES
+	};
+	struct Tables {
+		uint8_t table7[128];
+		int32_t table16[129];	// on vel >> 9, 65536 at the top so LINEAR is exact
+	};
+	int shape = LINEAR;
+	uint8_t user[128];	// drawn curve, out 1 ~ 127 for in 1 ~ 127
+	DispSnapshot<Tables> tables;
+
+	VelocityCurve(){
+		resetUser();
+	}
+	void resetUser(){
+		for (int i = 0; i < 128; i++) user[i] = i;
+		build();
+	}
+	/// curve on 0 ~ 1
+	float shapeAt(float x) const {
+		switch (shape){
+			case SOFT: return 1.f - (1.f - x) * (1.f - x);
+			case HARD: return x * x;
+			case SCURVE: return x * x * (3.f - 2.f * x);
+			case USER: {
+				float pos = clamp(x * 127.f, 0.f, 127.f);
+				int i = std::min(static_cast<int>(pos), 126);
+				return (user[i] + (user[i + 1] - user[i]) * (pos - i)) / 127.f;
+			}
+			default: return x;
+		}
+	}
+	/// UI thread
+	void build(){
+		Tables &t = tables.write();
+		t.table7[0] = 0;
+		for (int i = 1; i < 128; i++)
+			t.table7[i] = clamp(static_cast<int>(std::round(shapeAt(i / 127.f) * 127.f)), 1, 127);
+		t.table16[0] = 0;
+		for (int i = 1; i < 129; i++)
+			t.table16[i] = clamp(static_cast<int>(std::round(shapeAt(i / 128.f) * 65536.f)), 512, 65536);
+		tables.publish();
+	}
+	void set(int newShape){
+		shape = newShape;
+		build();
+	}
+	/// engine thread
+	int lookup7(int vel){
+		tables.update();
+		return tables.read().table7[vel & 127];
+	}
+	uint16_t lookup16(uint16_t vel){
+		tables.update();
+		const int32_t *table16 = tables.read().table16;
+		int i = vel >> 9;
+		int32_t out = table16[i] + (((table16[i + 1] - table16[i]) * (vel & 511)) / 512);
+		return clamp(out, 1, 65535);
+	}
+	std::string label() const {
+		const std::string shapeNames[NUM_SHAPES] = {"linear", "soft", "hard", "S", "drawn"};
+		return shapeNames[clamp(shape, 0, NUM_SHAPES - 1)];
+	}
+	json_t *toJson() const {
+		json_t *rootJ = json_object();
+		json_object_set_new(rootJ, "shape", json_integer(shape));
+		json_t *userJ = json_array();
+		for (int i = 0; i < 128; i++) json_array_append_new(userJ, json_integer(user[i]));
+		json_object_set_new(rootJ, "user", userJ);
+		return rootJ;
+	}
+	void fromJson(json_t *rootJ){
+		if (!rootJ) return;
+		json_t *shapeJ = json_object_get(rootJ, "shape");
+		if (shapeJ) shape = clamp(static_cast<int>(json_integer_value(shapeJ)), 0, NUM_SHAPES - 1);
+		json_t *userJ = json_object_get(rootJ, "user");
+		if (userJ && (json_array_size(userJ) == 128)){
+			for (int i = 1; i < 128; i++)
+				user[i] = clamp(static_cast<int>(json_integer_value(json_array_get(userJ, i))), 1, 127);
+		}
+		build();
+	}
+};
+
+/// Key and velocity range a module takes notes from. Modules on one MIDI input split the
+/// keyboard with ranges apart and layer it where they overlap. Edits come from the UI
+/// (menu, preset) and the engine (learn, display), build() only publishes the packed
+/// bounds in one atomic word: the masks belong to the engine thread and are rebuilt there
+/// when the bounds moved, a note on tests two bytes.
+struct KeyZone {
+	enum Learn {
+		NONE,
+		NOTEMIN,
+		NOTEMAX,
+		VELMIN,
+		VELMAX
+	};
+	int noteMin = 0;
+	int noteMax = 127;
+	int velMin = 1;
+	int velMax = 127;
+	std::atomic<int> learning;	// armed from the menu, taken by the next note on
+	std::atomic<uint32_t> bounds;	// published, noteMin | noteMax << 8 | velMin << 16 | velMax << 24
+	/// engine side
+	uint32_t maskBounds = 0;
+	uint8_t keyIn[128];
+	uint8_t velIn[128];
+
+	KeyZone() : learning(NONE), bounds(0) {
+		build();
+	}
+	void build(){
+		bounds.store(static_cast<uint32_t>(noteMin) | (noteMax << 8) | (velMin << 16) | (static_cast<uint32_t>(velMax) << 24), std::memory_order_release);
+	}
+	void set(int newNoteMin, int newNoteMax, int newVelMin, int newVelMax){
+		noteMin = clamp(newNoteMin, 0, 127);
+		noteMax = clamp(newNoteMax, noteMin, 127);
+		velMin = clamp(newVelMin, 1, 127);
+		velMax = clamp(newVelMax, velMin, 127);
+		build();
+	}
+	/// engine thread, vel7: MIDI 1.0 velocity, 16-bit ones >> 9
+	bool takes(int note, int vel7){
+		uint32_t b = bounds.load(std::memory_order_acquire);
+		if (b != maskBounds){
+			maskBounds = b;
+			for (int i = 0; i < 128; i++){
+				keyIn[i] = (i >= static_cast<int>(b & 127)) && (i <= static_cast<int>((b >> 8) & 127));
+				velIn[i] = (i >= static_cast<int>((b >> 16) & 127)) && (i <= static_cast<int>(b >> 24));
+			}
+		}
+		return keyIn[note & 127] & velIn[vel7 & 127];
+	}
+	/// one bound from a played note, the other one follows when passed
+	void learn(int what, int note, int vel7){
+		switch (what){
+			case NOTEMIN:
+				set(note, std::max(noteMax, note), velMin, velMax);
+				break;
+			case NOTEMAX:
+				set(std::min(noteMin, note), note, velMin, velMax);
+				break;
+			case VELMIN:
+				set(noteMin, noteMax, vel7, std::max(velMax, vel7));
+				break;
+			case VELMAX:
+				set(noteMin, noteMax, std::min(velMin, vel7), vel7);
+				break;
+			default: break;
+		}
+	}
+	void learnPending(int note, int vel7){
+		learn(learning, note, vel7);
+		learning = NONE;
+	}
+	std::string label() const {
+		return std::string(dllzNoteName(noteMin)) + " ~ " + dllzNoteName(noteMax) + ", vel " + dllzNumber(velMin) + " ~ " + dllzNumber(velMax);
+	}
+	json_t *toJson() const {
+		json_t *rootJ = json_object();
+		json_object_set_new(rootJ, "noteMin", json_integer(noteMin));
+		json_object_set_new(rootJ, "noteMax", json_integer(noteMax));
+		json_object_set_new(rootJ, "velMin", json_integer(velMin));
+		json_object_set_new(rootJ, "velMax", json_integer(velMax));
+		return rootJ;
+	}
+	void fromJson(json_t *rootJ){
+		if (!rootJ) return;
+		int values[4] = {noteMin, noteMax, velMin, velMax};
+		const char *keys[4] = {"noteMin", "noteMax", "velMin", "velMax"};
+		for (int i = 0; i < 4; i++){
+			json_t *valueJ = json_object_get(rootJ, keys[i]);
+			if (valueJ) values[i] = json_integer_value(valueJ);
+		}
+		set(values[0], values[1], values[2], values[3]);
+	}
+};
+
+/// Drawing pad for the USER curve, drag across to draw
+struct VelocityCurveDraw : OpaqueWidget {
+	VelocityCurve *curve;
+	Vec dragPos;
+	VelocityCurveDraw(){
+		box.size = Vec(136.f, 72.f);
+	}
+	int velAt(float x){
+		return clamp(static_cast<int>(x - 4.f), 1, 127);
+	}
+	int levelAt(float y){
+		return clamp(static_cast<int>(std::round((box.size.y - 4.f - y) * 127.f / 64.f)), 1, 127);
+	}
+	void drawLine(Vec from, Vec to){
+		int v0 = velAt(from.x);
+		int v1 = velAt(to.x);
+		int l0 = levelAt(from.y);
+		int l1 = levelAt(to.y);
+		int steps = std::abs(v1 - v0);
+		for (int i = 0; i <= steps; i++){
+			int v = v0 + ((v1 > v0) ? i : -i);
+			curve->user[v] = (steps > 0) ? l0 + (l1 - l0) * i / steps : l1;
+		}
+		curve->set(VelocityCurve::USER);
+	}
+	void onButton(const event::Button &e) override {
+		if ((e.action == GLFW_PRESS) && (e.button == GLFW_MOUSE_BUTTON_LEFT)){
+			e.consume(this);
+			dragPos = e.pos;
+			drawLine(dragPos, dragPos);
+		}
+	}
+	void onDragMove(const event::DragMove &e) override {
+		Vec from = dragPos;
+		dragPos = dragPos.plus(e.mouseDelta);
+		drawLine(from, dragPos);
+	}
+	void draw(const DrawArgs &args) override {
+		nvgBeginPath(args.vg);
+		nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y, 3.f);
+		nvgFillColor(args.vg, nvgRGB(0x20, 0x20, 0x20));
+		nvgFill(args.vg);
+		nvgBeginPath(args.vg);
+		nvgMoveTo(args.vg, 4.f, box.size.y - 4.f);
+		for (int i = 1; i < 128; i++)
+			nvgLineTo(args.vg, 4.f + i, box.size.y - 4.f - curve->shapeAt(i / 127.f) * 64.f);
+		nvgStrokeColor(args.vg, nvgRGB(0xee, 0xee, 0x88));
+		nvgStrokeWidth(args.vg, 1.f);
+		nvgStroke(args.vg);
+	}
+};
+
+struct VelocityShapeItem : MenuItem {
+	VelocityCurve *curve;
+	int shape;
+	void onAction(const event::Action &e) override {
+		curve->set(shape);
+	}
+};
+
+struct VelocityUserResetItem : MenuItem {
+	VelocityCurve *curve;
+	void onAction(const event::Action &e) override {
+		curve->resetUser();
+	}
+};
+
+/// "Velocity curve: shape" menu entry, the child menu has the shapes and the drawing pad
+struct VelocityCurveItem : MenuItem {
+	VelocityCurve *curve;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		const std::string shapeNames[VelocityCurve::NUM_SHAPES] = {"Linear", "Soft", "Hard", "S curve", "Drawn"};
+		for (int i = 0; i < VelocityCurve::NUM_SHAPES; i++){
+			VelocityShapeItem *shapeItem = createMenuItem<VelocityShapeItem>(shapeNames[i], CHECKMARK(curve->shape == i));
+			shapeItem->curve = curve;
+			shapeItem->shape = i;
+			menu->addChild(shapeItem);
+		}
+		menu->addChild(new MenuEntry);
+		menu->addChild(createMenuLabel("Draw (sets Drawn):"));
+		VelocityCurveDraw *pad = new VelocityCurveDraw;
+		pad->curve = curve;
+		menu->addChild(pad);
+		VelocityUserResetItem *resetItem = createMenuItem<VelocityUserResetItem>("Reset drawing to linear");
+		resetItem->curve = curve;
+		menu->addChild(resetItem);
+		return menu;
+	}
+};
+
+inline VelocityCurveItem *createVelocityCurveItem(VelocityCurve *curve){
+	VelocityCurveItem *item = createMenuItem<VelocityCurveItem>("Velocity curve: " + curve->label(), RIGHT_ARROW);
+	item->curve = curve;
+	return item;
+}
+
+struct KeyZoneLearnItem : MenuItem {
+	KeyZone *zone;
+	int what;
+	void onAction(const event::Action &e) override {
+		zone->learning = what;
+	}
+};
+
+struct KeyZoneFullItem : MenuItem {
+	KeyZone *zone;
+	void onAction(const event::Action &e) override {
+		zone->set(0, 127, 1, 127);
+	}
+};
+
+/// "Key zone: range" menu entry, bounds are learnt from the next note played
+struct KeyZoneItem : MenuItem {
+	KeyZone *zone;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		const std::string learnNames[4] = {"Learn lowest key", "Learn highest key", "Learn softest velocity", "Learn hardest velocity"};
+		for (int i = 0; i < 4; i++){
+			KeyZoneLearnItem *learnItem = createMenuItem<KeyZoneLearnItem>(learnNames[i], CHECKMARK(zone->learning == i + 1));
+			learnItem->zone = zone;
+			learnItem->what = i + 1;
+			menu->addChild(learnItem);
+		}
+		menu->addChild(new MenuEntry);
+		KeyZoneFullItem *fullItem = createMenuItem<KeyZoneFullItem>("Whole keyboard, all velocities");
+		fullItem->zone = zone;
+		menu->addChild(fullItem);
+		return menu;
+	}
+};
+
+inline KeyZoneItem *createKeyZoneItem(KeyZone *zone){
+	KeyZoneItem *item = createMenuItem<KeyZoneItem>("Key zone: " + zone->label(), RIGHT_ARROW);
+	item->zone = zone;
+	return item;
+}
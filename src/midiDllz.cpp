@@ -18,18 +18,20 @@ along with this program.  If not, see <https:www.gnu.org/licenses/>.
 */
 
 #include "moDllz.hpp"
+#include <fstream> // ump file
+#include <osdialog.h> // ump file
 MIDIdisplay::MIDIdisplay(){
-	font = APP->window->loadFont(mFONT_FILE);
+	font = pluginFont(mFONT_FILE);
 }
 ///////////////////////////////////////////////////////////////////////////////////////
 DispBttnL::DispBttnL(){
 	momentary = true;
-	addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/DispBttnL.svg")));
+	addFrame(pluginSvg("res/DispBttnL.svg"));
 }
 ///////////////////////////////////////////////////////////////////////////////////////
 DispBttnR::DispBttnR(){
 	momentary = true;
-	addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/DispBttnR.svg")));
+	addFrame(pluginSvg("res/DispBttnR.svg"));
 }
 ///////////////////////////////////////////////////////////////////////////////////////
 void DispBttnL::onButton(const event::Button &e) {
@@ -50,59 +52,223 @@ void DispBttnR::onButton(const event::Button &e) {
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////
-void MIDIdisplay::updateMidiSettings (int dRow, bool valup){
-	switch (dRow) {
-		case 0: {
-			bool resetdr = true;
-			int drIx = 0;
-			int midiDrivers = static_cast<int>(midiInput->getDriverIds().size());
-			for (int driverId : midiInput->getDriverIds()) {
-				if (driverId == midiInput->driverId){
-					if (valup){
-						if (drIx < midiDrivers - 1) midiInput->setDriverId(midiInput->getDriverIds().at(drIx + 1));
-						else midiInput->setDriverId(midiInput->getDriverIds().front());
-					}else {//val down
-						if (drIx > 0) midiInput->setDriverId(midiInput->getDriverIds().at(drIx - 1));
-						else midiInput->setDriverId(midiInput->getDriverIds().back());
-					}
-					resetdr = false;
+MIDIwatcher &MIDIwatcher::get(){
+	static MIDIwatcher watcher;
+	return watcher;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+MIDIwatcher::~MIDIwatcher(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+		wake.notify_one();
+	}
+	if (thread.joinable()) thread.join();
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIwatcher::subscribe(Client *client){
+	std::lock_guard<std::mutex> lock(mutex);
+	clients.push_back(client);
+	if (!scanPort) scanPort = new midi::Input;
+	if (!running){
+		running = true;
+		thread = std::thread(&MIDIwatcher::run, this);
+	}
+	due = true;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// the last subscriber stops the thread and drops the cache
+void MIDIwatcher::unsubscribe(Client *client){
+	std::thread stopping;
+	midi::Input *closing = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+		if (clients.empty()){
+			if (running){
+				running = false;
+				wake.notify_one();
+				stopping = std::move(thread);
+			}
+			closing = scanPort;
+			scanPort = NULL;
+			drivers.clear();
+		}
+	}
+	if (stopping.joinable()) stopping.join();
+	delete closing;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// only decides a rescan is due, the drivers are never touched from here
+void MIDIwatcher::run(){
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running){
+		due = true;
+		wake.wait_for(lock, std::chrono::milliseconds(500), [this]{ return !running; });
+	}
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIwatcher::step(Client *client){
+	if (due.exchange(false)) scan();
+	watch(client);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// one enumeration per driver for all the subscribers
+void MIDIwatcher::scan(){
+	if (!scanPort) return;
+	std::vector<Driver> found;
+	for (int driverId : scanPort->getDriverIds()) {
+		scanPort->setDriverId(driverId);
+		Driver d;
+		d.id = driverId;
+		d.name = scanPort->getDriverName(driverId);
+		for (int deviceId : scanPort->getDeviceIds()) {
+			d.deviceIds.push_back(deviceId);
+			d.deviceNames.push_back(scanPort->getDeviceName(deviceId));
+		}
+		found.push_back(d);
+	}
+	bool same = (found.size() == drivers.size());
+	for (size_t i = 0; same && (i < found.size()); i++) same = found[i].same(drivers[i]);
+	if (same) return;
+	drivers = found;
+	gen++;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+const MIDIwatcher::Driver *MIDIwatcher::findDriver(int driverId) const {
+	for (const Driver &d : drivers) {
+		if (d.id == driverId) return &d;
+	}
+	return NULL;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+std::string MIDIwatcher::deviceName(int driverId, int deviceId) const {
+	const Driver *d = findDriver(driverId);
+	if (!d) return "";
+	for (size_t i = 0; i < d->deviceIds.size(); i++) {
+		if (d->deviceIds[i] == deviceId) return d->deviceNames[i];
+	}
+	return "";
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// the one place the watcher changes a port's driver or device (modules load theirs with fromJson)
+void MIDIwatcher::setPort(midi::Port *port, int driverId, int deviceId){
+	if (port->driverId != driverId) port->setDriverId(driverId);
+	if (port->deviceId != deviceId) port->setDeviceId(deviceId);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIwatcher::stepDriver(midi::Port *port, bool valup){
+	int midiDrivers = static_cast<int>(drivers.size());
+	if (midiDrivers < 1) return;
+	int drIx = 0;
+	for (; drIx < midiDrivers; drIx++) {
+		if (drivers[drIx].id == port->driverId) break;
+	}
+	if (drIx == midiDrivers) drIx = 0;
+	else if (valup) drIx = (drIx < midiDrivers - 1) ? drIx + 1 : 0;
+	else drIx = (drIx > 0) ? drIx - 1 : midiDrivers - 1;//val down
+	const Driver &d = drivers[drIx];
+	setPort(port, d.id, (d.deviceIds.size() > 0) ? d.deviceIds.front() : -1);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+bool MIDIwatcher::stepDevice(midi::Port *port, bool valup){
+	const Driver *d = findDriver(port->driverId);
+	if (!d) return false;
+	int midiDevs = static_cast<int>(d->deviceIds.size());
+	if (midiDevs < 1) return false;
+	int deIx = 0;
+	for (; deIx < midiDevs; deIx++) {
+		if (d->deviceIds[deIx] == port->deviceId) break;
+	}
+	if (deIx == midiDevs) deIx = 0;
+	else if (valup) deIx = (deIx < midiDevs - 1) ? deIx + 1 : 0;
+	else deIx = (deIx > 0) ? deIx - 1 : midiDevs - 1;//val down
+	setPort(port, port->driverId, d->deviceIds[deIx]);
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// clients are served from the cache, only when it moved or on their own requests
+void MIDIwatcher::watch(Client *client){
+	if (!client->fresh && (client->seenGen == gen)) return;
+	client->fresh = false;
+	client->seenGen = gen;
+	int action = client->action;
+	client->action = -1;
+	bool search = client->search;
+	int savedDriver = client->savedDriver;
+	std::string savedDevice = client->savedDevice;
+	midi::Port *port = client->port;
+	bool disconnected = false;
+	bool restoreChannel = false;
+	bool resetChannel = false;
+	if (action > -1){
+		if (action < 2){
+			stepDriver(port, action & 1);
+			resetChannel = true;
+		}else resetChannel = stepDevice(port, action & 1);
+		if (port->deviceId > -1){
+			savedDriver = port->driverId;
+			savedDevice = deviceName(port->driverId, port->deviceId);
+		}
+		search = false;
+	}else if ((port->deviceId > -1) && (deviceName(port->driverId, port->deviceId) != savedDevice)) search = true;
+	if (search){
+		if (savedDevice != ""){/// if previously saved
+			disconnected = true;
+			const Driver *d = findDriver(savedDriver);
+			int deviceId = -1;
+			for (size_t i = 0; d && (i < d->deviceIds.size()); i++) {
+				if (d->deviceNames[i] == savedDevice) {
+					deviceId = d->deviceIds[i];
+					disconnected = false;
+					restoreChannel = true;
+					search = false;
 					break;
 				}
-				drIx ++;
 			}
-			if (resetdr) midiInput->setDriverId(midiInput->getDriverIds().front());
-			if (midiInput->getDeviceIds().size() > 0){
-				midiInput->setDeviceId(0);
-				*mdriverJ = midiInput->driverId;//valid for saving
-				*mdeviceJ = midiInput->getDeviceName(0);
-			}else midiInput->setDeviceId(-1);
-			mchannelMem = -1;
-			*mchannelJ = -1;
-		} break;
-		case 1: {
-			int deIx = 0;
-			bool devhere = false;
-			int midiDevs = static_cast<int>(midiInput->getDeviceIds().size());
-			if (midiDevs > 0){
-				for (int deviceId : midiInput->getDeviceIds()) {
-					if (deviceId == midiInput->deviceId){
-						if (valup){
-							if (deIx < midiDevs - 1) midiInput->setDeviceId(midiInput->getDeviceIds().at(deIx + 1));
-							else midiInput->setDeviceId(midiInput->getDeviceIds().front());
-						}else {//val down
-							if (deIx > 0) midiInput->setDeviceId(midiInput->getDeviceIds().at(deIx - 1));
-							else midiInput->setDeviceId(midiInput->getDeviceIds().back());
-						}
-						devhere = true;
-						break;
-					}
-					deIx ++;
+			setPort(port, savedDriver, deviceId);
+		}else{ //initial search / (no saved devices)
+			if (drivers.size() > 0){
+				const Driver &d = drivers.front();
+				setPort(port, d.id, (d.deviceIds.size() > 0) ? d.deviceIds.front() : -1);
+				if (d.deviceIds.size() > 0){
+					savedDriver = d.id;
+					savedDevice = d.deviceNames.front();
 				}
-				if (!devhere) midiInput->setDeviceId(midiInput->getDeviceIds().front());
-				*mdeviceJ = midiInput->getDeviceName(midiInput->deviceId);//valid for saving
-				mchannelMem = -1;
-				*mchannelJ = -1;
 			}
+			resetChannel = true;
+		}
+	}
+	const Driver *d = findDriver(port->driverId);
+	std::string driverName = d ? d->name : "";
+	std::string portDevice = (port->deviceId > -1) ? deviceName(port->driverId, port->deviceId) : "";
+	if (disconnected != client->disconnected || restoreChannel || resetChannel
+		|| driverName != client->driverName || portDevice != client->deviceName
+		|| savedDevice != client->savedDevice || savedDriver != client->savedDriver){
+		client->changed = true;
+	}
+	client->search = search;
+	client->savedDriver = savedDriver;
+	client->savedDevice = savedDevice;
+	client->disconnected = disconnected;
+	client->restoreChannel |= restoreChannel;
+	client->resetChannel |= resetChannel;
+	client->driverName = driverName;
+	client->deviceName = portDevice;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+MIDIdisplay::~MIDIdisplay(){
+	if (watched) MIDIwatcher::get().unsubscribe(&client);
+}
+///////////////////////////////////////////////////////////////////////////////////////
+/// driver and device rows are answered by the watcher, the channel row is local
+void MIDIdisplay::updateMidiSettings (int dRow, bool valup){
+	switch (dRow) {
+		case 0:
+		case 1: {
+			if (!watched) return;
+			client.action = dRow * 2 + (valup ? 1 : 0);
+			client.fresh = true;
 		} break;
 		case 2:{
 			if (i_mpeMode){
@@ -125,43 +291,46 @@ void MIDIdisplay::updateMidiSettings (int dRow, bool valup){
 				//*mpeChn = (mchannelMem > -1)? mchannelMem : 0;
 				*mchannelJ = mchannelMem;//valid for saving
 			}
+			reDisplay();
 		} break;
 	}
-	searchdev = false;
 	*midiActiv = 64;
-	reDisplay();
 	return;
 }
 ///////////////////////////////////////////////////////////////////////////////////////
+/// names come from the watcher results, no driver calls here
 void MIDIdisplay::reDisplay(){
-	mdriver = midiInput->getDriverName(midiInput->driverId);// driver name
-	if (midiInput->deviceId > -1){
+	if (disconnected){
+		textColor = nvgRGB(0xFF,0x64,0x64);
+		showchannel = false;
+		mdevice = *mdeviceJ;
+		mchannel.set("...disconnected...");
+	}else if (isdevice){
 		textColor = nvgRGB(0xbb,0xbb,0xbb);
-		mdevice = midiInput->getDeviceName(midiInput->deviceId);// device
 		showchannel = (mdriver != "Computer keyboard");
 		if (i_mpeMode) { //channel MPE
-			mchannel = "mpe master " + std::to_string(i_mpeChn + 1);
+			mchannel.set("mpe master ").add(i_mpeChn + 1);
 			midiInput->channel = -1;
 		}else { // channel
 			if (showchannel){
 				midiInput->channel = mchannelMem;
-				if (midiInput->channel < 0) mchannel = "ALLch";
-				else mchannel =  "ch " + std::to_string(midiInput->channel + 1);
+				if (midiInput->channel < 0) mchannel.set("ALLch");
+				else mchannel.set("ch ").add(midiInput->channel + 1);
 				//showchannel = true;
-			} else mchannel = "";
+			} else mchannel.clear();
 		}
-		isdevice = true;
 	}else {
 		textColor = nvgRGB(0xaa,0xaa,0x00);
 		showchannel = false;
-		isdevice = false;
 		mdevice = "(no device)";
-		mchannel = "";
+		mchannel.clear();
 	}
-	drawframe = 0;
+	dispRedraw(this);
 }
 ///////////////////////////////////////////////////////////////////////////////////////
-void MIDIdisplay::draw(const DrawArgs &args){
+/// the watcher scans and sets the port here, on the UI thread but out of draw(),
+/// the text is drawn in the framebuffer only on changes
+void MIDIdisplay::step(){
 	if (midiInput){
 		if (i_mpeMode != *mpeMode) {
 			i_mpeMode = *mpeMode;
@@ -169,48 +338,46 @@ void MIDIdisplay::draw(const DrawArgs &args){
 		}
 		if ((i_mpeChn != *mpeChn) && (i_mpeMode)){
 			i_mpeChn = *mpeChn;
-			mchannel = "mpe master " + std::to_string(i_mpeChn + 1);
+			mchannel.set("mpe master ").add(i_mpeChn + 1);
+			dispRedraw(this);
 		}
-		if (drawframe++ > 50){
-			drawframe = 0;
-			if (isdevice && (midiInput->getDeviceName(midiInput->deviceId) != *mdeviceJ)) searchdev = true;
-			if (searchdev) {
-				showchannel = false;
-				if (*mdeviceJ != ""){/// if previously saved
-					textColor = nvgRGB(0xFF,0x64,0x64);
-					midiInput->setDriverId(*mdriverJ);
-					mdevice = *mdeviceJ;
-					mchannel = "...disconnected...";
-					for (int deviceId : midiInput->getDeviceIds()) {
-						if (midiInput->getDeviceName(deviceId) == *mdeviceJ) {
-							midiInput->setDeviceId(deviceId);
-							mchannelMem = *mchannelJ;
-							searchdev = false;
-							isdevice = true;
-							showchannel = true;
-							reDisplay();
-							break;
-						}
-					}
-				}else{ //initial searchdev / (no saved devices)
-					midiInput->setDriverId(midiInput->getDriverIds().front());
-					if (midiInput->getDeviceIds().size() > 0){
-						midiInput->setDeviceId(midiInput->getDeviceIds().front());
-						*mdriverJ = midiInput->driverId;//valid for saving
-						*mdeviceJ = midiInput->getDeviceName(midiInput->deviceId);
-					}else midiInput->setDeviceId(-1);
-					*mchannelJ = -1;
+		if (watched){
+			if (*mloadGenJ != loadGenSeen){// preset load or paste: search its device
+				loadGenSeen = *mloadGenJ;
+				client.savedDriver = *mdriverJ;
+				client.savedDevice = *mdeviceJ;
+				client.search = true;
+				client.action = -1;
+				client.fresh = true;
+			}
+			MIDIwatcher::get().step(&client);
+			if (client.changed){
+				client.changed = false;
+				mdriver = client.driverName;
+				mdevice = client.deviceName;
+				disconnected = client.disconnected;
+				isdevice = !disconnected && (client.deviceName != "");
+				*mdriverJ = client.savedDriver;//valid for saving
+				*mdeviceJ = client.savedDevice;
+				if (client.restoreChannel) mchannelMem = *mchannelJ;
+				if (client.resetChannel){
 					mchannelMem = -1;
-					reDisplay();
+					*mchannelJ = -1;
 				}
+				client.restoreChannel = false;
+				client.resetChannel = false;
+				reDisplay();
 			}
 		}
-		if (*midiActiv > 3) *midiActiv -= 4;
-		else *midiActiv = 0;//clip to 0
-		//nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
+	}
+	OpaqueWidget::step();
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void MIDIdisplay::draw(const DrawArgs &args){
+	if (midiInput){
 		nvgBeginPath(args.vg);
 		nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y, 4.f);
-		nvgFillColor(args.vg, nvgRGB(static_cast<unsigned char>(*midiActiv * .5),static_cast<unsigned char>(*midiActiv * .5) ,0));
+		nvgFillColor(args.vg, nvgRGB(0, 0, 0));
 		nvgFill(args.vg);
 		nvgFontSize(args.vg, mdfontSize);
 		nvgFontFaceId(args.vg, font->handle);
@@ -223,6 +390,17 @@ void MIDIdisplay::draw(const DrawArgs &args){
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////
+void MIDIactivity::draw(const DrawArgs &args){
+	if (*midiActiv < 1) return;
+	if (*midiActiv > 3) *midiActiv -= 4;
+	else *midiActiv = 0;//clip to 0
+	nvgGlobalCompositeBlendFunc(args.vg,  NVG_ONE , NVG_ONE);
+	nvgBeginPath(args.vg);
+	nvgRoundedRect(args.vg, 0.f, 0.f, box.size.x, box.size.y, 4.f);
+	nvgFillColor(args.vg, nvgRGB(static_cast<unsigned char>(*midiActiv * .5),static_cast<unsigned char>(*midiActiv * .5) ,0));
+	nvgFill(args.vg);
+}
+///////////////////////////////////////////////////////////////////////////////////////
 void MIDIdisplay::onButton(const event::Button &e) {
 	e.stopPropagating();
 	if ((e.button == GLFW_MOUSE_BUTTON_LEFT) && (e.action == GLFW_PRESS)){
@@ -231,7 +409,7 @@ void MIDIdisplay::onButton(const event::Button &e) {
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////
-void MIDIscreen::setMidiPort(midi::Port *port,bool *mpeMode,int *mpeChn,int *midiActiv, int *mdriver, std::string *mdevice, int *mchannel, bool *resetMidi){
+void MIDIscreen::setMidiPort(midi::Port *port,bool *mpeMode,int *mpeChn,int *midiActiv, int *mdriver, std::string *mdevice, int *mchannel, bool *resetMidi, int *mloadGen){
 	clearChildren();
 	
 	MIDIdisplay *md = createWidget<MIDIdisplay>(Vec(0.f,0.f));
@@ -245,8 +423,21 @@ void MIDIscreen::setMidiPort(midi::Port *port,bool *mpeMode,int *mpeChn,int *mid
 	md->mdeviceJ = mdevice;
 	md->mchannelJ = mchannel;
 	md->resetMidi = resetMidi;
-	md->searchdev = true;
-	addChild(md);
+	md->mloadGenJ = mloadGen;
+	md->loadGenSeen = *mloadGen;
+	if (port){
+		md->client.port = port;
+		md->client.savedDriver = *mdriver;
+		md->client.savedDevice = *mdevice;
+		MIDIwatcher::get().subscribe(&md->client);
+		md->watched = true;
+	}
+	addChild(dispCache(md, NULL));
+	
+	MIDIactivity *activity = createWidget<MIDIactivity>(Vec(0.f,0.f));
+	activity->box.size = box.size;
+	activity->midiActiv = midiActiv;
+	addChild(activity);
 	
 	DispBttnL *drvBttnL = createWidget<DispBttnL>(Vec(1.f,1.f));
 	drvBttnL->md = md;
@@ -279,3 +470,47 @@ void MIDIscreen::setMidiPort(midi::Port *port,bool *mpeMode,int *mpeChn,int *mid
 ///////////////////////////////////////////////////////////////////////////////////////
 MIDIscreen::MIDIscreen(){
 }
+///////////////////////////////////////////////////////////////////////////////////////
+bool UMPfile::load(const std::string &path){
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+	std::vector<Packet> read;
+	float ms = 0.f;
+	std::string line;
+	while (std::getline(file, line)){
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+		std::istringstream ss(line);
+		std::string token;
+		if (!(ss >> token)) continue;
+		if (token[0] == '+'){
+			ms += std::max(0.f, static_cast<float>(std::atof(token.c_str() + 1)));
+			continue;
+		}
+		Packet packet;
+		packet.ms = ms;
+		for (int i = 0; i < 4; i++) packet.words[i] = 0;
+		packet.words[0] = static_cast<uint32_t>(std::strtoul(token.c_str(), NULL, 16));
+		int words = MidiUMPin::packetWords(packet.words[0]);
+		for (int i = 1; (i < words) && (ss >> token); i++)
+			packet.words[i] = static_cast<uint32_t>(std::strtoul(token.c_str(), NULL, 16));
+		read.push_back(packet);
+	}
+	if (read.empty()) return false;
+	packets = read;
+	name = string::filename(path);
+	rewind();
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////////////////
+void UMPfileItem::onAction(const event::Action &e){
+	osdialog_filters *filters = osdialog_filters_parse("UMP text (.txt .ump):txt,ump");
+	char *path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+	osdialog_filters_free(filters);
+	if (!path) return;
+	UMPfile *file = new UMPfile;
+	delete done->exchange(NULL);
+	if (file->load(path)) delete pending->exchange(file);
+	else delete file;
+	free(path);
+}
@@ -18,8 +18,354 @@ along with this program.  If not, see <https:www.gnu.org/licenses/>.
 */
 using namespace rack;
 
+/// Controller decoding for one channel: 14-bit CC pairs (MSB 0 ~ 31 + LSB 32 ~ 63) and the
+/// RPN / NRPN state machine (select 101 / 100 or 99 / 98, data entry 6 / 38, increment 96 / 97).
+/// feed() takes every CC and returns what it changed. CC values are 14-bit, a controller
+/// that never sent its LSB gets the MSB spread over 14 bits so 127 stays full scale.
+/// Parameter values are raw (MSB << 7 | LSB), RPN 0 carries the bend range semitones in the MSB.
+struct MidiCCin {
+	enum Kind {
+		NONE,
+		CC,
+		RPN,
+		NRPN
+	};
+	struct Event {
+		int kind;
+		int number;
+		int value;	// 0 ~ 16383
+	};
+	static const int none = 0x3fff;
+	uint16_t values[32] = {0};
+	uint32_t fine = 0;	// pairs that sent an LSB
+	int param = none;
+	bool nrpn = false;
+	int data = 0;
+
+	static int spread(uint8_t value){
+		return (value << 7) | value;
+	}
+	Event feed(uint8_t cc, uint8_t value){
+		switch (cc){
+			case 99:
+			case 101:
+				nrpn = (cc == 99);
+				param = (param & 0x7f) | (value << 7);
+				return Event{NONE, cc, 0};
+			case 98:
+			case 100:
+				nrpn = (cc == 98);
+				param = (param & 0x3f80) | value;
+				return Event{NONE, cc, 0};
+			case 6:
+				if (param == none) break;
+				data = value << 7;
+				return Event{nrpn ? NRPN : RPN, param, data};
+			case 38:
+				if (param == none) break;
+				data = (data & 0x3f80) | value;
+				return Event{nrpn ? NRPN : RPN, param, data};
+			case 96:
+			case 97:
+				if (param == none) return Event{NONE, cc, 0};
+				data = std::max(0, std::min(16383, data + ((cc == 96) ? 128 : -128)));
+				return Event{nrpn ? NRPN : RPN, param, data};
+			default:
+				break;
+		}
+		if (cc < 32){
+			values[cc] = (fine & (1u << cc)) ? (value << 7) : spread(value);
+			return Event{CC, cc, values[cc]};
+		}
+		if (cc < 64){
+			int msb = cc - 32;
+			fine |= 1u << msb;
+			values[msb] = (values[msb] & 0x3f80) | value;
+			return Event{CC, msb, values[msb]};
+		}
+		return Event{CC, cc, spread(value)};
+	}
+	void reset(){
+		for (int i = 0; i < 32; i++) values[i] = 0;
+		fine = 0;
+		param = none;
+		data = 0;
+	}
+};
+
+/// Universal MIDI Packet input: MIDI 2.0 channel voice packets (16-bit velocity, 32-bit
+/// controllers, bend, per note pitch and controllers) and MIDI 1.0 bytes decode to the same
+/// Event. MIDI 1.0 values are scaled up the MIDI 2.0 way (min center max) so one path
+/// fills the voice state at full resolution. MIDI 1.0 CCs go through MidiCCin first.
+struct MidiUMPin {
+	enum Kind {
+		NONE,
+		NOTEOFF,
+		NOTEON,
+		POLYPRESS,
+		CC,
+		RPN,
+		NRPN,
+		CHPRESS,
+		PITCHBEND,
+		NOTEBEND,	// per note pitch bend
+		NOTECC	// assignable per note controller
+	};
+	struct Event {
+		int kind = NONE;
+		uint8_t group = 0;
+		uint8_t channel = 0;
+		uint8_t note = 0;
+		uint16_t index = 0;	// controller, parameter (bank << 7 | index) or per note controller
+		uint32_t value = 0;	// velocity 16-bit, the rest 32-bit (bends centered on 0x80000000)
+	};
+	/// MIDI 1.0 note on at velocity 0: note off with no release velocity
+	static const uint32_t noVelocity = 0x10000;
+	MidiCCin ccIn[16];
+
+	static uint32_t scaleUp(uint32_t value, int srcBits, int dstBits){
+		int scaleBits = dstBits - srcBits;
+		uint32_t shifted = value << scaleBits;
+		if (value <= (1u << (srcBits - 1))) return shifted;
+		int repeatBits = srcBits - 1;
+		uint32_t repeat = value & ((1u << repeatBits) - 1);
+		repeat = (scaleBits > repeatBits) ? (repeat << (scaleBits - repeatBits)) : (repeat >> (repeatBits - scaleBits));
+		while (repeat){
+			shifted |= repeat;
+			repeat >>= repeatBits;
+		}
+		return shifted;
+	}
+	/// 32-bit controller to 0 ~ 1
+	static float unit(uint32_t value){
+		return value * (1.f / 4294967295.f);
+	}
+	/// 32-bit bend to signed, -0x80000000 ~ 0x7fffffff
+	static int32_t bend(uint32_t value){
+		return static_cast<int32_t>(value ^ 0x80000000u);
+	}
+	/// signed bend to -1 ~ 1
+	static float bipolar(int32_t value){
+		return value * (1.f / 2147483648.f);
+	}
+	/// packet size in 32-bit words from the message type
+	static int packetWords(uint32_t word0){
+		static const int words[16] = {1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+		return words[word0 >> 28];
+	}
+	Event fromMidi1(uint8_t status, uint8_t data1, uint8_t data2, uint8_t group = 0){
+		Event ev;
+		ev.group = group;
+		ev.channel = status & 0xf;
+		ev.note = data1;
+		switch (status >> 4){
+			case 0x8:
+				ev.kind = NOTEOFF;
+				ev.value = scaleUp(data2, 7, 16);
+				break;
+			case 0x9:
+				ev.kind = (data2 > 0) ? NOTEON : NOTEOFF;
+				ev.value = (data2 > 0) ? scaleUp(data2, 7, 16) : noVelocity;
+				break;
+			case 0xa:
+				ev.kind = POLYPRESS;
+				ev.value = scaleUp(data2, 7, 32);
+				break;
+			case 0xb:{
+				MidiCCin::Event cc = ccIn[ev.channel].feed(data1, data2);
+				const int kinds[4] = {NONE, CC, RPN, NRPN};
+				ev.kind = kinds[cc.kind];
+				ev.index = cc.number;
+				ev.value = scaleUp(cc.value, 14, 32);
+			}break;
+			case 0xd:
+				ev.kind = CHPRESS;
+				ev.value = scaleUp(data1, 7, 32);
+				break;
+			case 0xe:
+				ev.kind = PITCHBEND;
+				ev.value = scaleUp((data2 << 7) | data1, 14, 32);
+				break;
+			default:
+				break;
+		}
+		return ev;
+	}
+	Event fromMidi1(const midi::Message &msg){
+		return fromMidi1(msg.bytes[0], msg.bytes[1] & 0x7f, msg.bytes[2] & 0x7f);
+	}
+	/// one packet (packetWords() long). Only channel voice messages (types 2 and 4) make events
+	Event decode(const uint32_t *words){
+		uint8_t group = (words[0] >> 24) & 0xf;
+		uint8_t status = (words[0] >> 16) & 0xff;
+		uint8_t data1 = (words[0] >> 8) & 0x7f;
+		uint8_t data2 = words[0] & 0x7f;
+		switch (words[0] >> 28){
+			case 0x2:
+				return fromMidi1(status, data1, data2, group);
+			case 0x4:
+				break;
+			default:
+				return Event();
+		}
+		Event ev;
+		ev.group = group;
+		ev.channel = status & 0xf;
+		ev.note = data1;
+		ev.value = words[1];
+		switch (status >> 4){
+			case 0x0:	// registered per note controllers: not used
+				break;
+			case 0x1:
+				ev.kind = NOTECC;
+				ev.index = data2;
+				break;
+			case 0x2:
+			case 0x3:
+				ev.kind = ((status >> 4) == 0x2) ? RPN : NRPN;
+				ev.index = (data1 << 7) | data2;
+				break;
+			case 0x6:
+				ev.kind = NOTEBEND;
+				break;
+			case 0x8:
+				ev.kind = NOTEOFF;
+				ev.value = words[1] >> 16;
+				break;
+			case 0x9:// MIDI 2.0 velocity 0 is still a note on
+				ev.kind = NOTEON;
+				ev.value = std::max(words[1] >> 16, 1u);
+				break;
+			case 0xa:
+				ev.kind = POLYPRESS;
+				break;
+			case 0xb:
+				ev.kind = CC;
+				ev.index = data1;
+				break;
+			case 0xd:
+				ev.kind = CHPRESS;
+				break;
+			case 0xe:
+				ev.kind = PITCHBEND;
+				break;
+			default:
+				break;
+		}
+		return ev;
+	}
+	void reset(){
+		for (int i = 0; i < 16; i++) ccIn[i].reset();
+	}
+};
+
+/// Stand-in UMP source for testing without a MIDI 2.0 driver: a text file with one packet
+/// per line in hex words ("40903c00 c0000000"), "+ms" lines wait, # comments.
+/// Loaded on the ui thread, then played from process() by advance() / next().
+struct UMPfile {
+	struct Packet {
+		float ms;
+		uint32_t words[4];
+	};
+	std::vector<Packet> packets;
+	std::string name;
+	size_t pos = 0;
+	float clock = 0.f;
+
+	bool load(const std::string &path);
+	void rewind(){
+		pos = 0;
+		clock = 0.f;
+	}
+	void advance(float ms){
+		clock += ms;
+	}
+	/// next packet due, NULL if none
+	const uint32_t *next(){
+		if ((pos < packets.size()) && (packets[pos].ms <= clock)) return packets[pos++].words;
+		return NULL;
+	}
+	bool done() const {
+		return pos >= packets.size();
+	}
+};
+
+/// "Play UMP file..." menu entry: the loaded file waits in *pending for process(),
+/// which hands the replaced one back in *done for the ui to free
+struct UMPfileItem : MenuItem {
+	std::atomic<UMPfile *> *pending = NULL;
+	std::atomic<UMPfile *> *done = NULL;
+	void onAction(const event::Action &e) override;
+};
+
+/// Plugin-global MIDI device registry shared by all moDllz MIDI displays.
+/// Every driver is enumerated once per scan into a cache (gen moves on any change) and
+/// the subscribed displays are served from it: names, hot-plug reconnection of saved
+/// devices, driver/device stepping. Drivers are not thread safe, so scans and port
+/// changes run on the UI thread from the displays' step(), never in draw(): the thread
+/// only flags a rescan every half second and the first display stepping after it scans for all.
+/// Reference counted by subscriptions: the thread runs while a display is subscribed.
+struct MIDIwatcher {
+	struct Driver {
+		int id = -1;
+		std::string name;
+		std::vector<int> deviceIds;
+		std::vector<std::string> deviceNames;
+		bool same(const Driver &d) const {
+			return (id == d.id) && (name == d.name) && (deviceIds == d.deviceIds) && (deviceNames == d.deviceNames);
+		}
+	};
+	struct Client {
+		midi::Port *port = NULL;
+		/// display -> watcher
+		int action = -1;	// driver / device button: row * 2 + up
+		bool search = true;	// look for the saved device (or the first one)
+		bool fresh = true;	// new action or saved device, served without waiting for a scan
+		/// shared, valid for saving
+		int savedDriver = -1;
+		std::string savedDevice;
+		/// watcher -> display
+		bool changed = false;
+		bool disconnected = false;
+		bool restoreChannel = false;	// saved device found again
+		bool resetChannel = false;	// new device picked
+		std::string driverName;
+		std::string deviceName;
+		/// watcher side
+		unsigned int seenGen = 0;
+	};
+	std::mutex mutex;	// client list and thread state, never held across a scan
+	std::condition_variable wake;
+	std::thread thread;
+	std::vector<Client *> clients;
+	bool running = false;
+	std::atomic<bool> due;	// set by the thread, taken by the first display stepping
+	midi::Input *scanPort = NULL;	// lives while a display is subscribed
+	std::vector<Driver> drivers;	// cache, UI side
+	unsigned int gen = 0;	// moves when the cache changes
+
+	MIDIwatcher() : due(false) {
+	}
+	static MIDIwatcher &get();
+	~MIDIwatcher();
+	void subscribe(Client *client);
+	void unsubscribe(Client *client);
+	/// UI thread: rescans when due, then serves the client from the cache
+	void step(Client *client);
+private:
+	void run();
+	void scan();
+	const Driver *findDriver(int driverId) const;
+	std::string deviceName(int driverId, int deviceId) const;
+	void setPort(midi::Port *port, int driverId, int deviceId);
+	void stepDriver(midi::Port *port, bool valup);
+	bool stepDevice(midi::Port *port, bool valup);
+	void watch(Client *client);
+};
+
 struct MIDIdisplay : OpaqueWidget {
 	MIDIdisplay();
+	~MIDIdisplay();
 	midi::Port *midiInput = NULL;
 	int i_mpeChn = 0;
 	int *mpeChn = &i_mpeChn;
@@ -32,29 +378,40 @@ struct MIDIdisplay : OpaqueWidget {
 	int *mdriverJ = &initpointer_1;
 	int *mchannelJ = &initpointer_1;
 	int mchannelMem = -1;
+	int *mloadGenJ = &initpointer0;	// moved by the module's dataFromJson
+	int loadGenSeen = 0;
 	
 	bool *resetMidi = NULL;
 	bool showchannel = true;
 	bool isdevice = false;
-	bool searchdev = false;
+	bool disconnected = false;
+	MIDIwatcher::Client client;
+	bool watched = false;
 	std::string *mdeviceJ;
 	std::string mdriver = "initalizing";
 	std::string mdevice = "";
-	std::string mchannel = "";
+	DispText mchannel;
 	
 	int cursorId = 0;
 	float mdfontSize = 12.f;	
 	float xcenter = 0.f;
-	int drawframe = 0;
 	std::shared_ptr<Font> font;
 	NVGcolor textColor = nvgRGB(0x88,0x88,0x64);
 
 	void updateMidiSettings(int dRow, bool valup);
 	void reDisplay();
+	void step() override;
 	void draw(const DrawArgs &args) override;
 	void onButton(const event::Button &e) override;
 };
 
+/// midi activity flash over the cached MIDIdisplay
+struct MIDIactivity : TransparentWidget {
+	int initpointer0 = 0;
+	int *midiActiv = &initpointer0;
+	void draw(const DrawArgs &args) override;
+};
+
 struct DispBttnL : SvgSwitch {
 	DispBttnL();
 	MIDIdisplay *md = NULL;
@@ -81,6 +438,6 @@ struct MIDIscreen : OpaqueWidget{
 	DispBttnR *devR;
 	DispBttnR *chnR;
 	MIDIdisplay *md;
-	void setMidiPort(midi::Port *port,bool *mpeMode,int *mpeChn,int *midiActiv, int *mdriver, std::string *mdevice, int *mchannel, bool *resetMidi);
+	void setMidiPort(midi::Port *port,bool *mpeMode,int *mpeChn,int *midiActiv, int *mdriver, std::string *mdevice, int *mchannel, bool *resetMidi, int *mloadGen);
 };
 
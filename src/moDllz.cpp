@@ -22,7 +22,9 @@ Plugin *pluginInstance;
 
 void init(rack::Plugin *p) {
 	pluginInstance = p;
+	assetPreload();
 	p->addModel(modelMIDIpolyMPE);
+	p->addModel(modelMIDIpolySpill);
 	p->addModel(modelMIDIdualCV);
 	p->addModel(modelMIDIpoly16);
 	p->addModel(modelXBender);
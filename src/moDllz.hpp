@@ -21,11 +21,25 @@ along with this program.  If not, see <https:www.gnu.org/licenses/>.
 #include <list> // std::list
 #include <algorithm> // std::find
 #include <vector> // std::vector
+#include <atomic> // std::atomic
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <map> // std::map
+#include "assetDllz.hpp"
+#include "textDllz.hpp"
+#include "dispDllz.hpp"
 #include "midiDllz.hpp"
+#include "randomDllz.hpp"
+#include "arpDllz.hpp"
+#include "grooveDllz.hpp"
+#include "voiceDllz.hpp"
+#include "smoothDllz.hpp"
+#include "keysDllz.hpp"
 
-#define FONT_FILE asset::plugin(pluginInstance, "res/bold_led_board-7.ttf")
-//#define mFONT_FILE asset::plugin(pluginInstance, "res/ShareTechMono-Regular.ttf")
-#define mFONT_FILE asset::plugin(pluginInstance, "res/Gidolinya-Regular.ttf")
+#define FONT_FILE "res/bold_led_board-7.ttf"
+//#define mFONT_FILE "res/ShareTechMono-Regular.ttf"
+#define mFONT_FILE "res/Gidolinya-Regular.ttf"
 
 using namespace rack;
 
@@ -38,8 +52,15 @@ extern Model *modelMIDIdualCV;
 extern Model *modelMIDI8MPE;
 extern Model *modelMIDIpoly16;
 extern Model *modelMIDIpolyMPE;
+extern Model *modelMIDIpolySpill;
 //extern Model *modelPolyTune;
 
+/// Time based fade for flash lights (1 to 0 in fadeTime seconds),
+/// called from the light divider block with the block duration
+inline void fadeLight(engine::Light &light, float deltaTime, float fadeTime = 0.25f){
+	if (light.value > 0.f) light.value = std::max(light.value - deltaTime / fadeTime, 0.f);
+}
+
 ///////////////////////
 // custom components
 ///////////////////////
@@ -50,7 +71,7 @@ struct moDllzKnobM : SvgKnob {
 		// box.size = Vec(44, 44);
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzKnobM.svg")));
+		setSvg(pluginSvg("res/moDllzKnobM.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -63,7 +84,7 @@ struct moDllzKnob32 : SvgKnob {
 		// box.size = Vec(32, 32);
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzKnob32.svg")));
+		setSvg(pluginSvg("res/moDllzKnob32.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -75,7 +96,7 @@ struct moDllzKnob26 : SvgKnob {
 		// box.size = Vec(32, 32);
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzKnob26.svg")));
+		setSvg(pluginSvg("res/moDllzKnob26.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -87,7 +108,7 @@ struct moDllzKnob22 : SvgKnob {
 		//  box.size = Vec(32, 32);
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzKnob22.svg")));
+		setSvg(pluginSvg("res/moDllzKnob22.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -99,7 +120,7 @@ struct moDllzTTrim : SvgKnob {
 	moDllzTTrim() {
 		minAngle = -0.83*M_PI;
 		maxAngle = 0.83*M_PI;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzTTrim.svg")));
+		setSvg(pluginSvg("res/moDllzTTrim.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -121,7 +142,7 @@ struct moDllzSelector32 : SvgKnob {
 		minAngle = -0.85*M_PI;
 		maxAngle = 0.85*M_PI;
 		snap = true;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSnap32.svg")));
+		setSvg(pluginSvg("res/moDllzSnap32.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -134,7 +155,7 @@ struct moDllzSmSelector : SvgKnob{
 		minAngle = -0.5*M_PI;
 		maxAngle = 0.5*M_PI;
 		snap = true;
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSmSelector.svg")));
+		setSvg(pluginSvg("res/moDllzSmSelector.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -145,8 +166,8 @@ struct moDllzSmSelector : SvgKnob{
 struct moDllzSwitch : SvgSwitch {
 	moDllzSwitch() {
 		// box.size = Vec(10, 20);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitch_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitch_1.svg")));
+		addFrame(pluginSvg("res/moDllzSwitch_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitch_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -156,8 +177,8 @@ struct moDllzSwitch : SvgSwitch {
 struct moDllzSwitchH : SvgSwitch {
 	moDllzSwitchH() {
 		// box.size = Vec(20, 10);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchH_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchH_1.svg")));
+		addFrame(pluginSvg("res/moDllzSwitchH_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchH_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -167,8 +188,8 @@ struct moDllzSwitchH : SvgSwitch {
 struct moDllzSwitchLed : SvgSwitch {
 	moDllzSwitchLed() {
 		// box.size = Vec(10, 18);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLed_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLed_1.svg")));
+		addFrame(pluginSvg("res/moDllzSwitchLed_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchLed_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -178,8 +199,8 @@ struct moDllzSwitchLed : SvgSwitch {
 struct moDllzSwitchLedH : SvgSwitch {
 	moDllzSwitchLedH() {
 		// box.size = Vec(18, 10);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLedH_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLedH_1.svg")));
+		addFrame(pluginSvg("res/moDllzSwitchLedH_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchLedH_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -189,9 +210,9 @@ struct moDllzSwitchLedH : SvgSwitch {
 struct moDllzSwitchLedHT : SvgSwitch {
 	moDllzSwitchLedHT() {
 		// box.size = Vec(24, 10);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLedHT_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLedHT_1.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchLedHT_2.svg")));
+		addFrame(pluginSvg("res/moDllzSwitchLedHT_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchLedHT_1.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchLedHT_2.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -209,9 +230,9 @@ struct TranspOffRedLight : ModuleLightWidget {
 struct moDllzSwitchT : SvgSwitch {
 	moDllzSwitchT() {
 		//   box.size = Vec(10, 30);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchT_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchT_1.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchT_2.svg")));
+		addFrame(pluginSvg("res/moDllzSwitchT_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchT_1.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchT_2.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -222,9 +243,9 @@ struct moDllzSwitchT : SvgSwitch {
 struct moDllzSwitchTH : SvgSwitch {
 	moDllzSwitchTH() {
 		// box.size = Vec(30, 10);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchTH_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchTH_1.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzSwitchTH_2.svg")));
+		addFrame(pluginSvg("res/moDllzSwitchTH_0.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchTH_1.svg"));
+		addFrame(pluginSvg("res/moDllzSwitchTH_2.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -236,8 +257,8 @@ struct moDllzMoButton : SvgSwitch {
 	moDllzMoButton() {
 		momentary = true;
 		// box.size = Vec(48, 27);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzMoButton_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzMoButton_1.svg")));
+		addFrame(pluginSvg("res/moDllzMoButton_0.svg"));
+		addFrame(pluginSvg("res/moDllzMoButton_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -249,7 +270,7 @@ struct moDllzClearButton : SvgSwitch {
 	moDllzClearButton() {
 		momentary = true;
 		// box.size = Vec(38, 13);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzClearButton.svg")));
+		addFrame(pluginSvg("res/moDllzClearButton.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -261,7 +282,7 @@ struct moDllzRoundButton : SvgSwitch {
 	moDllzRoundButton() {
 		momentary = true;
 		// box.size = Vec(14, 14);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzRoundButton.svg")));
+		addFrame(pluginSvg("res/moDllzRoundButton.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -273,7 +294,7 @@ struct moDllzPulseUp : SvgSwitch {
 	moDllzPulseUp() {
 		momentary = true;
 		// box.size = Vec(12, 12);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzPulse2Up.svg")));
+		addFrame(pluginSvg("res/moDllzPulse2Up.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -284,7 +305,7 @@ struct moDllzPulseDwn : SvgSwitch {
 	moDllzPulseDwn() {
 		momentary = true;
 		// box.size = Vec(12, 12);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzPulse2Dwn.svg")));
+		addFrame(pluginSvg("res/moDllzPulse2Dwn.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -296,7 +317,7 @@ struct moDllzMuteG : SvgSwitch {
 	moDllzMuteG() {
 		momentary = true;
 		// box.size = Vec(67, 12);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzMuteG.svg")));
+		addFrame(pluginSvg("res/moDllzMuteG.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -307,7 +328,7 @@ struct moDllzMuteGP : SvgSwitch {
 	moDllzMuteGP() {
 		momentary = true;
 		// box.size = Vec(26, 11);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzMuteGP.svg")));
+		addFrame(pluginSvg("res/moDllzMuteGP.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -318,7 +339,7 @@ struct moDllzMidiPanic : SvgSwitch {
 	moDllzMidiPanic() {
 		momentary = true;
 		// box.size = Vec(38, 12);
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/midireset3812.svg")));
+		addFrame(pluginSvg("res/midireset3812.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -329,8 +350,8 @@ struct moDllzMidiPanic : SvgSwitch {
 struct moDllzcursorL : SvgSwitch {
 	moDllzcursorL() {
 		momentary = true;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/cursorL_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/cursorL_1.svg")));
+		addFrame(pluginSvg("res/cursorL_0.svg"));
+		addFrame(pluginSvg("res/cursorL_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -339,8 +360,8 @@ struct moDllzcursorL : SvgSwitch {
 struct moDllzcursorR : SvgSwitch {
 	moDllzcursorR() {
 		momentary = true;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/cursorR_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/cursorR_1.svg")));
+		addFrame(pluginSvg("res/cursorR_0.svg"));
+		addFrame(pluginSvg("res/cursorR_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -350,8 +371,8 @@ struct moDllzcursorR : SvgSwitch {
 struct minusButton : SvgSwitch {
 	minusButton() {
 		momentary = true;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/minusButton_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/minusButton_1.svg")));
+		addFrame(pluginSvg("res/minusButton_0.svg"));
+		addFrame(pluginSvg("res/minusButton_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -360,8 +381,8 @@ struct minusButton : SvgSwitch {
 struct plusButton : SvgSwitch {
 	plusButton() {
 		momentary = true;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/plusButton_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/plusButton_1.svg")));
+		addFrame(pluginSvg("res/plusButton_0.svg"));
+		addFrame(pluginSvg("res/plusButton_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -370,8 +391,8 @@ struct plusButton : SvgSwitch {
 struct minusButtonB : SvgSwitch {
 	minusButtonB() {
 		momentary = true;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SqrMinus_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SqrMinus_1.svg")));
+		addFrame(pluginSvg("res/SqrMinus_0.svg"));
+		addFrame(pluginSvg("res/SqrMinus_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -380,8 +401,8 @@ struct minusButtonB : SvgSwitch {
 struct plusButtonB : SvgSwitch {
 	plusButtonB() {
 		momentary = true;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SqrPlus_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/SqrPlus_1.svg")));
+		addFrame(pluginSvg("res/SqrPlus_0.svg"));
+		addFrame(pluginSvg("res/SqrPlus_1.svg"));
 		shadow->opacity = 0.f;
 	}
 	void randomize() override{
@@ -391,28 +412,83 @@ struct plusButtonB : SvgSwitch {
 ///Jacks
 struct moDllzPort : SvgPort {
 		moDllzPort() {
-			setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzPort.svg")));
+			setSvg(pluginSvg("res/moDllzPort.svg"));
 			shadow->opacity = 0.f;
 		}
 };
 struct moDllzPortDark : SvgPort {
 	moDllzPortDark() {
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzPortDark.svg")));
+		setSvg(pluginSvg("res/moDllzPortDark.svg"));
 		shadow->opacity = 0.f;
 	}
 };
 
 struct moDllzPortPoly : SvgPort {
 	moDllzPortPoly() {
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzPort16.svg")));
+		setSvg(pluginSvg("res/moDllzPort16.svg"));
 		shadow->opacity = 0.f;
 	}
 };
 
 struct moDllzPortG : SvgPort {
 	moDllzPortG() {
-		setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/moDllzPortG.svg")));
+		setSvg(pluginSvg("res/moDllzPortG.svg"));
 		shadow->opacity = 0.f;
 	}
 };
 
+
+///Menu item Reproducible drift (module with reproDrift + seedDrift())
+template <class TModule>
+struct ReproDriftItem : MenuItem {
+	TModule *module;
+	void onAction(const event::Action &e) override {
+		module->reproDrift = !module->reproDrift;
+		module->seedDrift();
+	}
+};
+
+template <class TModule>
+struct DriftSeedRollItem : MenuItem {
+	TModule *module;
+	void onAction(const event::Action &e) override {
+		uint32_t seed = random::u32();
+		module->driftSeed = seed ? seed : 1;
+		module->seedDrift();
+	}
+};
+
+/// typed drift seed, Enter sets it and closes the menu
+template <class TModule>
+struct DriftSeedField : ui::TextField {
+	TModule *module;
+	void onAction(const event::Action &e) override {
+		uint32_t seed = static_cast<uint32_t>(std::strtoul(text.c_str(), NULL, 10));
+		if (seed > 0){
+			module->driftSeed = seed;
+			module->seedDrift();
+		}
+		ui::MenuOverlay *overlay = getAncestorOfType<ui::MenuOverlay>();
+		if (overlay) overlay->requestDelete();
+		e.consume(this);
+	}
+};
+
+///Menu item drift seed (module with driftSeed + seedDrift()): new random or typed seed
+template <class TModule>
+struct DriftSeedItem : MenuItem {
+	TModule *module;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		DriftSeedRollItem<TModule> *rollItem = createMenuItem<DriftSeedRollItem<TModule>>("New random seed");
+		rollItem->module = module;
+		menu->addChild(rollItem);
+		menu->addChild(createMenuLabel("Type a seed (Enter):"));
+		DriftSeedField<TModule> *seedField = new DriftSeedField<TModule>;
+		seedField->module = module;
+		seedField->box.size.x = 120.f;
+		seedField->text = std::to_string(module->driftSeed);
+		menu->addChild(seedField);
+		return menu;
+	}
+};
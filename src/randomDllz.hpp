@@ -0,0 +1,92 @@
+/*
+randomDllz.hpp Per-module random source and drift noise
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// xoroshiro128+ owned by each module (no global lock, no shared state between engine threads)
+struct DllzRandom {
+	uint64_t s[2] = {0x9E3779B97F4A7C15ULL, 0xD1B54A32D192ED03ULL};
+
+	void seed(uint64_t seedval){
+		// splitmix64 to spread the seed over the state
+		for (int i = 0; i < 2; i++){
+			seedval += 0x9E3779B97F4A7C15ULL;
+			uint64_t z = seedval;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			s[i] = z ^ (z >> 31);
+		}
+	}
+	uint64_t next(){
+		uint64_t s0 = s[0];
+		uint64_t s1 = s[1];
+		uint64_t result = s0 + s1;
+		s1 ^= s0;
+		s[0] = ((s0 << 55) | (s0 >> 9)) ^ s1 ^ (s1 << 14);
+		s[1] = (s1 << 36) | (s1 >> 28);
+		return result;
+	}
+	uint32_t u32(){
+		return static_cast<uint32_t>(next() >> 32);
+	}
+	/// 0 ~ 1
+	float uniform(){
+		return static_cast<float>(next() >> 40) * (1.f / 16777216.f);
+	}
+	/// -1 ~ 1
+	float bipolar(){
+		return uniform() * 2.f - 1.f;
+	}
+};
+
+/// Reproducible drift seed of a module instance, 0 until the module is first added.
+/// On add, new instances and duplicates (seed saved for another module id) get one from their
+/// id, so modules of a type don't drift alike; patches keep theirs (owner -1: older patches).
+inline void dllzClaimSeed(uint32_t &seed, int &owner, int id){
+	if ((seed == 0) || ((owner > -1) && (owner != id))){
+		DllzRandom idRng;
+		idRng.seed(static_cast<uint64_t>(id) + 1);
+		seed = idRng.u32();
+		if (seed == 0) seed = 1;
+	}
+	owner = id;
+}
+
+/// Smoothed value noise read from a table filled once per seed
+struct DriftTable {
+	static const int tableSize = 256; // power of 2
+	float points[tableSize] = {0.f};
+
+	void fill(DllzRandom &rng){
+		for (int i = 0; i < tableSize; i++)
+			points[i] = rng.bipolar();
+	}
+	/// pos in table points (wraps), smoothstep between points
+	float at(float pos) const {
+		int i0 = static_cast<int>(pos);
+		float f = pos - static_cast<float>(i0);
+		f = f * f * (3.f - 2.f * f);
+		i0 &= tableSize - 1;
+		int i1 = (i0 + 1) & (tableSize - 1);
+		return points[i0] + (points[i1] - points[i0]) * f;
+	}
+	/// keep phase inside the table
+	static float wrap(float pos){
+		if (pos >= static_cast<float>(tableSize)) pos -= static_cast<float>(tableSize);
+		return pos;
+	}
+};
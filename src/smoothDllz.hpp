@@ -0,0 +1,155 @@
+/*
+smoothDllz.hpp Output smoothing
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// Smoothing of one destination group (bend, MPE Y Z, CCs...): mode and time from the
+/// context menu, coefficients computed on sample rate or setting changes only.
+/// One pole 10 ms is the fixed 100 / sampleRate lambda the modules used before.
+struct SmoothShape {
+	enum Mode {
+		OFF,
+		ONEPOLE,
+		TWOPOLE,	// two one poles in a row, critically damped
+		RAMP,	// linear to the target in ms
+		NUM_MODES
+	};
+	int mode = ONEPOLE;
+	float ms = 10.f;
+	float sampleRate = 44100.f;
+	float a = 1.f;	// pole coefficient (each stage for TWOPOLE)
+	float rampInv = 1.f;	// 1 / ramp samples
+
+	void update(){
+		float samples = std::max(ms * 0.001f * sampleRate, 1.f);
+		a = 1.f - std::exp(-1.f / ((mode == TWOPOLE) ? samples * 0.5f : samples));
+		rampInv = 1.f / samples;
+	}
+	void setSampleRate(float sr){
+		sampleRate = sr;
+		update();
+	}
+	void set(int newMode, float newMs){
+		mode = newMode;
+		ms = newMs;
+		update();
+	}
+	std::string label() const {
+		const std::string modeNames[NUM_MODES] = {"off", "1 pole", "2 pole", "ramp"};
+		if (mode == OFF) return modeNames[OFF];
+		return modeNames[mode] + " " + std::to_string(static_cast<int>(ms)) + " ms";
+	}
+	json_t *toJson() const {
+		json_t *rootJ = json_object();
+		json_object_set_new(rootJ, "mode", json_integer(mode));
+		json_object_set_new(rootJ, "ms", json_real(ms));
+		return rootJ;
+	}
+	void fromJson(json_t *rootJ){
+		if (!rootJ) return;
+		json_t *modeJ = json_object_get(rootJ, "mode");
+		if (modeJ) mode = clamp(static_cast<int>(json_integer_value(modeJ)), 0, NUM_MODES - 1);
+		json_t *msJ = json_object_get(rootJ, "ms");
+		if (msJ) ms = clamp(static_cast<float>(json_number_value(msJ)), 0.f, 1000.f);
+		update();
+	}
+};
+
+/// One smoothed value. At rest (output on the target) process() is a compare.
+struct Smoother {
+	float out = 0.f;
+	float stage = 0.f;
+	float target = 0.f;
+	float step = 0.f;
+	bool resting = true;
+
+	float process(const SmoothShape &shape, float in){
+		if (resting && (in == target)) return out;
+		switch (shape.mode){
+			case SmoothShape::ONEPOLE:
+				out += (in - out) * shape.a;
+				stage = out;
+				break;
+			case SmoothShape::TWOPOLE:
+				stage += (in - stage) * shape.a;
+				out += (stage - out) * shape.a;
+				break;
+			case SmoothShape::RAMP:
+				if (resting || (in != target)) step = (in - out) * shape.rampInv;
+				out += step;
+				if ((step >= 0.f) ? (out > in) : (out < in)) out = in;
+				stage = out;
+				break;
+			default:
+				out = in;
+				stage = in;
+				break;
+		}
+		target = in;
+		resting = (std::fabs(in - out) < 1e-5f) && (std::fabs(in - stage) < 1e-5f);
+		if (resting) out = stage = in;
+		return out;
+	}
+	void reset(float value = 0.f){
+		out = value;
+		stage = value;
+		target = value;
+		step = 0.f;
+		resting = true;
+	}
+};
+
+struct SmoothSetItem : MenuItem {
+	SmoothShape *shape;
+	int mode;
+	float ms;
+	void onAction(const event::Action &e) override {
+		shape->set(mode, ms);
+	}
+};
+
+/// "Destination: setting" menu entry, the child menu picks mode and time
+struct SmoothItem : MenuItem {
+	SmoothShape *shape;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		const std::string modeNames[SmoothShape::NUM_MODES] = {"Off", "One pole", "Two pole (critically damped)", "Linear ramp"};
+		for (int i = 0; i < SmoothShape::NUM_MODES; i++){
+			SmoothSetItem *modeItem = createMenuItem<SmoothSetItem>(modeNames[i], CHECKMARK(shape->mode == i));
+			modeItem->shape = shape;
+			modeItem->mode = i;
+			modeItem->ms = shape->ms;
+			menu->addChild(modeItem);
+		}
+		menu->addChild(new MenuEntry);
+		const float times[7] = {1.f, 2.f, 5.f, 10.f, 20.f, 50.f, 100.f};
+		for (int i = 0; i < 7; i++){
+			SmoothSetItem *timeItem = createMenuItem<SmoothSetItem>(std::to_string(static_cast<int>(times[i])) + " ms", CHECKMARK(shape->ms == times[i]));
+			timeItem->shape = shape;
+			timeItem->mode = (shape->mode == SmoothShape::OFF) ? SmoothShape::ONEPOLE : shape->mode;
+			timeItem->ms = times[i];
+			menu->addChild(timeItem);
+		}
+		return menu;
+	}
+};
+
+inline SmoothItem *createSmoothItem(std::string destination, SmoothShape *shape){
+	SmoothItem *item = createMenuItem<SmoothItem>(destination + ": " + shape->label(), RIGHT_ARROW);
+	item->shape = shape;
+	return item;
+}
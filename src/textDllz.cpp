@@ -0,0 +1,72 @@
+/*
+textDllz.cpp Display text without heap allocation
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+#include "moDllz.hpp"
+
+/// tables built once at load
+struct DllzTextTables {
+	char noteNames[128][5];
+	char numbers[1000][4];
+	DllzTextTables(){
+		const char *names[12] = {"C","C#","D","Eb","E","F","F#","G","Ab","A","Bb","B"};
+		for (int i = 0; i < 128; i++){
+			int octave = i / 12 - 2;
+			int c = 0;
+			for (const char *n = names[i % 12]; *n; n++) noteNames[i][c++] = *n;
+			if (octave < 0) {
+				noteNames[i][c++] = '-';
+				octave = -octave;
+			}
+			noteNames[i][c++] = static_cast<char>('0' + octave);
+			noteNames[i][c] = 0;
+		}
+		for (int i = 0; i < 1000; i++){
+			int c = 0;
+			if (i > 99) numbers[i][c++] = static_cast<char>('0' + i / 100);
+			if (i > 9) numbers[i][c++] = static_cast<char>('0' + (i / 10) % 10);
+			numbers[i][c++] = static_cast<char>('0' + i % 10);
+			numbers[i][c] = 0;
+		}
+	}
+};
+static const DllzTextTables textTables;
+///////////////////////////////////////////////////////////////////////////////////////
+const char *dllzNoteName(int note){
+	return textTables.noteNames[note & 0x7f];
+}
+///////////////////////////////////////////////////////////////////////////////////////
+const char *dllzNumber(int value){
+	return textTables.numbers[clamp(value, 0, 999)];
+}
+///////////////////////////////////////////////////////////////////////////////////////
+DispText &DispText::add(int value){
+	if (value < 0) {
+		add('-');
+		value = -value;
+	}
+	if (value < 1000) return add(dllzNumber(value));
+	char digits[12];
+	int n = 0;
+	while (value > 0) {
+		digits[n++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	}
+	while (n > 0) add(digits[--n]);
+	return *this;
+}
@@ -0,0 +1,72 @@
+/*
+textDllz.hpp Display text without heap allocation
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// note names "C-2" ~ "G8" (0 ~ 127)
+const char *dllzNoteName(int note);
+/// "0" ~ "999" from table
+const char *dllzNumber(int value);
+
+/// Fixed buffer text for displays, built in place (no std::string per frame)
+struct DispText {
+	static const int maxLen = 47;
+	char str[maxLen + 1];
+	int len = 0;
+
+	DispText(){
+		str[0] = 0;
+	}
+	DispText(const char *text){
+		set(text);
+	}
+	const char *c_str() const {
+		return str;
+	}
+	bool empty() const {
+		return len == 0;
+	}
+	DispText &clear(){
+		len = 0;
+		str[0] = 0;
+		return *this;
+	}
+	DispText &set(const char *text){
+		clear();
+		return add(text);
+	}
+	DispText &add(const char *text){
+		while ((*text) && (len < maxLen)) str[len++] = *text++;
+		str[len] = 0;
+		return *this;
+	}
+	DispText &add(char c){
+		if (len < maxLen) str[len++] = c;
+		str[len] = 0;
+		return *this;
+	}
+	/// decimal
+	DispText &add(int value);
+	/// decimal with + on positives
+	DispText &addSigned(int value){
+		if (value > 0) add('+');
+		return add(value);
+	}
+	DispText &addNote(int note){
+		return add(dllzNoteName(note));
+	}
+};
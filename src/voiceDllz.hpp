@@ -0,0 +1,212 @@
+/*
+voiceDllz.hpp Voice allocation
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+
+/// bool per voice kept as a bitmask: gates[i] = x and if (gates[i]) read like the bool arrays
+/// they replace, mask is there for the allocator without scanning the voices
+struct VoiceFlags {
+	uint64_t mask = 0;
+	struct Ref {
+		uint64_t &mask;
+		uint64_t bit;
+		operator bool() const {
+			return mask & bit;
+		}
+		Ref &operator=(bool on){
+			if (on) mask |= bit;
+			else mask &= ~bit;
+			return *this;
+		}
+		Ref &operator=(const Ref &r){
+			return *this = static_cast<bool>(r);
+		}
+	};
+	Ref operator[](int i){
+		return Ref{mask, 1ull << i};
+	}
+	bool operator[](int i) const {
+		return mask & (1ull << i);
+	}
+};
+
+/// Round robin stealing: the next usable voice after the last free or stolen one
+struct StealRotate {
+	template <class TAllocator>
+	int pickFree(TAllocator &alloc, uint64_t free, int from){
+		return alloc.nextIn(free, from);
+	}
+	template <class TAllocator>
+	int pick(TAllocator &alloc, uint64_t voices){
+		return alloc.nextIn(voices, alloc.stealIndex);
+	}
+	void reset(){
+	}
+};
+
+/// Stealing by voice priority, mode picked at runtime (context menu).
+/// The module reports note on / off per voice and sets held (key down voices, the rest of busy
+/// is sustained by the pedal). Ages are event stamps compared as clock - stamp so they survive
+/// the wrap. Priorities move with every note and pressure change while steals are rare, so they
+/// are compared over the busy mask when a steal happens instead of being kept sorted.
+struct StealPriority {
+	enum Mode {
+		ROTATE,
+		OLDEST,
+		QUIETEST,	// lowest level (velocity or current pressure), then oldest
+		RELEASED,	// pedal sustained voices first, oldest release first, free voices too
+		NUM_MODES
+	};
+	int mode = ROTATE;
+	bool keepLowest = false;	// never steal the lowest / highest sounding note
+	bool keepHighest = false;
+	uint64_t held = 0;
+	uint32_t clock = 0;
+	uint32_t started[64] = {0};
+	uint32_t released[64] = {0};
+	uint8_t notes[64] = {0};
+	uint8_t levels[64] = {0};
+
+	void noteOn(int voice, uint8_t note, uint8_t level){
+		started[voice] = ++clock;
+		notes[voice] = note;
+		levels[voice] = level;
+	}
+	/// key up, or pedal up for a sustained voice: the release tail starts
+	void noteOff(int voice){
+		released[voice] = ++clock;
+	}
+	/// voice of mask with the largest clock - stamp
+	int oldest(uint64_t mask, const uint32_t *stamps) const {
+		int voice = -1;
+		uint32_t age = 0;
+		for (uint64_t m = mask; m; m &= m - 1){
+			int i = __builtin_ctzll(m);
+			if ((voice < 0) || (clock - stamps[i] > age)){
+				voice = i;
+				age = clock - stamps[i];
+			}
+		}
+		return voice;
+	}
+	int quietest(uint64_t mask) const {
+		int voice = -1;
+		for (uint64_t m = mask; m; m &= m - 1){
+			int i = __builtin_ctzll(m);
+			if ((voice < 0) || (levels[i] < levels[voice]) || ((levels[i] == levels[voice]) && (clock - started[i] > clock - started[voice])))
+				voice = i;
+		}
+		return voice;
+	}
+	/// voices of mask but the protected lowest / highest notes (all of mask if nothing is left)
+	uint64_t unprotected(uint64_t mask) const {
+		if (!(keepLowest || keepHighest)) return mask;
+		int low = -1;
+		int high = -1;
+		for (uint64_t m = mask; m; m &= m - 1){
+			int i = __builtin_ctzll(m);
+			if ((low < 0) || (notes[i] < notes[low])) low = i;
+			if ((high < 0) || (notes[i] > notes[high])) high = i;
+		}
+		uint64_t keep = 0;
+		if (keepLowest) keep |= 1ull << low;
+		if (keepHighest) keep |= 1ull << high;
+		return (mask & ~keep) ? (mask & ~keep) : mask;
+	}
+	template <class TAllocator>
+	int pickFree(TAllocator &alloc, uint64_t free, int from){
+		if (mode == RELEASED) return oldest(free, released);
+		return alloc.nextIn(free, from);
+	}
+	template <class TAllocator>
+	int pick(TAllocator &alloc, uint64_t voices){
+		voices = unprotected(voices);
+		switch (mode){
+			case OLDEST:
+				return oldest(voices, started);
+			case QUIETEST:
+				return quietest(voices);
+			case RELEASED:{
+				uint64_t sustained = voices & ~held;
+				return (sustained) ? oldest(sustained, released) : oldest(voices, started);
+			}
+			default:
+				return alloc.nextIn(voices, alloc.stealIndex);
+		}
+	}
+	void reset(){
+		held = 0;
+		for (int i = 0; i < 64; i++){
+			started[i] = clock;
+			released[i] = clock;
+		}
+	}
+};
+
+/// Voice allocator on bitmasks (up to 64 voices), shared by the poly modules.
+/// allocate() takes the busy voices (gate or pedal) and an optional usable mask,
+/// TPolicy picks the free voice (round robin: the one after "from", one count-trailing-zeros)
+/// and the one to steal when all are busy. The module keeps the note data, the allocator
+/// only chooses the index.
+template <int maxVoices, class TPolicy = StealRotate>
+struct VoiceAllocator {
+	static_assert(maxVoices <= 64, "voice masks are 64 bit");
+	int numVoices = maxVoices;
+	int stealIndex = 0;	// last allocated voice, rotation point for stealing
+	TPolicy policy;
+
+	uint64_t voicesMask() const {
+		return (numVoices >= 64) ? ~0ull : ((1ull << numVoices) - 1ull);
+	}
+	/// first voice of mask after index, wrapping (index < 0: from the first), -1 if mask is empty
+	static int nextIn(uint64_t mask, int index){
+		if (!mask) return -1;
+		uint64_t after = (index < 0) ? mask : (index >= 63) ? 0ull : (mask & (~0ull << (index + 1)));
+		return __builtin_ctzll(after ? after : mask);
+	}
+	/// free voice after from, or the one the policy steals (stolen set), -1 if no voice is usable
+	int allocate(uint64_t busy, int from, bool &stolen, uint64_t usable = ~0ull){
+		uint64_t voices = voicesMask() & usable;
+		int voice = (voices & ~busy) ? policy.pickFree(*this, voices & ~busy, from) : -1;
+		stolen = (voice < 0) && (voices != 0);
+		if (stolen) voice = policy.pick(*this, voices);
+		if (voice > -1) stealIndex = voice;
+		return voice;
+	}
+	void reset(){
+		stealIndex = 0;
+		policy.reset();
+	}
+};
+
+/// Poly cable groups 2 and 3 (voices 17 ~ 48) of a module with more than 16 voices, sent to
+/// the spill expander on its right as a Rack expander message (one block late).
+/// Output order follows the module's poly outputs.
+struct VoiceSpill {
+	static const int groups = 2;
+	enum Outs {
+		X,
+		Y,
+		Z,
+		VEL,
+		RVEL,
+		GATE,
+		NUM_OUTS
+	};
+	int channels[groups] = {0};
+	float voltages[groups][NUM_OUTS][16] = {{{0.f}}};
+};
@@ -0,0 +1,305 @@
+/*
+voice_alloc_test.cpp Randomized property tests of voiceDllz.hpp (make test)
+
+Copyright (C) 2019 Pablo Delaloza.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https:www.gnu.org/licenses/>.
+*/
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include "../src/voiceDllz.hpp"
+
+/// The allocator against the loops the modules used before it (MIDIpolyMPE / MIDI8MPE
+/// getPolyIndex and the MIDIpoly16 pad search), on random gate / pedal sequences.
+/// Voice counts go up to 64 for the masks the spill expander needs.
+
+static int failures = 0;
+#define CHECK(cond, ...) do { if (!(cond)) { failures ++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static std::mt19937 rng(7);
+static int rnd(int n){
+	return static_cast<int>(rng() % static_cast<uint32_t>(n));
+}
+
+/// MIDIpolyMPE getPolyIndex before the allocator: next free voice after nowIndex
+/// (-1: from the first), else steal the one after the last stolen
+struct RefPoly {
+	bool gates[64] = {false};
+	bool pedals[64] = {false};
+	int stealIndex = 0;
+	int numVo = 8;
+	int get(int nowIndex, bool &stolen){
+		for (int i = 0; i < numVo; i++){
+			nowIndex ++;
+			if (nowIndex > numVo - 1) nowIndex = 0;
+			if (!(gates[nowIndex] || pedals[nowIndex])){
+				stealIndex = nowIndex;
+				stolen = false;
+				return nowIndex;
+			}
+		}
+		stealIndex ++;
+		if (stealIndex > numVo - 1) stealIndex = 0;
+		stolen = true;
+		return stealIndex;
+	}
+};
+
+/// rotate (from the last voice), reuse (rotate when the note is not playing) and reset (from
+/// the first) all end in allocate(busy, from): each mode drives its own from
+static void testPolyModes(){
+	for (int run = 0; run < 3000; run ++){
+		RefPoly ref;
+		VoiceFlags gates, pedals;
+		VoiceAllocator<64> alloc;
+		ref.numVo = alloc.numVoices = 1 + rnd(64);
+		int mode = rnd(3);	// 0 rotate, 1 reuse, 2 reset
+		int notes[64] = {0};
+		int index = 0;
+		for (int k = 0; k < 300; k ++){
+			int v = rnd(ref.numVo);
+			bool g = rnd(2);
+			bool p = (rnd(4) == 0);
+			ref.gates[v] = g;
+			gates[v] = g;
+			ref.pedals[v] = p;
+			pedals[v] = p;
+			int note = rnd(24);
+			int reuse = -1;
+			if (mode == 1){
+				for (int i = 0; i < ref.numVo; i ++) if (notes[i] == note){
+					reuse = i;
+					break;
+				}
+			}
+			if (reuse > -1){
+				index = reuse;
+				continue;
+			}
+			int from = (mode == 2) ? -1 : index;
+			bool refStolen = false;
+			bool stolen = false;
+			int refVoice = ref.get(from, refStolen);
+			int voice = alloc.allocate(gates.mask | pedals.mask, from, stolen);
+			CHECK((voice == refVoice) && (stolen == refStolen), "mode %d voices %d step %d: %d%s vs ref %d%s",
+				mode, ref.numVo, k, voice, stolen ? " stolen" : "", refVoice, refStolen ? " stolen" : "");
+			if (voice != refVoice) return;
+			index = voice;
+			notes[voice] = note;
+			if (rnd(30) == 0) ref.numVo = alloc.numVoices = 1 + rnd(64);
+		}
+	}
+}
+
+/// MIDIpoly16 pad search before the allocator: poly pads only, free after polyIndex, else
+/// the one after the last pad taken
+struct Pad {
+	bool poly;
+	bool gate;
+};
+struct RefPads {
+	Pad pads[16];
+	int polyIndex = 0;
+	int top = 15;
+	int last = 0;
+	void set(int mode){
+		if (mode < 1) polyIndex ++;
+		else if (mode > 1) polyIndex = 0;
+		int ii = polyIndex;
+		for (int i = 0; i < top + 1; i ++){
+			if (ii > top) ii = 0;
+			if (pads[ii].poly && !pads[ii].gate){
+				last = ii;
+				polyIndex = ii;
+				return;
+			}
+			ii ++;
+		}
+		last ++;
+		ii = last;
+		for (int i = 0; i < top + 1; i ++){
+			if (ii > top) ii = 0;
+			if (pads[ii].poly){
+				last = ii;
+				polyIndex = ii;
+				return;
+			}
+			ii ++;
+		}
+	}
+};
+
+static void testPads(){
+	for (int run = 0; run < 3000; run ++){
+		RefPads ref;
+		Pad pads[16];
+		VoiceAllocator<16> alloc;
+		int polyIndex = 0;
+		ref.top = rnd(16);
+		bool anyPoly = false;
+		for (int i = 0; i < 16; i ++){
+			pads[i] = Pad{rnd(3) != 0, false};
+			ref.pads[i] = pads[i];
+			anyPoly |= (pads[i].poly && (i <= ref.top));
+		}
+		if (!anyPoly) continue;
+		for (int k = 0; k < 300; k ++){
+			int v = rnd(16);
+			bool g = rnd(2);
+			pads[v].gate = g;
+			ref.pads[v].gate = g;
+			int mode = rnd(3);
+			ref.set(mode);
+			int from = polyIndex - 1;
+			if (mode < 1) from = polyIndex;
+			else if (mode > 1) from = -1;
+			uint64_t poly = 0;
+			uint64_t gated = 0;
+			for (int i = 0; i < 16; i ++){
+				if (pads[i].poly) poly |= 1ull << i;
+				if (pads[i].gate) gated |= 1ull << i;
+			}
+			alloc.numVoices = ref.top + 1;
+			bool stolen = false;
+			int pad = alloc.allocate(gated, from, stolen, poly);
+			if (pad > -1) polyIndex = pad;
+			CHECK(polyIndex == ref.polyIndex, "pads top %d step %d: %d vs ref %d", ref.top, k, polyIndex, ref.polyIndex);
+			if (polyIndex != ref.polyIndex) return;
+		}
+	}
+}
+
+/// edges of the 64-bit masks
+static void testMasks(){
+	VoiceAllocator<64> alloc;
+	alloc.numVoices = 16;
+	CHECK(alloc.voicesMask() == 0xffffull, "voicesMask 16");
+	alloc.numVoices = 48;
+	CHECK(alloc.voicesMask() == 0xffffffffffffull, "voicesMask 48");
+	alloc.numVoices = 64;
+	CHECK(alloc.voicesMask() == ~0ull, "voicesMask 64");
+	uint64_t top = 1ull << 63;
+	CHECK(VoiceAllocator<64>::nextIn(top, 62) == 63, "nextIn reaches voice 63");
+	CHECK(VoiceAllocator<64>::nextIn(top | 1ull, 63) == 0, "nextIn wraps after 63");
+	CHECK(VoiceAllocator<64>::nextIn(top, 63) == 63, "nextIn 63 only");
+	CHECK(VoiceAllocator<64>::nextIn(top, -1) == 63, "nextIn from the first");
+	CHECK(VoiceAllocator<64>::nextIn(0, 5) == -1, "nextIn empty");
+	VoiceFlags flags;
+	flags[63] = true;
+	flags[47] = true;
+	CHECK(flags.mask == (top | (1ull << 47)), "VoiceFlags high bits");
+	CHECK(flags[63] && !flags[62], "VoiceFlags read");
+	flags[63] = false;
+	CHECK(flags.mask == (1ull << 47), "VoiceFlags clear 63");
+	/// all 48 busy: the steal rotates over 0 ~ 47 only
+	alloc.numVoices = 48;
+	alloc.reset();
+	bool stolen = false;
+	for (int i = 0; i < 100; i ++){
+		int voice = alloc.allocate(~0ull, -1, stolen);
+		CHECK(stolen && (voice == (i + 1) % 48), "48 voice steal %d got %d", i, voice);
+	}
+	/// a usable mask with nothing in range
+	CHECK(alloc.allocate(0, -1, stolen, 1ull << 50) == -1, "no usable voice");
+}
+
+/// priority stealing: the victim against a plain scan of the stamps
+static void testPriority(){
+	for (int run = 0; run < 2000; run ++){
+		VoiceAllocator<64, StealPriority> alloc;
+		StealPriority &policy = alloc.policy;
+		alloc.numVoices = 1 + rnd(64);
+		policy.mode = rnd(StealPriority::NUM_MODES);
+		policy.keepLowest = rnd(2);
+		policy.keepHighest = rnd(2);
+		alloc.reset();
+		uint64_t gates = 0;
+		uint64_t pedals = 0;
+		int n = alloc.numVoices;
+		for (int k = 0; k < 300; k ++){
+			int v = rnd(n);
+			if (rnd(2)){
+				policy.noteOn(v, static_cast<uint8_t>(rnd(128)), static_cast<uint8_t>(rnd(128)));
+				gates |= 1ull << v;
+			}else if (gates & (1ull << v)){
+				gates &= ~(1ull << v);
+				if (rnd(3) == 0) pedals |= 1ull << v;
+				else policy.noteOff(v);
+			}
+			if (rnd(10) == 0){
+				for (int i = 0; i < n; i ++) if ((pedals >> i) & 1ull) policy.noteOff(i);
+				pedals = 0;
+			}
+			policy.held = gates;
+			uint64_t busy = gates | pedals;
+			bool stolen = false;
+			int voice = alloc.allocate(busy, alloc.stealIndex, stolen);
+			uint64_t voices = alloc.voicesMask();
+			CHECK((voice >= 0) && (voice < n), "priority voice %d of %d", voice, n);
+			CHECK(stolen == ((voices & ~busy) == 0), "stolen only when all are busy");
+			if (!stolen){
+				CHECK(!((busy >> voice) & 1ull), "free pick %d is busy", voice);
+				continue;
+			}
+			/// protected notes are not stolen while another voice is there
+			int low = -1;
+			int high = -1;
+			for (int i = 0; i < n; i ++){
+				if ((low < 0) || (policy.notes[i] < policy.notes[low])) low = i;
+				if ((high < 0) || (policy.notes[i] > policy.notes[high])) high = i;
+			}
+			uint64_t keep = (policy.keepLowest ? (1ull << low) : 0) | (policy.keepHighest ? (1ull << high) : 0);
+			uint64_t candidates = (voices & ~keep) ? (voices & ~keep) : voices;
+			CHECK((candidates >> voice) & 1ull, "mode %d stole protected voice %d", policy.mode, voice);
+			/// the victim is the best of the candidates for the mode
+			for (int i = 0; i < n; i ++){
+				if (!((candidates >> i) & 1ull)) continue;
+				uint32_t ageI = policy.clock - policy.started[i];
+				uint32_t ageV = policy.clock - policy.started[voice];
+				switch (policy.mode){
+					case StealPriority::OLDEST:
+						CHECK(ageI <= ageV, "oldest: voice %d older than %d", i, voice);
+						break;
+					case StealPriority::QUIETEST:
+						CHECK((policy.levels[i] > policy.levels[voice]) || ((policy.levels[i] == policy.levels[voice]) && (ageI <= ageV)),
+							"quietest: voice %d beats %d", i, voice);
+						break;
+					case StealPriority::RELEASED:{
+						uint64_t sustained = candidates & ~gates;
+						if (sustained){
+							CHECK((sustained >> voice) & 1ull, "released: held voice %d stolen over sustained", voice);
+							if ((sustained >> i) & 1ull)
+								CHECK(policy.clock - policy.released[i] <= policy.clock - policy.released[voice], "released: voice %d released earlier", i);
+						}
+					} break;
+					default: break;
+				}
+			}
+		}
+	}
+}
+
+int main(){
+	testMasks();
+	testPolyModes();
+	testPads();
+	testPriority();
+	if (failures){
+		printf("voice_alloc_test: %d failures\n", failures);
+		return 1;
+	}
+	printf("voice_alloc_test: ok\n");
+	return 0;
+}